@@ -47,6 +47,18 @@ typedef enum {
 	CON_DOWN		/* down, disconnected */
 } BACKEND_STATUS;
 
+/*
+ * Statement statistics of a PostgreSQL backend.
+ */
+typedef struct {
+	long long int select_cnt;	/* number of SELECTs sent */
+	long long int write_cnt;	/* number of other statements sent */
+	long long int xact_cnt;		/* number of transactions finished */
+	long long int bytes_in;		/* bytes received from the backend */
+	long long int bytes_out;	/* bytes sent to the backend */
+	long long int error_cnt;	/* number of errors returned */
+} POOL_NODE_STATS;
+
 /*
  * PostgreSQL backend descriptor. Placed on shared memory area.
  */
@@ -59,6 +71,9 @@ typedef struct {
 	char backend_data_directory[MAX_PATH_LENGTH];
 	unsigned short flag;		/* various flags */
 	unsigned long long int standby_delay;		/* The replication delay against the primary */
+	POOL_NODE_STATS stats;	/* statistics. only filled in by pcp_node_info()
+							 * since the counters are kept in per
+							 * process area (see pool_node_stats.c) */
 } BackendInfo;
 
 typedef struct {
@@ -105,6 +120,9 @@ typedef struct {
 								 * failback a node in streaming
 								 * replication mode.
 								 */
+	long long int copy_in_count;	/* number of COPY FROM STDIN processed */
+	long long int copy_in_bytes;	/* bytes of COPY data forwarded to backends */
+	long long int copy_in_usec;	/* time spent for forwarding COPY data */
 } ProcessInfo;
 
 /*
@@ -185,6 +203,12 @@ typedef struct {
 	char status[POOLCONFIG_MAXSTATLEN+1];
 	char lb_weight[POOLCONFIG_MAXWEIGHTLEN+1];
 	char role[POOLCONFIG_MAXWEIGHTLEN+1];
+	char select_cnt[POOLCONFIG_MAXCOUNTLEN+1];
+	char write_cnt[POOLCONFIG_MAXCOUNTLEN+1];
+	char xact_cnt[POOLCONFIG_MAXCOUNTLEN+1];
+	char bytes_in[POOLCONFIG_MAXCOUNTLEN+1];
+	char bytes_out[POOLCONFIG_MAXCOUNTLEN+1];
+	char error_cnt[POOLCONFIG_MAXCOUNTLEN+1];
 } POOL_REPORT_NODES;
 
 /* processes report struct */
@@ -213,6 +237,18 @@ typedef struct {
 	int pool_connected;
 } POOL_REPORT_POOLS;
 
+/* latency report struct. latencies are in usec */
+typedef struct {
+	char name[POOLCONFIG_MAXNAMELEN+1];
+	char count[POOLCONFIG_MAXCOUNTLEN+1];
+	char avg[POOLCONFIG_MAXCOUNTLEN+1];
+	char p50[POOLCONFIG_MAXCOUNTLEN+1];
+	char p90[POOLCONFIG_MAXCOUNTLEN+1];
+	char p99[POOLCONFIG_MAXCOUNTLEN+1];
+	char p999[POOLCONFIG_MAXCOUNTLEN+1];
+	char max[POOLCONFIG_MAXCOUNTLEN+1];
+} POOL_REPORT_LATENCY;
+
 /* version struct */
 typedef struct {
 	char version[POOLCONFIG_MAXVALLEN+1];
@@ -231,6 +267,7 @@ extern int pcp_detach_node(int nid);
 extern int pcp_detach_node_gracefully(int nid);
 extern int pcp_attach_node(int nid);
 extern POOL_REPORT_CONFIG* pcp_pool_status(int *array_size);
+extern POOL_REPORT_LATENCY* pcp_latency_info(int *array_size);
 extern void pcp_set_timeout(long sec);
 extern int pcp_recovery_node(int nid);
 extern void pcp_enable_debug(void);
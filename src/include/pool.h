@@ -338,14 +338,36 @@ extern int my_master_node_id;
 #define LOCK_COMMENT_SZ (sizeof(LOCK_COMMENT)-1)
 #define NO_LOCK_COMMENT "/*NO INSERT LOCK*/"
 #define NO_LOCK_COMMENT_SZ (sizeof(NO_LOCK_COMMENT)-1)
+/* 1st key of advisory locks issued by insert_lock ("pgpl" in ASCII) */
+#define INSERT_LOCK_ADVISORY_CLASSID 0x7067706c
 #define NO_LOAD_BALANCE "/*NO LOAD BALANCE*/"
 #define NO_LOAD_BALANCE_COMMENT_SZ (sizeof(NO_LOAD_BALANCE)-1)
 
-#define MAX_NUM_SEMAPHORES		4
+#define MAX_NUM_SEMAPHORES		8
 #define CONN_COUNTER_SEM 0
 #define REQUEST_INFO_SEM 1
 #define SHM_CACHE_SEM	2
 #define QUERY_CACHE_STATS_SEM	3
+#define RELCACHE_SEM	4
+#define LOBJ_OID_SEM	5
+#define LOG_BUFFER_SEM	6
+#define QUERY_STATS_SEM	7
+
+/*
+ * CPU cache line size. Per process counters on shared memory are
+ * padded to this size so that processes do not write to the same
+ * cache line.
+ */
+#define POOL_CACHE_LINE_SIZE 64
+
+/*
+ * Memory barrier for data shared among processes without locking.
+ */
+#ifdef __GNUC__
+#define POOL_MEMORY_BARRIER() __sync_synchronize()
+#else
+#define POOL_MEMORY_BARRIER()
+#endif
 
 /*
  * number specified when semaphore is locked/unlocked
@@ -486,6 +508,7 @@ extern void send_failback_request(int node_id);
 
 
 extern void pool_set_timeout(int timeoutval);
+extern int pool_get_timeout(void);
 extern int pool_check_fd(POOL_CONNECTION *cp);
 
 extern void pool_send_frontend_exits(POOL_CONNECTION_POOL *backend);
@@ -541,6 +564,7 @@ extern void pool_shmem_exit(int code);
 extern int pool_semaphore_create(int numSems);
 extern void pool_semaphore_lock(int semNum);
 extern void pool_semaphore_unlock(int semNum);
+extern void pool_semaphore_lock_shared(int semNum);
 
 extern BackendInfo *pool_get_node_info(int node_number);
 extern int pool_get_node_count(void);
@@ -581,7 +605,6 @@ extern void pool_getnameinfo_all(SockAddr *saddr, char *remote_host, char *remot
 extern size_t strlcpy(char *dst, const char *src, size_t siz);
 
 /* ps_status.c */
-extern bool update_process_title;
 extern char **save_ps_display_args(int argc, char **argv);
 extern void init_ps_display(const char *username, const char *dbname,
 							const char *host_info, const char *initial_str);
@@ -598,6 +621,8 @@ extern int wait_connection_closed(void);
 extern void cancel_request(CancelPacket *sp);
 extern void check_stop_request(void);
 extern void pool_initialize_private_backend_status(void);
+extern bool pool_detach_node_locally(int node_id);
+extern bool pool_detach_down_nodes(void);
 
 /* pool_process_query.c */
 extern void reset_variables(void);
@@ -622,6 +647,8 @@ extern void pool_sleep(unsigned int second);
 
 /* pool_worker_child.c */
 extern void do_worker_child(void);
+extern void do_metrics_child(int fd);
+extern void do_logger_child(void);
 
 /* md5.c */
 extern bool pg_md5_encrypt(const char *passwd, const char *salt, size_t salt_len, char *buf);
@@ -631,6 +658,7 @@ extern int pool_init_cp(void);
 extern POOL_CONNECTION_POOL *pool_create_cp(void);
 extern POOL_CONNECTION_POOL *pool_get_cp(char *user, char *database, int protoMajor, int check_socket);
 extern void pool_discard_cp(char *user, char *database, int protoMajor);
+extern void pool_discard_node_connections(int node_id);
 extern void pool_backend_timer(void);
 extern void pool_connection_pool_timer(POOL_CONNECTION_POOL *backend);
 extern RETSIGTYPE pool_backend_timer_handler(int sig);
@@ -0,0 +1,75 @@
+/* -*-pgsql-c-*- */
+/*
+ *
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_activity.h.: pool_activity.c related header file
+ *
+ */
+
+#ifndef POOL_ACTIVITY_H
+#define POOL_ACTIVITY_H
+
+#include <sys/time.h>
+#include "pool_query_context.h"
+
+/* State of a child */
+typedef enum
+{
+	POOL_ACTIVITY_WAIT_CONNECTION = 0,	/* waiting for client to connect */
+	POOL_ACTIVITY_IDLE,				/* waiting for query from client */
+	POOL_ACTIVITY_IDLE_IN_TRANSACTION,	/* same as above but in transaction */
+	POOL_ACTIVITY_ACTIVE			/* processing a query */
+} POOL_ACTIVITY_STATE;
+
+/* Lengths of strings kept in activity including null terminator */
+#define POOL_ACTIVITY_IDENT_LEN 64
+#define POOL_ACTIVITY_QUERY_LEN 256
+
+/*
+ * Activity of a child. Only the child itself updates it.
+ */
+typedef struct
+{
+	volatile unsigned int changecount;	/* odd while being updated */
+	POOL_ACTIVITY_STATE state;
+	struct timeval state_change;	/* when the state changed */
+	struct timeval query_start;	/* when the last query started */
+	unsigned int fingerprint;	/* hash of the last query */
+	char database[POOL_ACTIVITY_IDENT_LEN];
+	char username[POOL_ACTIVITY_IDENT_LEN];
+	char client[POOL_ACTIVITY_IDENT_LEN];	/* client host and port */
+	char query[POOL_ACTIVITY_QUERY_LEN];	/* last query, possibly truncated */
+	char where_to_send[MAX_NUM_BACKENDS];	/* DB nodes the last query was sent to */
+	int num_statements;	/* number of live prepared statements */
+	int num_portals;	/* number of live portals */
+} POOL_ACTIVITY;
+
+extern int pool_init_activity(void);
+extern void pool_activity_wait_connection(void);
+extern void pool_activity_start_session(const char *database, const char *username, const char *client);
+extern void pool_activity_start_query(const char *query);
+extern void pool_activity_set_nodes(POOL_QUERY_CONTEXT *query_context);
+extern void pool_activity_idle(bool in_transaction);
+extern void pool_activity_set_sent_messages(int num_statements, int num_portals);
+extern bool pool_activity_ps_display_due(void);
+extern bool pool_get_activity(int child, POOL_ACTIVITY *activity);
+extern char *pool_activity_state_name(POOL_ACTIVITY_STATE state);
+
+#endif /* POOL_ACTIVITY_H */
@@ -73,6 +73,7 @@ typedef struct {
 	int pcp_port;				/* PCP port # to bind */
 	char *socket_dir;		/* pgpool socket directory */
 	char *pcp_socket_dir;		/* PCP socket directory */
+	int metrics_port;			/* metrics exporter port # to bind. 0 disables it */
 	int pcp_timeout;			/* PCP timeout for an idle client */
     int	num_init_children;	/* # of children initially pre-forked */
     int	child_life_time;	/* if idle for this seconds, child exits */
@@ -84,6 +85,9 @@ typedef struct {
     int	max_pool;	/* max # of connection pool per child */
     char *logdir;		/* logging directory */
     char *log_destination;      /* log destination: stderr or syslog */
+	int log_buffer_size;		/* per process log buffer size. 0 disables logger process */
+	char *log_file;				/* log file written by logger process. "" means stderr */
+	int log_rotation_size;		/* rotate log_file after this kB is written. 0 disables */
     int syslog_facility;        /* syslog facility: LOCAL0, LOCAL1, ... */
     char *syslog_ident;         /* syslog ident string: pgpool */
     char *pid_file_name;		/* pid file name */
@@ -92,10 +96,13 @@ typedef struct {
 
 	int log_connections;		/* 0:false, 1:true - logs incoming connections */
 	int log_hostname;		/* 0:false, 1:true - resolve hostname */
+	int update_process_title;	/* 0:false, 1:true - show activity in ps status */
 	int enable_pool_hba;		/* 0:false, 1:true - enables pool_hba.conf file authentication */
 	char *pool_passwd;	/* pool_passwd file name. "" disables pool_passwd */
 
 	int load_balance_mode;		/* load balance mode */
+	int multi_statement_load_balance;	/* if non 0, load balance multi statement
+										 * query consisting of SELECTs only */
 
 	int replication_stop_on_mismatch;		/* if there's a data mismatch between master and secondary
 											 * start degeneration to stop replication mode
@@ -154,9 +161,13 @@ typedef struct {
 											 *  This parameter is only valid while in recovery 2nd stage */
 	int insert_lock;	/* if non 0, automatically lock table with INSERT to keep SERIAL
 						   data consistency */
+	int timestamp_sync_interval;	/* if > 0, interval in seconds to synchronize clock
+									   with master for rewrite_timestamp */
 	int ignore_leading_white_space;		/* ignore leading white spaces of each query */
  	int log_statement; /* 0:false, 1: true - logs all SQL statements */
  	int log_per_node_statement; /* 0:false, 1: true - logs per node detailed SQL statements */
+	int log_statement_sample_rate;	/* log only 1 in this many statements */
+	int log_min_duration_statement;	/* log statements taking this many msec or more. -1 disables */
 
 	int parallel_mode;	/* if non 0, run in parallel query mode */
 
@@ -171,6 +182,9 @@ typedef struct {
 	char *system_db_password;	/* password to access system DB */
 
 	char *lobj_lock_table;		/* table name to lock for rewriting lo_creat */
+	int lobj_oid_block_size;	/* number of large object OIDs reserved at once
+								 * for rewriting lo_creat. 0 disables the OID
+								 * allocator */
 
 	int debug_level;			/* debug message verbosity level.
 								 * 0: no message, 1 <= : more verbose
@@ -198,6 +212,11 @@ typedef struct {
 	time_t relcache_expire;		/* relation cache life time in seconds */
 	int relcache_size;		/* number of relation cache life entry */
 	int check_temp_table;		/* enable temporary table check */
+	int parse_cache_size;		/* number of parse cache entries. 0 disables the cache */
+	int query_stats_size;		/* number of queries kept in query statistics. 0 disables */
+	int shared_relcache_size;	/* number of shared relcache entries. 0 disables the cache */
+	int extended_query_pipelining;	/* if non 0, forward extended query messages
+									 * without waiting for responses */
 
 	/* followings are for regex support and do not exist in the configuration file */
 	RegPattern *lists_patterns; /* Precompiled regex patterns for black/white lists */
@@ -0,0 +1,74 @@
+/* -*-pgsql-c-*- */
+/*
+ *
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_latency.h.: pool_latency.c related header file
+ *
+ */
+
+#ifndef POOL_LATENCY_H
+#define POOL_LATENCY_H
+
+#include "pool_query_context.h"
+
+/*
+ * Kinds of queries latency is recorded for. Each query is counted in
+ * exactly one of them.
+ */
+typedef enum
+{
+	POOL_LATENCY_READ = 0,		/* SELECT sent to one node (load balanced) */
+	POOL_LATENCY_WRITE,			/* other queries (sent to primary/all nodes) */
+	POOL_LATENCY_CACHE_HIT,		/* result returned from query cache */
+	POOL_LATENCY_CACHE_MISS,	/* query cache was searched but not found */
+	POOL_LATENCY_NUM_KINDS
+} POOL_LATENCY_KIND;
+
+/*
+ * Latency is recorded in microseconds. Each power of 2 range is
+ * divided into 4 sub buckets, so the error of a bucket is at most
+ * 25%. Latencies over 2^32 usec go into the last bucket.
+ */
+#define POOL_LATENCY_SUB_BUCKETS 4
+#define POOL_LATENCY_BUCKETS (POOL_LATENCY_SUB_BUCKETS + 30 * POOL_LATENCY_SUB_BUCKETS + 1)
+
+/* Latency histogram */
+typedef struct
+{
+	long long int count;		/* number of queries */
+	long long int total_usec;	/* sum of latencies */
+	long long int max_usec;		/* max latency */
+	long long int buckets[POOL_LATENCY_BUCKETS];
+} POOL_LATENCY_HISTOGRAM;
+
+extern int pool_init_latency_stats(void);
+extern void pool_latency_start(void);
+extern void pool_latency_start_if_not_running(void);
+extern void pool_latency_stop(void);
+extern void pool_latency_cache_miss(void);
+extern void pool_latency_cache_hit(char *query, Node *parse_tree);
+extern void pool_latency_query_done(POOL_QUERY_CONTEXT *query_context);
+extern bool pool_log_statement_sampled(void);
+extern int pool_latency_num_histograms(void);
+extern char *pool_latency_histogram_name(int index);
+extern void pool_latency_get_histogram(int index, POOL_LATENCY_HISTOGRAM *histogram);
+extern long long int pool_latency_percentile(POOL_LATENCY_HISTOGRAM *histogram, double percentile);
+
+#endif /* POOL_LATENCY_H */
@@ -27,6 +27,28 @@
 #define POOL_LOBJ_H
 #include "pool.h"
 
+/* Number of databases whose large object OID ranges are kept */
+#define LOBJ_OID_RANGE_SLOTS 64
+
+/*
+ * Range of large object OIDs reserved for a database. OIDs from
+ * next_oid to last_oid are not used yet.
+ */
+typedef struct {
+	char database[SM_DATABASE];	/* database name. "" if unused */
+	unsigned int next_oid;		/* next OID to hand out */
+	unsigned int last_oid;		/* last OID of the reserved range */
+	unsigned int last_used;		/* for replacing least recently used slot */
+} POOL_LOBJ_OID_RANGE;
+
+/* Large object OID allocator on shared memory */
+typedef struct {
+	unsigned int clock;			/* incremented each time a slot is used */
+	unsigned int evicted_oid;	/* largest last_oid of evicted ranges */
+	POOL_LOBJ_OID_RANGE ranges[LOBJ_OID_RANGE_SLOTS];
+} POOL_LOBJ_OID_ALLOCATOR;
+
+extern int pool_init_lobj_oid_allocator(void);
 extern char *pool_rewrite_lo_creat(char kind, char *packet, int packet_len, POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, int* len);
 
 #endif /* POOL_LOBJ_H */
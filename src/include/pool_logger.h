@@ -0,0 +1,38 @@
+/* -*-pgsql-c-*- */
+/*
+ *
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_logger.h.: pool_logger.c related header file
+ *
+ */
+
+#ifndef POOL_LOGGER_H
+#define POOL_LOGGER_H
+
+#include <sys/types.h>
+
+/* Minimum size of per process log buffer */
+#define POOL_LOG_BUFFER_MIN_SIZE 1024
+
+extern int pool_init_log_buffer(void);
+extern void pool_log_buffer_set_logger(pid_t pid);
+extern bool pool_log_buffer_write(const char *msg, int len);
+
+#endif /* POOL_LOGGER_H */
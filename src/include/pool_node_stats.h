@@ -0,0 +1,39 @@
+/* -*-pgsql-c-*- */
+/*
+ *
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_node_stats.h.: pool_node_stats.c related header file
+ *
+ */
+
+#ifndef POOL_NODE_STATS_H
+#define POOL_NODE_STATS_H
+
+#include "pool.h"
+
+extern int pool_init_node_stats(void);
+extern void pool_node_stats_count_statement(int node_id, bool is_select);
+extern void pool_node_stats_count_transaction(int node_id);
+extern void pool_node_stats_count_errors(POOL_CONNECTION_POOL *backend);
+extern void pool_node_stats_count_bytes_in(POOL_CONNECTION *cp, int len);
+extern void pool_node_stats_count_bytes_out(POOL_CONNECTION *cp, int len);
+extern void pool_get_node_stats(int node_id, POOL_NODE_STATS *stats);
+
+#endif /* POOL_NODE_STATS_H */
@@ -0,0 +1,59 @@
+/* -*-pgsql-c-*- */
+/*
+ *
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_parse_cache.h.: pool_parse_cache.c related header file
+ *
+ */
+
+#ifndef POOL_PARSE_CACHE_H
+#define POOL_PARSE_CACHE_H
+
+#include "pool_query_context.h"
+#include "parser/pg_list.h"
+#include "parser/pool_memory.h"
+
+/* Queries longer than this are not cached */
+#define POOL_PARSE_CACHE_MAX_QUERY_LENGTH 8192
+
+/* Parse cache entry */
+typedef struct POOL_PARSE_CACHE_ENTRY {
+	char *query;					/* query string (hash key) */
+	uint32 hash;					/* hash value of query */
+	bool standard_conforming_strings;	/* parser setting when parsed */
+	POOL_MEMORY_POOL *memory_context;	/* memory context for parse tree */
+	List *parse_tree_list;			/* raw parser output */
+	POOL_SYNTAX_INFO syntax_info;	/* derived routing decisions */
+	char *rewritten_query;			/* template of rewrite_timestamp() result */
+	void *rewrite_dependency;		/* relcache data rewritten_query depends on */
+	struct POOL_PARSE_CACHE_ENTRY *hash_next;	/* next entry in hash bucket */
+	struct POOL_PARSE_CACHE_ENTRY *lru_prev;	/* more recently used entry */
+	struct POOL_PARSE_CACHE_ENTRY *lru_next;	/* less recently used entry */
+} POOL_PARSE_CACHE_ENTRY;
+
+extern List *pool_parse_cache_lookup(const char *query, POOL_SYNTAX_INFO *info);
+extern void pool_parse_cache_add(const char *query, List *parse_tree_list);
+extern void pool_parse_cache_update(const char *query, POOL_SYNTAX_INFO *info);
+extern void pool_parse_cache_reset(void);
+extern char *pool_parse_cache_get_rewritten_query(const char *query, void **dependency);
+extern void pool_parse_cache_set_rewritten_query(const char *query, const char *rewritten_query, void *dependency);
+extern void pool_parse_cache_forget_rewritten_queries(void *dependency);
+
+#endif /* POOL_PARSE_CACHE_H */
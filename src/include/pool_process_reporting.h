@@ -28,17 +28,25 @@
 
 extern void send_row_description(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 							short num_fields, char **field_names);
+extern void send_data_row(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
+						  short num_fields, char **values);
 extern void send_complete_and_ready(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, const int num_rows);
 extern POOL_REPORT_CONFIG* get_config(int *nrows);
 extern POOL_REPORT_POOLS* get_pools(int *nrows);
 extern POOL_REPORT_PROCESSES* get_processes(int *nrows);
 extern POOL_REPORT_NODES* get_nodes(int *nrows);
 extern POOL_REPORT_VERSION* get_version(void);
+extern POOL_REPORT_LATENCY* get_latency(int *nrows);
 extern void config_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 extern void pools_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 extern void processes_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 extern void nodes_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 extern void version_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 extern void cache_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
+extern void copy_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
+extern void latency_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
+extern void activity_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
+extern void query_stats_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
+extern void cache_tables_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 
 #endif
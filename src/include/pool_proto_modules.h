@@ -175,9 +175,13 @@ extern POOL_STATUS send_simplequery_message(POOL_CONNECTION *backend, int len, c
 extern POOL_STATUS send_extended_protocol_message(POOL_CONNECTION_POOL *backend,
 												  int node_id, char *kind,
 												  int len, char *string);
+extern POOL_STATUS send_pipelined_protocol_message(POOL_CONNECTION_POOL *backend,
+												   int node_id, char *kind,
+												   int len, char *string);
 
 extern int synchronize(POOL_CONNECTION *cp);
 extern POOL_STATUS read_kind_from_backend(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, char *decided_kind);
+extern int pool_fill_backend_read_buffers(POOL_CONNECTION_POOL *backend, int exclude_node, int len);
 extern POOL_STATUS read_kind_from_one_backend(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, char *kind, int node);
 extern POOL_STATUS do_error_command(POOL_CONNECTION *backend, int major);
 extern POOL_STATUS raise_intentional_error_if_need(POOL_CONNECTION_POOL *backend);
@@ -45,6 +45,18 @@ typedef enum {
 	POOL_EXECUTE_COMPLETE
 } POOL_QUERY_STATE;
 
+/*
+ * Results of syntactical analysis of the parse tree. They do not
+ * depend on the session state, thus can be kept in the parse cache
+ * along with the parse tree.
+ */
+typedef struct {
+	bool dest_valid;			/* true if dest is set */
+	int dest;					/* result of send_to_where() */
+	bool function_call_valid;	/* true if has_function_call is set */
+	bool has_function_call;		/* result of pool_has_function_call() */
+} POOL_SYNTAX_INFO;
+
 /*
  * Query context:
  * Manages per query context
@@ -63,11 +75,15 @@ typedef struct {
 	bool is_cache_safe;	/* true if SELECT is safe to cache */
 	POOL_TEMP_QUERY_CACHE *temp_cache;	/* temporary cache */
 	bool is_multi_statement;	/* true if multi statement query */
+	List *parse_tree_list;		/* all statements of multi statement query */
 	int dboid;	/* DB oid which is used at DROP DATABASE */
 	char *query_w_hex;	/* original_query with bind message hex which used for committing cache of extended query */
 	bool is_parse_error;		/* if true, we could not parse the original
 								 * query and parsed node is actually a dummy query.
 								 */
+	POOL_SYNTAX_INFO syntax_info;	/* syntactical analysis of parse_tree */
+	int num_sent_messages;	/* number of messages in the sent message
+							 * list using this query context */
 } POOL_QUERY_CONTEXT;
 
 extern POOL_QUERY_CONTEXT *pool_init_query_context(void);
@@ -0,0 +1,56 @@
+/* -*-pgsql-c-*- */
+/*
+ *
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_query_stats.h.: pool_query_stats.c related header file
+ *
+ */
+
+#ifndef POOL_QUERY_STATS_H
+#define POOL_QUERY_STATS_H
+
+#include "pool_latency.h"
+#include "parser/nodes.h"
+
+/* Length of normalized query kept in statistics including null terminator */
+#define POOL_QUERY_STATS_QUERY_LEN 256
+
+/*
+ * Statistics of queries having the same fingerprint, i.e. queries
+ * which are same except constants.
+ */
+typedef struct
+{
+	unsigned int fingerprint;	/* hash of normalized query. 0 for the overflow entry */
+	long long int calls;		/* number of queries */
+	long long int cache_hits;	/* results returned from query cache */
+	long long int cache_misses;	/* searched in query cache but not found */
+	long long int total_usec;	/* sum of latencies */
+	long long int max_usec;		/* max latency */
+	long long int node_calls[MAX_NUM_BACKENDS];	/* queries sent to each DB node */
+	char query[POOL_QUERY_STATS_QUERY_LEN];	/* normalized query, possibly truncated */
+} POOL_QUERY_STATS;
+
+extern int pool_init_query_stats(void);
+extern void pool_query_stats_record(char *query, Node *parse_tree, POOL_LATENCY_KIND kind,
+									char *where_to_send, long long int usec);
+extern POOL_QUERY_STATS *pool_get_query_stats(int *nrows);
+
+#endif /* POOL_QUERY_STATS_H */
@@ -37,12 +37,17 @@
 typedef void *(*func_ptr) ();
 
 typedef struct {
-	char dbname[MAX_ITEM_LENGTH];	/* database name */
-	char relname[MAX_ITEM_LENGTH];	/* table name */
+	char *dbname;	/* database name (interned). NULL if unused */
+	char *relname;	/* table name (interned) */
 	void *data;	/* user data */
 	int refcnt;		/* reference count */
 	int session_id;		/* LocalSessionId */
 	time_t expire;		/* cache expiration absolute time in seconds */
+	int generation;		/* shared relcache generation at registration */
+	uint32 hash;		/* hash value of dbname and relname */
+	int hash_next;		/* next entry in the same hash bucket. -1 if none */
+	int lru_prev;		/* more recently used entry. -1 if none */
+	int lru_next;		/* less recently used entry. -1 if none */
 } PoolRelCache;
 
 typedef struct {
@@ -63,16 +68,59 @@ typedef struct {
 	bool cache_is_session_local;		/* True if cache life time is session local */
 	bool no_cache_if_zero;		/* if register func returns 0, do not cache the data */
 	PoolRelCache *cache;	/* cache data */
+	uint32 sql_hash;		/* hash value of sql to identify the cache in shared relcache */
+	int *buckets;			/* hash buckets of cache entries. -1 if empty */
+	int nbuckets;			/* number of buckets. power of 2 */
+	int lru_head;			/* most recently used entry */
+	int lru_tail;			/* least recently used or unused entry */
 } POOL_RELCACHE;
 
+/* ------------------------
+ * Shared relation cache structure
+ *-------------------------
+ * Query results of relation caches are kept in shared memory as well
+ * so that other pgpool children do not need to issue the same query
+ * against system catalog. Entries are found by a hash of (sql,
+ * dbname, relname), which selects a set of SHARED_RELCACHE_WAYS
+ * consecutive entries.
+ */
+#define SHARED_RELCACHE_WAYS 4
+#define SHARED_RELCACHE_DBNAME_LEN 64
+#define SHARED_RELCACHE_RELNAME_LEN 256
+#define SHARED_RELCACHE_DATA_LEN 512
+
+typedef struct {
+	uint32 hash;		/* hash value of sql, dbname and relname */
+	uint32 sql_hash;	/* hash value of sql */
+	char dbname[SHARED_RELCACHE_DBNAME_LEN];	/* database name */
+	char relname[SHARED_RELCACHE_RELNAME_LEN];	/* table name */
+	int generation;		/* generation at registration. 0 means unused */
+	time_t expire;		/* cache expiration absolute time in seconds */
+	unsigned int last_used;	/* tick count of last access */
+	int datalen;		/* length of data */
+	char data[SHARED_RELCACHE_DATA_LEN];	/* serialized query result */
+} POOL_SHARED_RELCACHE_ENTRY;
+
+typedef struct {
+	int generation;		/* incremented when relations might be modified */
+	int num;			/* number of entries. multiple of SHARED_RELCACHE_WAYS */
+	unsigned int tick;	/* access counter for replacement */
+	POOL_SHARED_RELCACHE_ENTRY entries[1];	/* actual entries follows */
+} POOL_SHARED_RELCACHE;
+
 extern POOL_RELCACHE *pool_create_relcache(int cachesize, char *sql,
 									func_ptr register_func, func_ptr unregister_func,
 									bool issessionlocal);
 extern void pool_discard_relcache(POOL_RELCACHE *relcache);
 extern void *pool_search_relcache(POOL_RELCACHE *relcache, POOL_CONNECTION_POOL *backend, char *table);
+extern void pool_relcache_prefetch_add(POOL_RELCACHE *relcache, POOL_CONNECTION_POOL *backend, char *table);
+extern void pool_relcache_prefetch(POOL_CONNECTION_POOL *backend);
+extern void pool_relcache_prefetch_reset(void);
 extern void *int_register_func(POOL_SELECT_RESULT *res);
 extern void *int_unregister_func(void *data);
 extern void *string_register_func(POOL_SELECT_RESULT *res);
 extern void *string_unregister_func(void *data);
+extern int pool_init_shared_relcache(void);
+extern void pool_invalidate_shared_relcache(void);
 
 #endif /* POOL_RELCACHE_H */
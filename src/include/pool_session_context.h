@@ -26,6 +26,7 @@
 #ifndef POOL_SESSION_CONTEXT_H
 #define POOL_SESSION_CONTEXT_H
 #define INIT_LIST_SIZE 8
+#define POOL_TIMESTAMP_LEN 64	/* large enough for timestamp literal */
 
 #include "pool.h"
 #include "pool_process_context.h"
@@ -48,7 +49,7 @@ typedef enum {
 /*
  * Message content of extended query
  */
-typedef struct {
+typedef struct POOL_SENT_MESSAGE {
 	char kind;	/* one of 'P':Parse, 'B':Bind or 'Q':Query(PREPARE) */
 	int len;	/* in host byte order */
 	char *contents;
@@ -63,17 +64,64 @@ typedef struct {
 							 * parameters are stored.
 							 * This is meaningful only when is_cache_safe is true.
 							 */
+	struct POOL_SENT_MESSAGE *hash_next;	/* next message in the same hash bucket */
+	int index;		/* position in the sent message list */
 } POOL_SENT_MESSAGE;
 
 /*
  * List of POOL_SENT_MESSAGE
+ *
+ * Messages are kept in the array, and also indexed by (kind, name)
+ * with a hash table allocated in the session memory context so that
+ * pool_get_sent_message() does not need to scan the whole list. Each
+ * message remembers its position in the array, and a removed message
+ * is replaced with the last one so that removal does not need to scan
+ * or shift the array either. Thus the order of the array is not
+ * preserved.
  */
 typedef struct {
 	int capacity;	/* capacity of list */
 	int size;		/* number of elements */
 	POOL_SENT_MESSAGE **sent_messages;
+
+	int nbuckets;	/* number of hash buckets (power of 2) */
+	POOL_SENT_MESSAGE **buckets;	/* hash buckets */
+
+	/* statistics */
+	int num_statements;	/* number of live prepared statements */
+	int num_portals;	/* number of live portals */
+	int max_size;		/* peak number of elements in this session */
 } POOL_SENT_MESSAGE_LIST;
 
+/*
+ * Extended query message forwarded to backends before responses to
+ * the preceding messages are read (extended_query_pipelining).
+ */
+typedef struct {
+	char kind;	/* one of 'P':Parse, 'B':Bind, 'D':Describe, 'E':Execute or 'S':Sync */
+	POOL_SENT_MESSAGE *message;	/* Parse or Bind message. NULL for others */
+	POOL_QUERY_CONTEXT *query_context;	/* query context of the message */
+} POOL_PENDING_MESSAGE;
+
+/*
+ * Queue of POOL_PENDING_MESSAGE in the order of forwarding. Messages
+ * from head to tail - 1 have not received their responses yet.
+ */
+typedef struct {
+	int capacity;	/* capacity of queue */
+	int head;		/* oldest message */
+	int tail;		/* next to the newest message */
+	POOL_PENDING_MESSAGE *messages;
+
+	/*
+	 * Query contexts of messages discarded because of an error. They
+	 * are destroyed at ReadyForQuery unless still used.
+	 */
+	int num_discarded;
+	int discarded_capacity;
+	POOL_QUERY_CONTEXT **discarded;
+} POOL_PENDING_MESSAGE_QUEUE;
+
 /*
  * Per session context:
  */
@@ -106,6 +154,9 @@ typedef struct {
 	/* ignore any command until Sync message */
 	bool ignore_till_sync;
 
+	/* If true, extended query message is forwarded without waiting for response */
+	bool pipelining_message;
+
 	/*
 	 * Transaction isolation mode.
 	 */
@@ -128,6 +179,9 @@ typedef struct {
 
 	POOL_SENT_MESSAGE_LIST message_list;
 
+	/* pipelined messages waiting for responses */
+	POOL_PENDING_MESSAGE_QUEUE pending_messages;
+
 	int load_balance_node_id;	/* selected load balance node id */
 
 	/*
@@ -148,6 +202,28 @@ typedef struct {
 	 */
 	bool reset_context;
 
+	/*
+	 * If true, a DDL has been executed in the transaction and the
+	 * shared relcache needs to be invalidated at transaction end.
+	 */
+	bool invalidate_shared_relcache;
+
+	/*
+	 * Timestamp used by rewrite_timestamp() in current transaction.
+	 * Valid until the transaction ends.
+	 */
+	bool transaction_timestamp_valid;
+	char transaction_timestamp[POOL_TIMESTAMP_LEN];
+
+	/*
+	 * Offset of master's clock to local clock in micro seconds and
+	 * master's time zone offset in seconds (east of UTC), measured at
+	 * clock_synced_at. 0 for clock_synced_at means not measured yet.
+	 */
+	time_t clock_synced_at;
+	long long int master_clock_offset;
+	int master_timezone;
+
 	/*
 	 * Query cache management area
 	 */
@@ -180,6 +256,18 @@ extern void pool_remove_sent_messages(char kind);
 extern void pool_clear_sent_message_list(void);
 extern void pool_sent_message_destroy(POOL_SENT_MESSAGE *message);
 extern POOL_SENT_MESSAGE *pool_get_sent_message(char kind, const char *name);
+extern bool pool_is_pipelining_message(void);
+extern void pool_set_pipelining_message(void);
+extern void pool_unset_pipelining_message(void);
+extern bool pool_pipeline_add(char kind, POOL_SENT_MESSAGE *message, POOL_QUERY_CONTEXT *query_context);
+extern bool pool_pipeline_pending(void);
+extern int pool_pipeline_length(void);
+extern POOL_PENDING_MESSAGE *pool_pipeline_head(void);
+extern POOL_PENDING_MESSAGE *pool_pipeline_tail(void);
+extern void pool_pipeline_pop(void);
+extern bool pool_pipeline_discard(void);
+extern void pool_pipeline_reset(void);
+extern POOL_SENT_MESSAGE *pool_pipeline_get_sent_message(char kind, const char *name);
 extern void pool_unset_writing_transaction(void);
 extern void pool_set_writing_transaction(void);
 extern bool pool_is_writing_transaction(void);
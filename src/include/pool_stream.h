@@ -46,10 +46,13 @@ extern POOL_CONNECTION *pool_open(int fd);
 extern void pool_close(POOL_CONNECTION *cp);
 extern int pool_read(POOL_CONNECTION *cp, void *buf, int len);
 extern char *pool_read2(POOL_CONNECTION *cp, int len);
+extern int pool_read_some(POOL_CONNECTION *cp, void *buf, int len);
+extern int pool_fill_read_buffers(POOL_CONNECTION **cps, int ncps, int len);
 extern int pool_write(POOL_CONNECTION *cp, void *buf, int len);
 extern int pool_flush(POOL_CONNECTION *cp);
 extern int pool_flush_it(POOL_CONNECTION *cp);
 extern int pool_write_and_flush(POOL_CONNECTION *cp, void *buf, int len);
+extern int pool_write_concurrently(POOL_CONNECTION **cps, int ncps, char *buf, int len);
 extern char *pool_read_string(POOL_CONNECTION *cp, int *len, int line);
 extern int pool_unread(POOL_CONNECTION *cp, void *data, int len);
 extern int pool_push(POOL_CONNECTION *cp, void *data, int len);
@@ -92,12 +92,18 @@ typedef struct {
  * memcached.
  */
 
+/* Max number of table oids kept in cache item header */
+#define POOL_CACHE_ITEM_MAX_OIDS 4
+
 /*
  * "Cache Item header" structure is used to manage each cache item.
  */
 typedef struct {
 	unsigned int total_length;	/* total length in bytes including myself */
 	time_t timestamp;	/* cache creation time */
+	int dboid;			/* database oid */
+	int num_oids;		/* number of table oids below */
+	int oids[POOL_CACHE_ITEM_MAX_OIDS];	/* tables the item depends on. used for statistics */
 } POOL_CACHE_ITEM_HEADER;
 
 typedef struct {
@@ -162,8 +168,7 @@ typedef struct
 } POOL_QUERY_CACHE_ARRAY;
 
 /*
- * Query cache statistics structure. This area must be placed on shared
- * memory and protected by QUERY_CACHE_STATS_SEM.
+ * Query cache statistics structure.
  */
 typedef struct
 {
@@ -172,6 +177,51 @@ typedef struct
 	long long int num_cache_hits;		/* number of SELECTs extracted from cache */
 } POOL_QUERY_CACHE_STATS;
 
+/*
+ * Per process query cache statistics counters. Each child updates
+ * its own slot without locking. Slots are padded to cache line size
+ * so that children do not write to the same cache line.
+ */
+typedef union
+{
+	struct
+	{
+		long long int num_selects;
+		long long int num_cache_hits;
+	} counters;
+	char pad[POOL_CACHE_LINE_SIZE];
+} POOL_QUERY_CACHE_STATS_SLOT;
+
+/*
+ * Query cache statistics of a table. The statistics of a database
+ * have 0 as table_oid.
+ */
+typedef struct
+{
+	int dboid;					/* database oid. 0 for the overflow entry */
+	int table_oid;				/* table oid. 0 for database */
+	long long int num_registered;	/* number of cache entries registered */
+	long long int num_hits;		/* number of SELECTs extracted from cache */
+	long long int num_invalidated;	/* entries discarded by table modification */
+	long long int invalidated_bytes;	/* bytes of the above */
+	long long int num_evicted;	/* entries discarded by expiration or lack of space */
+	long long int evicted_bytes;	/* bytes of the above */
+} POOL_CACHE_TABLE_STATS;
+
+/* Max number of tables and databases query cache statistics are kept for */
+#define POOL_CACHE_TABLE_STATS_SIZE 1024
+
+/*
+ * Query cache statistics area placed on shared memory. Counters are
+ * summed up when read.
+ */
+typedef struct
+{
+	time_t		start_time;		/* start time when the statistics begins */
+	int			num_slots;		/* number of slots */
+	POOL_QUERY_CACHE_STATS_SLOT slots[1];	/* actual data continues... */
+} POOL_QUERY_CACHE_STATS_AREA;
+
 /*
  * Shared memory cache stats interface.
  */
@@ -251,18 +301,25 @@ extern void pool_handle_query_cache(POOL_CONNECTION_POOL *backend, char *query,
 extern int pool_init_memqcache_stats(void);
 extern POOL_QUERY_CACHE_STATS *pool_get_memqcache_stats(void);
 extern void pool_reset_memqcache_stats(void);
-extern long long int pool_stats_count_up_num_selects(long long int num);
-extern long long int pool_stats_count_up_num_cache_hits(void);
+extern void pool_stats_count_up_num_selects(long long int num);
+extern void pool_stats_count_up_num_cache_hits(void);
 extern long long int pool_tmp_stats_count_up_num_selects(void);
 extern long long int pool_tmp_stats_get_num_selects(void);
 extern void pool_tmp_stats_reset_num_selects(void);
 extern POOL_SHMEM_STATS *pool_get_shmem_storage_stats(void);
+extern POOL_CACHE_TABLE_STATS *pool_get_cache_table_stats(int *nrows);
 
 extern POOL_TEMP_QUERY_CACHE *pool_get_current_cache(void);
 extern POOL_TEMP_QUERY_CACHE *pool_get_current_cache(void);
 extern void pool_discard_temp_query_cache(POOL_TEMP_QUERY_CACHE *temp_cache);
 
-extern void pool_shmem_lock(void);
+/* Lock mode of shared memory query cache */
+typedef enum {
+	POOL_MEMQ_SHARED_LOCK,		/* reading cache only */
+	POOL_MEMQ_EXCLUSIVE_LOCK	/* modifying cache */
+} POOL_MEMQ_LOCK_TYPE;
+
+extern void pool_shmem_lock(POOL_MEMQ_LOCK_TYPE type);
 extern void pool_shmem_unlock(void);
 
 #endif /* POOL_MEMQCACHE_H */
@@ -507,6 +507,24 @@ pcp_node_info(int nid)
 			if (index != NULL)
 				backend_info->backend_weight = atof(index);
 
+			/* statement statistics. older servers do not send them */
+			memset(&backend_info->stats, 0, sizeof(POOL_NODE_STATS));
+			index = (char *) memchr(index, '\0', rsize) + 1;
+			if (index < buf + rsize - sizeof(int))
+			{
+				backend_info->stats.select_cnt = atoll(index);
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				backend_info->stats.write_cnt = atoll(index);
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				backend_info->stats.xact_cnt = atoll(index);
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				backend_info->stats.bytes_in = atoll(index);
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				backend_info->stats.bytes_out = atoll(index);
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				backend_info->stats.error_cnt = atoll(index);
+			}
+
 			free(buf);
 			return backend_info;
 		}
@@ -1369,6 +1387,124 @@ pcp_pool_status(int *array_size)
 	return NULL;
 }
 
+/* --------------------------------
+ * pcp_latency_info - return query latency histograms summary
+ *
+ * returns and array of POOL_REPORT_LATENCY, NULL otherwise
+ * --------------------------------
+ */
+POOL_REPORT_LATENCY*
+pcp_latency_info(int *array_size)
+{
+	char tos;
+	char *buf = NULL;
+	int wsize;
+	int rsize;
+	POOL_REPORT_LATENCY *latency = NULL;
+	int li_size = 0;
+	int offset = 0;
+
+	if (pc == NULL)
+	{
+		if (debug) fprintf(stderr, "DEBUG: connection does not exist\n");
+		errorcode = NOCONNERR;
+		return NULL;
+	}
+
+	pcp_write(pc, "H", 1);
+	wsize = htonl(sizeof(int));
+	pcp_write(pc, &wsize, sizeof(int));
+	if (pcp_flush(pc) < 0)
+	{
+		if (debug) fprintf(stderr, "DEBUG: could not send data to backend\n");
+		return NULL;
+	}
+	if (debug) fprintf(stderr, "DEBUG pcp_latency_info: send: tos=\"H\", len=%d\n", ntohl(wsize));
+
+	while (1) {
+		if (pcp_read(pc, &tos, 1))
+			break;
+		if (pcp_read(pc, &rsize, sizeof(int)))
+			break;
+		rsize = ntohl(rsize);
+		buf = (char *)malloc(rsize);
+		if (buf == NULL)
+		{
+			errorcode = NOMEMERR;
+			break;
+		}
+		if (pcp_read(pc, buf, rsize - sizeof(int)))
+			break;
+		if (debug) fprintf(stderr, "DEBUG: recv: tos=\"%c\", len=%d, data=%s\n", tos, rsize, buf);
+
+		if (tos == 'e')
+		{
+			if (debug) fprintf(stderr, "DEBUG: command failed. reason=%s\n", buf);
+			errorcode = BACKENDERR;
+			break;
+		}
+		else if (tos == 'h')
+		{
+			char *index;
+
+			if (strcmp(buf, "ArraySize") == 0)
+			{
+				index = (char *) memchr(buf, '\0', rsize) + 1;
+				li_size = ntohl(*((int *)index));
+
+				*array_size = li_size;
+
+				latency = (POOL_REPORT_LATENCY *) malloc(li_size * sizeof(POOL_REPORT_LATENCY));
+				if (latency == NULL && li_size > 0)
+				{
+					errorcode = NOMEMERR;
+					break;
+				}
+			}
+			else if (strcmp(buf, "LatencyInfo") == 0 && offset < li_size)
+			{
+				index = (char *) memchr(buf, '\0', rsize) + 1;
+				strcpy(latency[offset].name, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].count, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].avg, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].p50, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].p90, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].p99, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].p999, index);
+
+				index = (char *) memchr(index, '\0', rsize) + 1;
+				strcpy(latency[offset].max, index);
+
+				offset++;
+			}
+			else if (strcmp(buf, "CommandComplete") == 0)
+			{
+				free(buf);
+				return latency;
+			}
+		}
+
+		free(buf);
+		buf = NULL;
+	}
+
+	free(buf);
+	free(latency);
+	return NULL;
+}
+
 void
 pcp_set_timeout(long sec)
 {
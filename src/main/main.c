@@ -60,6 +60,13 @@
 #include "parser/pool_memory.h"
 #include "parser/pool_string.h"
 #include "pool_passwd.h"
+#include "pool_relcache.h"
+#include "pool_lobj.h"
+#include "pool_latency.h"
+#include "pool_node_stats.h"
+#include "pool_logger.h"
+#include "pool_activity.h"
+#include "pool_query_stats.h"
 #include "utils/pool_memqcache.h"
 #include "watchdog/wd_ext.h"
 
@@ -99,6 +106,8 @@ static int write_status_file(void);
 static pid_t pcp_fork_a_child(int unix_fd, int inet_fd, char *pcp_conf_file);
 static pid_t fork_a_child(int unix_fd, int inet_fd, int id);
 static pid_t worker_fork_a_child(void);
+static pid_t metrics_fork_a_child(void);
+static pid_t logger_fork_a_child(void);
 static int create_unix_domain_socket(struct sockaddr_un un_addr_tmp);
 static int create_inet_domain_socket(const char *hostname, const int port);
 static void myexit(int code);
@@ -176,11 +185,14 @@ static volatile sig_atomic_t wakeup_request = 0;
 
 static int pipe_fds[2]; /* for delivering signals */
 
-int my_proc_id;
+int my_proc_id = -1;
 
 static BackendStatusRecord backend_rec;	/* Backend status record */
 
 static pid_t worker_pid; /* pid of worker process */
+static pid_t metrics_pid; /* pid of metrics exporter process */
+static int metrics_fd;	/* inet domain socket fd for metrics exporter */
+static pid_t logger_pid; /* pid of logger process */
 
 BACKEND_STATUS* my_backend_status[MAX_NUM_BACKENDS];		/* Backend status buffer */
 int my_master_node_id;		/* Master node id buffer */
@@ -566,6 +578,30 @@ int main(int argc, char **argv)
 	}
 	*InRecovery = RECOVERY_INIT;
 
+	/*
+	 * Initialize shared relation cache
+	 */
+	if (pool_config->shared_relcache_size > 0)
+	{
+		if (pool_init_shared_relcache() < 0)
+		{
+			pool_error("pool_init_shared_relcache error");
+			myexit(1);
+		}
+	}
+
+	/*
+	 * Initialize large object OID allocator
+	 */
+	if (pool_config->lobj_oid_block_size > 0)
+	{
+		if (pool_init_lobj_oid_allocator() < 0)
+		{
+			pool_error("pool_init_lobj_oid_allocator error");
+			myexit(1);
+		}
+	}
+
 	/*
 	 * Initialize shared memory cache
 	 */
@@ -626,6 +662,51 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/*
+	 * Initialize query latency histograms
+	 */
+	if (pool_init_latency_stats() < 0)
+	{
+		pool_error("pool_init_latency_stats error");
+		myexit(1);
+	}
+
+	/*
+	 * Initialize per node statement statistics
+	 */
+	if (pool_init_node_stats() < 0)
+	{
+		pool_error("pool_init_node_stats error");
+		myexit(1);
+	}
+
+	/*
+	 * Initialize log buffers
+	 */
+	if (pool_init_log_buffer() < 0)
+	{
+		pool_error("pool_init_log_buffer error");
+		myexit(1);
+	}
+
+	/*
+	 * Initialize per child activity
+	 */
+	if (pool_init_activity() < 0)
+	{
+		pool_error("pool_init_activity error");
+		myexit(1);
+	}
+
+	/*
+	 * Initialize per query statistics
+	 */
+	if (pool_init_query_stats() < 0)
+	{
+		pool_error("pool_init_query_stats error");
+		myexit(1);
+	}
+
 	/* start watchdog */
 	if (pool_config->use_watchdog )
 	{
@@ -644,6 +725,10 @@ int main(int argc, char **argv)
 	 */
 	POOL_SETMASK(&BlockSig);
 
+	/* Fork logger process before children so that they can use it */
+	if (pool_config->log_buffer_size > 0)
+		logger_pid = logger_fork_a_child();
+
 	/* fork the children */
 	for (i=0;i<pool_config->num_init_children;i++)
 	{
@@ -679,6 +764,14 @@ int main(int argc, char **argv)
 	/* Fork worker process */
 	worker_pid = worker_fork_a_child();
 
+	/* Fork metrics exporter process if enabled */
+	if (pool_config->metrics_port > 0)
+	{
+		metrics_fd = create_inet_domain_socket(pool_config->listen_addresses[0] ? pool_config->listen_addresses : "*",
+											   pool_config->metrics_port);
+		metrics_pid = metrics_fork_a_child();
+	}
+
 	retrycnt = 0;		/* reset health check retry counter */
 	sys_retrycnt = 0;	/* reset SystemDB health check retry counter */
 
@@ -1281,6 +1374,74 @@ pid_t worker_fork_a_child()
 	return pid;
 }
 
+/*
+* fork metrics exporter process
+*/
+pid_t metrics_fork_a_child(void)
+{
+	pid_t pid;
+
+	pid = fork();
+
+	if (pid == 0)
+	{
+		if (pipe_fds[0] > 0)
+		{
+			close(pipe_fds[0]);
+			close(pipe_fds[1]);
+		}
+
+		myargv = save_ps_display_args(myargc, myargv);
+
+		/* call metrics exporter main */
+		POOL_SETMASK(&UnBlockSig);
+		reload_config_request = 0;
+		do_metrics_child(metrics_fd);
+	}
+	else if (pid == -1)
+	{
+		pool_error("fork() failed. reason: %s", strerror(errno));
+		myexit(1);
+	}
+	return pid;
+}
+
+/*
+* fork logger process
+*/
+pid_t logger_fork_a_child(void)
+{
+	pid_t pid;
+
+	pid = fork();
+
+	if (pid == 0)
+	{
+		if (pipe_fds[0] > 0)
+		{
+			close(pipe_fds[0]);
+			close(pipe_fds[1]);
+		}
+
+		myargv = save_ps_display_args(myargc, myargv);
+
+		/* call logger main */
+		POOL_SETMASK(&UnBlockSig);
+		reload_config_request = 0;
+		do_logger_child();
+	}
+	else if (pid == -1)
+	{
+		pool_error("fork() failed. reason: %s", strerror(errno));
+		myexit(1);
+	}
+
+	/* From now on log lines are buffered */
+	pool_log_buffer_set_logger(pid);
+
+	return pid;
+}
+
 /*
 * create inet domain socket
 */
@@ -1600,6 +1761,10 @@ static RETSIGTYPE exit_handler(int sig)
 
 	kill(pcp_pid, sig);
 	kill(worker_pid, sig);
+	if (metrics_pid)
+		kill(metrics_pid, sig);
+	if (logger_pid)
+		kill(logger_pid, sig);
 
 	if (pool_config->use_watchdog)
 	{
@@ -1924,6 +2089,26 @@ static void failover(void)
 
 		need_to_restart_children = false;
 	}
+
+	/*
+	 * If neither the master node nor the primary node went down, we
+	 * do not need to restart children either.  The node is marked as
+	 * down in the shared memory and each child closes its connections
+	 * to the node the next time it is idle (see
+	 * pool_detach_down_nodes()), so that existing sessions and
+	 * connection pools to the other nodes are kept.  Since the
+	 * connections to the failed node are closed by the children, we
+	 * do not suffer from the long TCP retry problem mentioned above.
+	 */
+	else if (Req_info->kind == NODE_DOWN_REQUEST && *InRecovery == RECOVERY_INIT &&
+			 Req_info->master_node_id >= 0 && !nodes[Req_info->master_node_id] &&
+			 (Req_info->primary_node_id < 0 || !nodes[Req_info->primary_node_id]))
+	{
+		pool_log("Do not restart children because neither the master node %d nor the primary node %d went down",
+				 Req_info->master_node_id, Req_info->primary_node_id);
+
+		need_to_restart_children = false;
+	}
 	else
 	{
 		pool_log("Restart all children");
@@ -2051,6 +2236,32 @@ static void failover(void)
 	if (pool_config->use_watchdog)
 		wd_end_interlock();
 
+	/*
+	 * If we decided not to restart children because the primary node
+	 * was not down, but the primary node has changed anyway (for
+	 * example, a standby has been promoted meanwhile), existing
+	 * sessions would keep sending writes to the old primary. Restart
+	 * all children in this case.
+	 */
+	if (!need_to_restart_children && Req_info->kind == NODE_DOWN_REQUEST &&
+		new_primary != Req_info->primary_node_id)
+	{
+		pool_log("failover: primary node changed from %d to %d. restart all children",
+				 Req_info->primary_node_id, new_primary);
+
+		for (i = 0; i < pool_config->num_init_children; i++)
+		{
+			pid_t pid = process_info[i].pid;
+			if (pid)
+			{
+				kill(pid, SIGQUIT);
+				pool_debug("failover_handler: kill %d", pid);
+			}
+		}
+
+		need_to_restart_children = true;
+	}
+
 	/* Save primary node id */
 	Req_info->primary_node_id = new_primary;
 	pool_log("failover: set new primary node: %d", Req_info->primary_node_id);
@@ -2071,7 +2282,7 @@ static void failover(void)
 			process_info[i].start_time = time(NULL);
 		}
 	}
-	else
+	else if (Req_info->kind == NODE_UP_REQUEST)
 	{
 		/* Set restart request to each child. Children will exit(1)
 		 * whenever they are idle to restart.
@@ -2386,6 +2597,33 @@ static void reaper(void)
 			pool_log("fork a new worker child pid %d", worker_pid);
 		}
 
+		/* exiting process was metrics exporter process */
+		else if (metrics_pid && pid == metrics_pid)
+		{
+			if (WIFSIGNALED(status))
+				pool_log("metrics exporter %d exits with status %d by signal %d", pid, status, WTERMSIG(status));
+			else
+				pool_log("metrics exporter %d exits with status %d", pid, status);
+
+			metrics_pid = metrics_fork_a_child();
+			pool_log("fork a new metrics exporter pid %d", metrics_pid);
+		}
+
+		/* exiting process was logger process */
+		else if (logger_pid && pid == logger_pid)
+		{
+			/* Write logs by ourselves until new logger starts */
+			pool_log_buffer_set_logger(0);
+
+			if (WIFSIGNALED(status))
+				pool_log("logger process %d exits with status %d by signal %d", pid, status, WTERMSIG(status));
+			else
+				pool_log("logger process %d exits with status %d", pid, status);
+
+			logger_pid = logger_fork_a_child();
+			pool_log("fork a new logger process pid %d", logger_pid);
+		}
+
 		/* exiting process was watchdog process */
 		else if (pool_config->use_watchdog && wd_is_watchdog_pid(pid))
 		{
@@ -2531,6 +2769,12 @@ static void reload_config(void)
 
 	if (worker_pid)
 		kill(worker_pid, SIGHUP);
+
+	if (metrics_pid)
+		kill(metrics_pid, SIGHUP);
+
+	if (logger_pid)
+		kill(logger_pid, SIGHUP);
 }
 
 static void kill_all_children(int sig)
@@ -0,0 +1,310 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_activity.c: Per child activity
+ *
+ * Each child records what it is doing (state, the last query, the DB
+ * nodes the query was sent to and so on) in its own slot on shared
+ * memory. The slot is updated without locking. Instead, changecount
+ * is incremented before and after each update, and readers retry
+ * until they get a copy taken while changecount was even and did not
+ * change. This is much cheaper than updating ps display, which is
+ * therefore rate limited using the time of the last state change
+ * recorded here.
+ */
+#include "config.h"
+#include <string.h>
+#include <sys/time.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_activity.h"
+#include "utils/pool_memqcache.h"
+
+/* Give up reading a slot being updated after this many retries */
+#define ACTIVITY_READ_RETRIES 100
+
+/* Update ps display for each query at most once in this many usec */
+#define PS_DISPLAY_INTERVAL 1000000
+
+/*
+ * Header of activity area placed on shared memory. Slots follow in the
+ * next cache line.
+ */
+typedef struct
+{
+	int num_slots;				/* number of slots (= num_init_children) */
+	size_t slot_size;			/* size of a slot in bytes */
+} POOL_ACTIVITY_AREA;
+
+static POOL_ACTIVITY_AREA *activity_area;
+
+#define ACTIVITY_SLOT(slot) \
+	((volatile POOL_ACTIVITY *)((char *)activity_area + POOL_CACHE_LINE_SIZE + \
+								activity_area->slot_size * (slot)))
+
+#define BEGIN_ACTIVITY_UPDATE(a) \
+	do { \
+		(a)->changecount++; \
+		POOL_MEMORY_BARRIER(); \
+	} while (0)
+
+#define END_ACTIVITY_UPDATE(a) \
+	do { \
+		POOL_MEMORY_BARRIER(); \
+		(a)->changecount++; \
+	} while (0)
+
+static volatile POOL_ACTIVITY *my_activity(void);
+static void set_state(volatile POOL_ACTIVITY *activity, POOL_ACTIVITY_STATE state);
+
+/*
+ * Allocate activity slots on shared memory.
+ */
+int pool_init_activity(void)
+{
+	size_t size;
+	size_t slot_size;
+
+	/* round up slot size so that each slot starts at cache line boundary */
+	slot_size = (sizeof(POOL_ACTIVITY) + POOL_CACHE_LINE_SIZE - 1) / POOL_CACHE_LINE_SIZE * POOL_CACHE_LINE_SIZE;
+
+	size = POOL_CACHE_LINE_SIZE + slot_size * pool_config->num_init_children;
+
+	activity_area = pool_shared_memory_create(size);
+	if (activity_area == NULL)
+	{
+		pool_error("pool_init_activity: failed to allocate shared memory. request size: %zd",
+				   size);
+		return -1;
+	}
+
+	memset(activity_area, 0, size);
+	activity_area->num_slots = pool_config->num_init_children;
+	activity_area->slot_size = slot_size;
+
+	return 0;
+}
+
+/*
+ * Child is waiting for a client to connect. Session info is cleared.
+ */
+void pool_activity_wait_connection(void)
+{
+	volatile POOL_ACTIVITY *activity = my_activity();
+
+	if (!activity)
+		return;
+
+	BEGIN_ACTIVITY_UPDATE(activity);
+	set_state(activity, POOL_ACTIVITY_WAIT_CONNECTION);
+	activity->database[0] = '\0';
+	activity->username[0] = '\0';
+	activity->client[0] = '\0';
+	activity->query[0] = '\0';
+	activity->fingerprint = 0;
+	memset((char *)activity->where_to_send, 0, sizeof(activity->where_to_send));
+	activity->num_statements = 0;
+	activity->num_portals = 0;
+	END_ACTIVITY_UPDATE(activity);
+}
+
+/*
+ * Client has connected.
+ */
+void pool_activity_start_session(const char *database, const char *username, const char *client)
+{
+	volatile POOL_ACTIVITY *activity = my_activity();
+
+	if (!activity)
+		return;
+
+	BEGIN_ACTIVITY_UPDATE(activity);
+	set_state(activity, POOL_ACTIVITY_IDLE);
+	strlcpy((char *)activity->database, database, sizeof(activity->database));
+	strlcpy((char *)activity->username, username, sizeof(activity->username));
+	strlcpy((char *)activity->client, client, sizeof(activity->client));
+	END_ACTIVITY_UPDATE(activity);
+}
+
+/*
+ * Query has been received from client.
+ */
+void pool_activity_start_query(const char *query)
+{
+	volatile POOL_ACTIVITY *activity = my_activity();
+
+	if (!activity)
+		return;
+
+	BEGIN_ACTIVITY_UPDATE(activity);
+	set_state(activity, POOL_ACTIVITY_ACTIVE);
+	activity->query_start = activity->state_change;
+	activity->fingerprint = hash_any((unsigned char *)query, strlen(query));
+	strlcpy((char *)activity->query, query, sizeof(activity->query));
+	memset((char *)activity->where_to_send, 0, sizeof(activity->where_to_send));
+	END_ACTIVITY_UPDATE(activity);
+}
+
+/*
+ * Record DB nodes the current query is sent to.
+ */
+void pool_activity_set_nodes(POOL_QUERY_CONTEXT *query_context)
+{
+	volatile POOL_ACTIVITY *activity = my_activity();
+
+	if (!activity || !query_context)
+		return;
+
+	BEGIN_ACTIVITY_UPDATE(activity);
+	memcpy((char *)activity->where_to_send, query_context->where_to_send,
+		   sizeof(activity->where_to_send));
+	END_ACTIVITY_UPDATE(activity);
+}
+
+/*
+ * Child has finished the query and is waiting for next one.
+ */
+void pool_activity_idle(bool in_transaction)
+{
+	volatile POOL_ACTIVITY *activity = my_activity();
+	POOL_ACTIVITY_STATE state;
+
+	if (!activity)
+		return;
+
+	state = in_transaction ? POOL_ACTIVITY_IDLE_IN_TRANSACTION : POOL_ACTIVITY_IDLE;
+	if (activity->state == state)
+		return;
+
+	BEGIN_ACTIVITY_UPDATE(activity);
+	set_state(activity, state);
+	END_ACTIVITY_UPDATE(activity);
+}
+
+/*
+ * Return true if ps display should show the query the child has just
+ * started. The query is shown at most once in PS_DISPLAY_INTERVAL, and
+ * not at all if the state did not change since the last update. This
+ * reuses the time taken at the state change, so no extra clock read
+ * is needed. Idle states are always shown by pool_ps_idle_display().
+ */
+bool pool_activity_ps_display_due(void)
+{
+	static struct timeval last_update;
+	volatile POOL_ACTIVITY *activity = my_activity();
+	long long int usec;
+
+	if (!activity)
+		return true;
+
+	usec = (long long int)(activity->state_change.tv_sec - last_update.tv_sec) * 1000000 +
+		(activity->state_change.tv_usec - last_update.tv_usec);
+	if (usec < PS_DISPLAY_INTERVAL)
+		return false;
+
+	last_update = activity->state_change;
+	return true;
+}
+
+/*
+ * Record number of prepared statements and portals of the session.
+ */
+void pool_activity_set_sent_messages(int num_statements, int num_portals)
+{
+	volatile POOL_ACTIVITY *activity = my_activity();
+
+	if (!activity)
+		return;
+
+	BEGIN_ACTIVITY_UPDATE(activity);
+	activity->num_statements = num_statements;
+	activity->num_portals = num_portals;
+	END_ACTIVITY_UPDATE(activity);
+}
+
+/*
+ * Copy activity of the child. Returns false if a consistent copy
+ * could not be taken.
+ */
+bool pool_get_activity(int child, POOL_ACTIVITY *activity)
+{
+	volatile POOL_ACTIVITY *slot;
+	unsigned int before;
+	unsigned int after;
+	int i;
+
+	if (!activity_area || child < 0 || child >= activity_area->num_slots)
+		return false;
+
+	slot = ACTIVITY_SLOT(child);
+
+	for (i = 0; i < ACTIVITY_READ_RETRIES; i++)
+	{
+		before = slot->changecount;
+		POOL_MEMORY_BARRIER();
+		memcpy(activity, (char *)slot, sizeof(POOL_ACTIVITY));
+		POOL_MEMORY_BARRIER();
+		after = slot->changecount;
+
+		if (before == after && (before & 1) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Return name of the state shown by SHOW pool_activity.
+ */
+char *pool_activity_state_name(POOL_ACTIVITY_STATE state)
+{
+	switch (state)
+	{
+		case POOL_ACTIVITY_WAIT_CONNECTION:
+			return "wait for connection";
+		case POOL_ACTIVITY_IDLE:
+			return "idle";
+		case POOL_ACTIVITY_IDLE_IN_TRANSACTION:
+			return "idle in transaction";
+		case POOL_ACTIVITY_ACTIVE:
+			return "active";
+	}
+	return "unknown";
+}
+
+/*
+ * Return activity slot of this process. Only children have slots.
+ */
+static volatile POOL_ACTIVITY *my_activity(void)
+{
+	if (!activity_area || my_proc_id < 0 || my_proc_id >= activity_area->num_slots)
+		return NULL;
+
+	return ACTIVITY_SLOT(my_proc_id);
+}
+
+static void set_state(volatile POOL_ACTIVITY *activity, POOL_ACTIVITY_STATE state)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	activity->state = state;
+	activity->state_change = now;
+}
@@ -511,6 +511,7 @@ char *yytext;
 
 #include "pool.h"
 #include "pool_config.h"
+#include "pool_logger.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -1872,6 +1873,7 @@ int pool_init_config(void)
 	pool_config->pcp_port = 9898;
 	pool_config->socket_dir = DEFAULT_SOCKET_DIR;
 	pool_config->pcp_socket_dir = DEFAULT_SOCKET_DIR;
+	pool_config->metrics_port = 0;
 	pool_config->backend_socket_dir = NULL;
 	pool_config->pcp_timeout = 10;
 	pool_config->num_init_children = 32;
@@ -1884,18 +1886,25 @@ int pool_init_config(void)
 	pool_config->logdir = DEFAULT_LOGDIR;
     pool_config->logsyslog = 0;
     pool_config->log_destination = "stderr";
+	pool_config->log_buffer_size = 0;
+	pool_config->log_file = "";
+	pool_config->log_rotation_size = 0;
     pool_config->syslog_facility = LOG_LOCAL0;
     pool_config->syslog_ident = "pgpool";
 	pool_config->pid_file_name = DEFAULT_PID_FILE_NAME;
  	pool_config->log_statement = 0;
  	pool_config->log_per_node_statement = 0;
+	pool_config->log_statement_sample_rate = 1;
+	pool_config->log_min_duration_statement = -1;
 	pool_config->log_connections = 0;
 	pool_config->log_hostname = 0;
+	pool_config->update_process_title = 1;
 	pool_config->enable_pool_hba = 0;
 	pool_config->pool_passwd = "pool_passwd";
 
 	pool_config->replication_mode = 0;
 	pool_config->load_balance_mode = 0;
+	pool_config->multi_statement_load_balance = 0;
 	pool_config->replication_stop_on_mismatch = 0;
 	pool_config->failover_if_affected_tuples_mismatch = 0;
 	pool_config->replicate_select = 0;
@@ -1925,6 +1934,7 @@ int pool_init_config(void)
 	pool_config->failback_command = "";
 	pool_config->fail_over_on_backend_error = 1;
 	pool_config->insert_lock = 1;
+	pool_config->timestamp_sync_interval = 0;
 	pool_config->ignore_leading_white_space = 1;
 	pool_config->parallel_mode = 0;
 	pool_config->enable_query_cache = 0;
@@ -1943,6 +1953,7 @@ int pool_init_config(void)
 	pool_config->search_primary_node_timeout = 10;
 	pool_config->client_idle_limit_in_recovery = 0;
 	pool_config->lobj_lock_table = "";
+	pool_config->lobj_oid_block_size = 0;
 	pool_config->ssl = 0;
 	pool_config->ssl_cert = "";
 	pool_config->ssl_key = "";
@@ -1952,6 +1963,10 @@ int pool_init_config(void)
 	pool_config->relcache_expire = 0;
 	pool_config->relcache_size = 256;
 	pool_config->check_temp_table = 1;
+	pool_config->parse_cache_size = 0;
+	pool_config->query_stats_size = 0;
+	pool_config->shared_relcache_size = 0;
+	pool_config->extended_query_pipelining = 0;
 	pool_config->lists_patterns = NULL;
 	pool_config->pattc = 0;
 	pool_config->current_pattern_size = 0;
@@ -2304,6 +2319,18 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			}
 			pool_config->pcp_socket_dir = str;
 		}
+		else if (!strcmp(key, "metrics_port") && CHECK_CONTEXT(INIT_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || (v != 0 && (v < 1024 || v > 65535)))
+			{
+				pool_error("pool_config: %s must be 0 or between 1024 and 65535", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->metrics_port = v;
+		}
 		else if (!strcmp(key, "pcp_timeout") &&
 			 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
 		{
@@ -2444,6 +2471,48 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
             log_destination_changed = pool_config->log_destination != str;
 			pool_config->log_destination = str;
 		}
+		else if (!strcmp(key, "log_buffer_size") && CHECK_CONTEXT(INIT_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || (v != 0 && v < POOL_LOG_BUFFER_MIN_SIZE))
+			{
+				pool_error("pool_config: %s must be 0 or greater than or equal to %d", key, POOL_LOG_BUFFER_MIN_SIZE);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->log_buffer_size = v;
+		}
+		else if (!strcmp(key, "log_file") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			char *str;
+
+			if (token != POOL_STRING && token != POOL_UNQUOTED_STRING && token != POOL_KEY)
+			{
+				PARSE_ERROR();
+				fclose(fd);
+				return(-1);
+			}
+			str = extract_string(yytext, token);
+			if (str == NULL)
+			{
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->log_file = str;
+		}
+		else if (!strcmp(key, "log_rotation_size") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 0)
+			{
+				pool_error("pool_config: %s must be equal or greater than 0 numeric value", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->log_rotation_size = v;
+		}
 		else if (!strcmp(key, "syslog_facility") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
 		{
 			char *str;
@@ -2526,6 +2595,19 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			}
 			pool_config->log_hostname = v;
 		}
+       	else if (!strcmp(key, "update_process_title") &&
+				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = eval_logical(yytext);
+
+			if (v < 0)
+			{
+				pool_error("pool_config: invalid value %s for %s", yytext, key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->update_process_title = v;
+		}
        	else if (!strcmp(key, "enable_pool_hba") &&
 				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
 		{
@@ -2610,6 +2692,19 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			}
 			pool_config->load_balance_mode = v;
 		}
+		else if (!strcmp(key, "multi_statement_load_balance") &&
+				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = eval_logical(yytext);
+
+			if (v < 0)
+			{
+				pool_error("pool_config: invalid value %s for %s", yytext, key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->multi_statement_load_balance = v;
+		}
 		else if (!strcmp(key, "replication_stop_on_mismatch") &&
 				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
 		{
@@ -3211,6 +3306,20 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			pool_config->insert_lock = v;
 		}
 
+		else if (!strcmp(key, "timestamp_sync_interval") &&
+				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 0)
+			{
+				pool_error("pool_config: %s must be greater or equal to 0 numeric value", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->timestamp_sync_interval = v;
+		}
+
 		else if (!strcmp(key, "ignore_leading_white_space") &&
 				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
 		{
@@ -3600,6 +3709,30 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			}
 			pool_config->log_per_node_statement = v;
 		}
+		else if (!strcmp(key, "log_statement_sample_rate") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 1)
+			{
+				pool_error("pool_config: %s must be greater than or equal to 1", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->log_statement_sample_rate = v;
+		}
+		else if (!strcmp(key, "log_min_duration_statement") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < -1)
+			{
+				pool_error("pool_config: %s must be -1 or greater than or equal to 0", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->log_min_duration_statement = v;
+		}
 
 		else if (!strcmp(key, "lobj_lock_table") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
 		{
@@ -3619,6 +3752,18 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			}
 			pool_config->lobj_lock_table = str;
 		}
+		else if (!strcmp(key, "lobj_oid_block_size") && CHECK_CONTEXT(INIT_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 0)
+			{
+				pool_error("pool_config: %s must be equal or higher than 0 numeric value", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->lobj_oid_block_size = v;
+		}
 		/*
 		 * add for watchdog
 		 */
@@ -4290,6 +4435,58 @@ int pool_get_config(char *confpath, POOL_CONFIG_CONTEXT context)
 			pool_config->check_temp_table = v;
 		}
 
+		else if (!strcmp(key, "parse_cache_size") && CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 0)
+			{
+				pool_error("pool_config: %s must be equal or higher than 0 numeric value", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->parse_cache_size = v;
+		}
+		else if (!strcmp(key, "query_stats_size") && CHECK_CONTEXT(INIT_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 0)
+			{
+				pool_error("pool_config: %s must be equal or higher than 0 numeric value", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->query_stats_size = v;
+		}
+
+		else if (!strcmp(key, "shared_relcache_size") && CHECK_CONTEXT(INIT_CONFIG, context))
+		{
+			int v = atoi(yytext);
+
+			if (token != POOL_INTEGER || v < 0)
+			{
+				pool_error("pool_config: %s must be equal or higher than 0 numeric value", key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->shared_relcache_size = v;
+		}
+
+		else if (!strcmp(key, "extended_query_pipelining") &&
+				 CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
+		{
+			int v = eval_logical(yytext);
+
+			if (v < 0)
+			{
+				pool_error("pool_config: invalid value %s for %s", yytext, key);
+				fclose(fd);
+				return(-1);
+			}
+			pool_config->extended_query_pipelining = v;
+		}
+
         else if (!strcmp(key, "memory_cache_enabled") &&
                  CHECK_CONTEXT(INIT_CONFIG|RELOAD_CONFIG, context))
         {
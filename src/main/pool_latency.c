@@ -0,0 +1,431 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_latency.c: Query latency histograms
+ *
+ * Latency of each query, from receiving the query from frontend to
+ * sending ReadyForQuery (or the cached result) to frontend, is
+ * recorded in log bucketed histograms on shared memory. There is a
+ * histogram for each kind of query (POOL_LATENCY_KIND) and for each
+ * backend node the query was sent to.
+ *
+ * Each child has its own set of histograms, which is updated without
+ * locking. Histograms are summed up over children when read. Processes
+ * other than children share the last set.
+ *
+ * Since the latency of each query is known here, statements taking
+ * log_min_duration_statement or more are logged as well. Sampling of
+ * log_statement and log_per_node_statement is decided here when each
+ * query starts.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_proto_modules.h"
+#include "pool_latency.h"
+#include "pool_query_stats.h"
+
+/*
+ * Latency histograms area placed on shared memory.
+ */
+typedef struct
+{
+	int num_slots;				/* number of slots (children + 1) */
+	int num_histograms;			/* number of histograms per slot */
+	POOL_LATENCY_HISTOGRAM histograms[1];	/* actual data continues... */
+} POOL_LATENCY_AREA;
+
+static POOL_LATENCY_AREA *latency_area;
+
+static struct timeval latency_start_time;	/* when current query started */
+static bool latency_timer_running;
+static bool latency_cache_missed;	/* query cache missed for current query */
+static bool statement_log_sampled = true;	/* log statements of current query */
+static unsigned int statement_log_count;	/* number of queries for sampling */
+
+static int latency_bucket(long long int usec);
+static long long int latency_bucket_upper_bound(int bucket);
+static volatile POOL_LATENCY_HISTOGRAM *my_histograms(void);
+static void latency_record(volatile POOL_LATENCY_HISTOGRAM *histogram, long long int usec);
+static long long int latency_elapsed(void);
+static void log_duration(char *query, bool *where_to_send, long long int usec);
+
+/*
+ * Allocate latency histograms on shared memory. Node histograms are
+ * allocated for backends known at this point.
+ */
+int pool_init_latency_stats(void)
+{
+	size_t size;
+	int num_slots;
+	int num_histograms;
+
+	num_slots = pool_config->num_init_children + 1;
+	num_histograms = POOL_LATENCY_NUM_KINDS + NUM_BACKENDS;
+
+	size = sizeof(POOL_LATENCY_AREA) +
+		sizeof(POOL_LATENCY_HISTOGRAM) * (num_slots * num_histograms - 1);
+
+	latency_area = pool_shared_memory_create(size);
+	if (latency_area == NULL)
+	{
+		pool_error("pool_init_latency_stats: failed to allocate shared memory. request size: %zd",
+				   size);
+		return -1;
+	}
+
+	memset(latency_area, 0, size);
+	latency_area->num_slots = num_slots;
+	latency_area->num_histograms = num_histograms;
+
+	return 0;
+}
+
+/*
+ * Start measuring latency of a query. Whether statements of the query
+ * are logged is decided here too, so that everything logged for the
+ * query, including cache hits and queries pgpool answers by itself,
+ * follows the same decision.
+ */
+void pool_latency_start(void)
+{
+	if (pool_config->log_statement_sample_rate > 1)
+		statement_log_sampled = (++statement_log_count % pool_config->log_statement_sample_rate) == 0;
+	else
+		statement_log_sampled = true;
+
+	gettimeofday(&latency_start_time, NULL);
+	latency_timer_running = true;
+	latency_cache_missed = false;
+}
+
+/*
+ * Start measuring latency unless already started. Used for extended
+ * query protocol where several Execute messages may be sent before
+ * Sync.
+ */
+void pool_latency_start_if_not_running(void)
+{
+	if (!latency_timer_running)
+		pool_latency_start();
+}
+
+/*
+ * Stop measuring latency without recording it. Used for queries
+ * pgpool answers by itself.
+ */
+void pool_latency_stop(void)
+{
+	latency_timer_running = false;
+}
+
+/*
+ * Remember query cache was searched but the result was not found.
+ */
+void pool_latency_cache_miss(void)
+{
+	latency_cache_missed = true;
+}
+
+/*
+ * Record latency of a query whose result was returned from query
+ * cache. parse_tree may be NULL if the query has not been parsed.
+ */
+void pool_latency_cache_hit(char *query, Node *parse_tree)
+{
+	long long int usec;
+
+	if (!latency_area || !latency_timer_running)
+		return;
+
+	usec = latency_elapsed();
+	latency_record(&my_histograms()[POOL_LATENCY_CACHE_HIT], usec);
+	latency_timer_running = false;
+
+	if (pool_config->log_min_duration_statement >= 0 &&
+		usec >= (long long int)pool_config->log_min_duration_statement * 1000)
+		log_duration(query, NULL, usec);
+
+	pool_query_stats_record(query, parse_tree, POOL_LATENCY_CACHE_HIT, NULL, usec);
+}
+
+/*
+ * Record latency of a query at ReadyForQuery. The query is counted in
+ * the histogram of the kind of the query and in the histogram of each
+ * node it was sent to.
+ */
+void pool_latency_query_done(POOL_QUERY_CONTEXT *query_context)
+{
+	volatile POOL_LATENCY_HISTOGRAM *histograms;
+	POOL_LATENCY_KIND kind;
+	Node *parse_tree;
+	long long int usec;
+	int i;
+
+	if (!latency_area || !latency_timer_running)
+		return;
+
+	latency_timer_running = false;
+
+	if (!query_context)
+		return;
+
+	usec = latency_elapsed();
+	histograms = my_histograms();
+
+	if (pool_config->log_min_duration_statement >= 0 &&
+		usec >= (long long int)pool_config->log_min_duration_statement * 1000)
+		log_duration(query_context->original_query, query_context->where_to_send, usec);
+
+	if (latency_cache_missed)
+		kind = POOL_LATENCY_CACHE_MISS;
+	else if (query_context->parse_tree &&
+			 !pool_multi_node_to_be_sent(query_context) &&
+			 is_select_query(query_context->parse_tree, query_context->original_query))
+		kind = POOL_LATENCY_READ;
+	else
+		kind = POOL_LATENCY_WRITE;
+
+	latency_record(&histograms[kind], usec);
+
+	for (i=0;i<latency_area->num_histograms - POOL_LATENCY_NUM_KINDS;i++)
+	{
+		if (query_context->where_to_send[i])
+			latency_record(&histograms[POOL_LATENCY_NUM_KINDS + i], usec);
+	}
+
+	if (query_context->is_parse_error)
+		parse_tree = NULL;
+	else if (query_context->is_multi_statement && query_context->parse_tree_list != NIL)
+		parse_tree = (Node *) query_context->parse_tree_list;
+	else
+		parse_tree = query_context->parse_tree;
+
+	pool_query_stats_record(query_context->original_query, parse_tree,
+							kind, query_context->where_to_send, usec);
+}
+
+/*
+ * Return true if statements of current query should be logged by
+ * log_statement and log_per_node_statement. Only 1 in
+ * log_statement_sample_rate queries are logged.
+ */
+bool pool_log_statement_sampled(void)
+{
+	return statement_log_sampled;
+}
+
+/*
+ * Return number of histograms.
+ */
+int pool_latency_num_histograms(void)
+{
+	if (!latency_area)
+		return 0;
+	return latency_area->num_histograms;
+}
+
+/*
+ * Return name of the histogram. The result is in static area and
+ * will be overwritten by next call to this function.
+ */
+char *pool_latency_histogram_name(int index)
+{
+	static char *kind_names[] = {"read", "write", "cache_hit", "cache_miss"};
+	static char buf[32];
+
+	if (index < POOL_LATENCY_NUM_KINDS)
+		return kind_names[index];
+
+	snprintf(buf, sizeof(buf), "node%d", index - POOL_LATENCY_NUM_KINDS);
+	return buf;
+}
+
+/*
+ * Sum up the histogram over all slots. Since histograms are updated
+ * without locking, the result may miss counts being updated at the
+ * same time.
+ */
+void pool_latency_get_histogram(int index, POOL_LATENCY_HISTOGRAM *histogram)
+{
+	volatile POOL_LATENCY_HISTOGRAM *h;
+	int i, j;
+
+	memset(histogram, 0, sizeof(POOL_LATENCY_HISTOGRAM));
+
+	if (!latency_area || index < 0 || index >= latency_area->num_histograms)
+		return;
+
+	for (i=0;i<latency_area->num_slots;i++)
+	{
+		h = &latency_area->histograms[i * latency_area->num_histograms + index];
+
+		histogram->count += h->count;
+		histogram->total_usec += h->total_usec;
+		if (h->max_usec > histogram->max_usec)
+			histogram->max_usec = h->max_usec;
+		for (j=0;j<POOL_LATENCY_BUCKETS;j++)
+			histogram->buckets[j] += h->buckets[j];
+	}
+}
+
+/*
+ * Return latency in usec below which "percentile" (0-100) percent of
+ * queries fall. The result is the upper bound of the bucket and is
+ * never greater than the max latency.
+ */
+long long int pool_latency_percentile(POOL_LATENCY_HISTOGRAM *histogram, double percentile)
+{
+	long long int rank;
+	long long int n = 0;
+	long long int usec;
+	int i;
+
+	if (histogram->count <= 0)
+		return 0;
+
+	rank = (long long int)(histogram->count * percentile / 100.0 + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	for (i=0;i<POOL_LATENCY_BUCKETS;i++)
+	{
+		n += histogram->buckets[i];
+		if (n >= rank)
+		{
+			usec = latency_bucket_upper_bound(i);
+			return usec < histogram->max_usec ? usec : histogram->max_usec;
+		}
+	}
+
+	return histogram->max_usec;
+}
+
+/*
+ * Return bucket index of the latency. Values less than 4 have their
+ * own bucket. Other values are bucketed by position of the most
+ * significant bit and the next 2 bits.
+ */
+static int latency_bucket(long long int usec)
+{
+	int msb;
+
+	if (usec < POOL_LATENCY_SUB_BUCKETS)
+		return usec < 0 ? 0 : (int)usec;
+
+	if (usec >= (1LL << 32))
+		return POOL_LATENCY_BUCKETS - 1;
+
+	for (msb = 2; (usec >> (msb + 1)) != 0; msb++)
+		;
+
+	return (msb - 1) * POOL_LATENCY_SUB_BUCKETS + (int)((usec >> (msb - 2)) & 3);
+}
+
+/*
+ * Return largest latency which falls into the bucket.
+ */
+static long long int latency_bucket_upper_bound(int bucket)
+{
+	int msb;
+	int sub;
+
+	if (bucket < POOL_LATENCY_SUB_BUCKETS)
+		return bucket;
+
+	if (bucket >= POOL_LATENCY_BUCKETS - 1)
+		return 0x7fffffffffffffffLL;
+
+	msb = bucket / POOL_LATENCY_SUB_BUCKETS + 1;
+	sub = bucket % POOL_LATENCY_SUB_BUCKETS;
+
+	return ((long long int)(POOL_LATENCY_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+/*
+ * Return histograms of this process.
+ */
+static volatile POOL_LATENCY_HISTOGRAM *my_histograms(void)
+{
+	int slot;
+
+	if (my_proc_id >= 0 && my_proc_id < latency_area->num_slots - 1)
+		slot = my_proc_id;
+	else
+		slot = latency_area->num_slots - 1;
+
+	return &latency_area->histograms[slot * latency_area->num_histograms];
+}
+
+static void latency_record(volatile POOL_LATENCY_HISTOGRAM *histogram, long long int usec)
+{
+	histogram->count++;
+	histogram->total_usec += usec;
+	if (usec > histogram->max_usec)
+		histogram->max_usec = usec;
+	histogram->buckets[latency_bucket(usec)]++;
+}
+
+/*
+ * Return elapsed time since the query started in usec.
+ */
+static long long int latency_elapsed(void)
+{
+	struct timeval now;
+	long long int usec;
+
+	gettimeofday(&now, NULL);
+	usec = (long long int)(now.tv_sec - latency_start_time.tv_sec) * 1000000 +
+		(now.tv_usec - latency_start_time.tv_usec);
+
+	return usec < 0 ? 0 : usec;
+}
+
+/*
+ * Log the statement with its duration and the nodes it was sent to.
+ * where_to_send is NULL if the result was returned from query cache.
+ */
+static void log_duration(char *query, bool *where_to_send, long long int usec)
+{
+	char nodes[MAX_NUM_BACKENDS * 4 + 1];
+	char *p = nodes;
+	int i;
+
+	if (where_to_send == NULL)
+	{
+		pool_log("duration: %lld.%03lld ms query cache statement: %s",
+				 usec / 1000, usec % 1000, query ? query : "");
+		return;
+	}
+
+	*p = '\0';
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (where_to_send[i])
+			p += snprintf(p, sizeof(nodes) - (p - nodes), "%s%d", p == nodes ? "" : ",", i);
+	}
+
+	pool_log("duration: %lld.%03lld ms DB node id: %s statement: %s",
+			 usec / 1000, usec % 1000, nodes, query ? query : "");
+}
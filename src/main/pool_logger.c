@@ -0,0 +1,468 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_logger.c: log buffers and logger process
+ *
+ * If log_buffer_size is set, log lines are not written to stderr by
+ * each process. Instead they are copied into a ring buffer on shared
+ * memory and the logger process drains the buffers and writes them to
+ * log_file (or stderr) in batches.
+ *
+ * Each child has its own ring buffer which has only one writer (the
+ * child) and one reader (the logger), so no locking is needed.
+ * Processes other than children share the last buffer under
+ * LOG_BUFFER_SEM. A log line is published only after it is copied as
+ * a whole, so lines from different processes never interleave.
+ *
+ * If the logger is not running, or the buffer stays full for a while,
+ * the line is written to stderr directly as before.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_logger.h"
+
+/* Sleep time of the logger in usec when there's nothing to write */
+#define LOGGER_NAPTIME 10000
+
+/* Number of idle loops before the logger exits on shutdown request */
+#define LOGGER_EXIT_IDLE_LOOPS 3
+
+/* How many times writer waits for free space, 1 msec each */
+#define LOG_BUFFER_MAX_WAITS 1000
+
+/* Size of logger's write buffer */
+#define LOGGER_WRITE_BUFFER_SIZE 65536
+
+/*
+ * Ring buffer. Positions are byte counts since the start and wrap
+ * around at 2^32, which is a multiple of the buffer size. Data of
+ * the buffer follows this struct.
+ */
+typedef struct {
+	volatile unsigned int head;		/* written so far. updated by writer */
+	char pad1[POOL_CACHE_LINE_SIZE - sizeof(unsigned int)];
+	volatile unsigned int tail;		/* read so far. updated by logger */
+	char pad2[POOL_CACHE_LINE_SIZE - sizeof(unsigned int)];
+} POOL_LOG_RING;
+
+/*
+ * Log buffer area placed on shared memory. Rings start at the second
+ * cache line.
+ */
+typedef struct {
+	volatile pid_t logger_pid;	/* 0 if logger is not running */
+	int num_slots;				/* number of rings (children + 1) */
+	unsigned int buffer_size;	/* size of data in each ring. power of 2 */
+} POOL_LOG_AREA;
+
+#define LOG_RING(slot) \
+	((POOL_LOG_RING *)((char *)log_area + POOL_CACHE_LINE_SIZE + \
+					   (size_t)(slot) * (sizeof(POOL_LOG_RING) + log_area->buffer_size)))
+#define LOG_RING_DATA(ring) ((char *)(ring) + sizeof(POOL_LOG_RING))
+
+static POOL_LOG_AREA *log_area;
+static bool am_logger;			/* true if I am the logger process */
+static bool in_log_buffer_write;	/* to avoid recursion */
+
+static int log_fd = -1;			/* file descriptor logger writes to */
+static off_t log_file_size;		/* bytes written to current log file */
+static char write_buffer[LOGGER_WRITE_BUFFER_SIZE];
+static int write_buffer_len;
+
+static volatile sig_atomic_t reload_config_request = 0;
+static volatile sig_atomic_t shutdown_request = 0;
+
+static RETSIGTYPE my_signal_handler(int sig);
+static RETSIGTYPE reload_config_handler(int sig);
+static void reload_config(void);
+static int logger_drain(void);
+static void logger_append(const char *data, int len);
+static void logger_flush(void);
+static void logger_open_file(void);
+static void logger_rotate_file(void);
+
+/*
+ * Allocate log buffers on shared memory. Nothing is done if
+ * log_buffer_size is 0.
+ */
+int pool_init_log_buffer(void)
+{
+	size_t size;
+	unsigned int buffer_size;
+	int num_slots;
+
+	if (pool_config->log_buffer_size <= 0)
+		return 0;
+
+	buffer_size = POOL_LOG_BUFFER_MIN_SIZE;
+	while (buffer_size < pool_config->log_buffer_size)
+		buffer_size <<= 1;
+
+	num_slots = pool_config->num_init_children + 1;
+	size = POOL_CACHE_LINE_SIZE + (size_t)num_slots * (sizeof(POOL_LOG_RING) + buffer_size);
+
+	log_area = pool_shared_memory_create(size);
+	if (log_area == NULL)
+	{
+		pool_error("pool_init_log_buffer: failed to allocate shared memory. request size: %zd",
+				   size);
+		return -1;
+	}
+
+	memset(log_area, 0, size);
+	log_area->num_slots = num_slots;
+	log_area->buffer_size = buffer_size;
+
+	return 0;
+}
+
+/*
+ * Register pid of the logger process. Log lines are buffered only
+ * while the logger is registered. 0 means no logger is running.
+ */
+void pool_log_buffer_set_logger(pid_t pid)
+{
+	if (log_area)
+		log_area->logger_pid = pid;
+}
+
+/*
+ * Copy a log line into the log buffer of this process. Returns false
+ * if the line was not buffered, in which case the caller must write
+ * it by itself.
+ */
+bool pool_log_buffer_write(const char *msg, int len)
+{
+	POOL_LOG_RING *ring;
+	unsigned int head;
+	unsigned int pos;
+	unsigned int first;
+	bool shared;
+	int waits = 0;
+
+	if (!log_area || !log_area->logger_pid || am_logger || in_log_buffer_write)
+		return false;
+
+	if (len <= 0 || len > log_area->buffer_size)
+		return false;
+
+	in_log_buffer_write = true;
+
+	shared = (my_proc_id < 0 || my_proc_id >= log_area->num_slots - 1);
+	if (shared)
+	{
+		pool_semaphore_lock(LOG_BUFFER_SEM);
+		ring = LOG_RING(log_area->num_slots - 1);
+	}
+	else
+		ring = LOG_RING(my_proc_id);
+
+	head = ring->head;
+
+	/* Wait for the logger to make room */
+	while (log_area->buffer_size - (head - ring->tail) < len)
+	{
+		if (!log_area->logger_pid || ++waits > LOG_BUFFER_MAX_WAITS)
+		{
+			if (shared)
+				pool_semaphore_unlock(LOG_BUFFER_SEM);
+			in_log_buffer_write = false;
+			return false;
+		}
+		usleep(1000);
+	}
+
+	pos = head & (log_area->buffer_size - 1);
+	first = log_area->buffer_size - pos;
+	if (first > len)
+		first = len;
+
+	memcpy(LOG_RING_DATA(ring) + pos, msg, first);
+	if (first < len)
+		memcpy(LOG_RING_DATA(ring), msg + first, len - first);
+
+	/* Make sure the data is visible before the new head */
+	POOL_MEMORY_BARRIER();
+	ring->head = head + len;
+
+	if (shared)
+		pool_semaphore_unlock(LOG_BUFFER_SEM);
+	in_log_buffer_write = false;
+
+	return true;
+}
+
+/*
+ * logger process main loop
+ */
+void do_logger_child(void)
+{
+	int idle_loops = 0;
+
+	am_logger = true;
+
+	/* Identify myself via ps */
+	init_ps_display("", "", "", "");
+	set_ps_display("logger process", false);
+
+	/* set up signal handlers */
+	signal(SIGALRM, SIG_DFL);
+	signal(SIGTERM, my_signal_handler);
+	signal(SIGINT, my_signal_handler);
+	signal(SIGHUP, reload_config_handler);
+	signal(SIGQUIT, my_signal_handler);
+	signal(SIGCHLD, SIG_IGN);
+	signal(SIGUSR1, SIG_IGN);
+	signal(SIGUSR2, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+
+	logger_open_file();
+
+	for (;;)
+	{
+		if (reload_config_request)
+		{
+			reload_config();
+			reload_config_request = 0;
+		}
+
+		if (logger_drain() > 0)
+		{
+			idle_loops = 0;
+
+			if (*pool_config->log_file && pool_config->log_rotation_size > 0 &&
+				log_file_size >= (off_t)pool_config->log_rotation_size * 1024)
+				logger_rotate_file();
+			continue;
+		}
+
+		/*
+		 * On shutdown, keep draining until children which are exiting
+		 * at the same time have finished writing.
+		 */
+		if (shutdown_request && ++idle_loops >= LOGGER_EXIT_IDLE_LOOPS)
+			break;
+
+		usleep(LOGGER_NAPTIME);
+	}
+
+	pool_log_buffer_set_logger(0);
+	logger_drain();
+	exit(0);
+}
+
+/*
+ * Write out all buffered log lines. Returns number of bytes written.
+ */
+static int logger_drain(void)
+{
+	POOL_LOG_RING *ring;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int pos;
+	unsigned int len;
+	unsigned int first;
+	int total = 0;
+	int i;
+
+	for (i = 0; i < log_area->num_slots; i++)
+	{
+		ring = LOG_RING(i);
+		head = ring->head;
+		tail = ring->tail;
+
+		if (head == tail)
+			continue;
+
+		/* Make sure we read the data written before head */
+		POOL_MEMORY_BARRIER();
+
+		len = head - tail;
+		pos = tail & (log_area->buffer_size - 1);
+		first = log_area->buffer_size - pos;
+		if (first > len)
+			first = len;
+
+		logger_append(LOG_RING_DATA(ring) + pos, first);
+		if (first < len)
+			logger_append(LOG_RING_DATA(ring), len - first);
+
+		/* Data must be copied before the writer reuses the space */
+		POOL_MEMORY_BARRIER();
+		ring->tail = head;
+
+		total += len;
+	}
+
+	logger_flush();
+
+	return total;
+}
+
+static void logger_append(const char *data, int len)
+{
+	int n;
+
+	while (len > 0)
+	{
+		if (write_buffer_len == sizeof(write_buffer))
+			logger_flush();
+
+		n = sizeof(write_buffer) - write_buffer_len;
+		if (n > len)
+			n = len;
+
+		memcpy(write_buffer + write_buffer_len, data, n);
+		write_buffer_len += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static void logger_flush(void)
+{
+	int offset = 0;
+	int n;
+
+	while (offset < write_buffer_len)
+	{
+		n = write(log_fd, write_buffer + offset, write_buffer_len - offset);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			/* Nowhere to complain. Discard the data */
+			break;
+		}
+		offset += n;
+	}
+
+	log_file_size += offset;
+	write_buffer_len = 0;
+}
+
+/*
+ * Open log_file for append. If log_file is empty or cannot be opened,
+ * stderr is used.
+ */
+static void logger_open_file(void)
+{
+	struct stat st;
+	int fd;
+
+	if (log_fd > STDERR_FILENO)
+		close(log_fd);
+
+	log_fd = STDERR_FILENO;
+	log_file_size = 0;
+
+	if (*pool_config->log_file == '\0')
+		return;
+
+	fd = open(pool_config->log_file, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (fd < 0)
+	{
+		pool_error("logger: could not open log file \"%s\". reason: %s",
+				   pool_config->log_file, strerror(errno));
+		return;
+	}
+
+	if (fstat(fd, &st) == 0)
+		log_file_size = st.st_size;
+
+	log_fd = fd;
+}
+
+/*
+ * Rename current log file to log_file.YYYYmmdd-HHMMSS and open new
+ * one.
+ */
+static void logger_rotate_file(void)
+{
+	char path[POOLMAXPATHLEN+1];
+	char timestr[32];
+	time_t now = time(NULL);
+
+	strftime(timestr, sizeof(timestr), "%Y%m%d-%H%M%S", localtime(&now));
+	snprintf(path, sizeof(path), "%s.%s", pool_config->log_file, timestr);
+
+	if (rename(pool_config->log_file, path) < 0)
+	{
+		pool_error("logger: could not rename log file \"%s\" to \"%s\". reason: %s",
+				   pool_config->log_file, path, strerror(errno));
+		log_file_size = 0;
+		return;
+	}
+
+	logger_open_file();
+}
+
+static RETSIGTYPE my_signal_handler(int sig)
+{
+	POOL_SETMASK(&BlockSig);
+
+	switch (sig)
+	{
+		case SIGTERM:
+		case SIGINT:
+		case SIGQUIT:
+			shutdown_request = 1;
+			break;
+
+		default:
+			exit(1);
+			break;
+	}
+
+	POOL_SETMASK(&UnBlockSig);
+}
+
+static RETSIGTYPE reload_config_handler(int sig)
+{
+	POOL_SETMASK(&BlockSig);
+	reload_config_request = 1;
+	POOL_SETMASK(&UnBlockSig);
+}
+
+/*
+ * Reload config and reopen log file. Reopening allows external log
+ * rotation tools to move the log file away.
+ */
+static void reload_config(void)
+{
+	pool_get_config(get_config_file_name(), RELOAD_CONFIG);
+	logger_drain();
+	logger_open_file();
+	reload_config_request = 0;
+}
@@ -0,0 +1,597 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_metrics.c: metrics exporter process
+ *
+ * The metrics exporter accepts HTTP requests on metrics_port and
+ * returns statistics in Prometheus text format. Statistics are read
+ * from shared memory by using the same functions as SHOW commands, so
+ * no pgpool child is occupied by monitoring. Requests are served one
+ * at a time.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+
+#include <signal.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_process_reporting.h"
+#include "pool_latency.h"
+#include "utils/pool_memqcache.h"
+
+/* Max length of HTTP request header we accept */
+#define METRICS_MAX_REQUEST_LEN 8192
+
+/* Timeout in seconds for reading a request */
+#define METRICS_REQUEST_TIMEOUT 10
+
+/* Response body buffer */
+typedef struct {
+	char *data;
+	size_t len;
+	size_t size;
+	bool failed;		/* true if memory allocation failed */
+} METRICS_BUFFER;
+
+static volatile sig_atomic_t reload_config_request = 0;
+
+static RETSIGTYPE my_signal_handler(int sig);
+static RETSIGTYPE reload_config_handler(int sig);
+static void reload_config(void);
+static void metrics_handle_request(int fd);
+static bool metrics_read_request(int fd, char *buf, int buflen);
+static void metrics_send_response(int fd, char *status, char *body, size_t len);
+static void metrics_render(METRICS_BUFFER *buf);
+static void metrics_printf(METRICS_BUFFER *buf, const char *fmt, ...)
+#ifdef __GNUC__
+__attribute__((format(printf, 2, 3)))
+#endif
+;
+static void metrics_header(METRICS_BUFFER *buf, char *name, char *type, char *help);
+static char *metrics_escape(const char *src, char *dst, size_t dstlen);
+
+#define CHECK_REQUEST \
+	do { \
+		if (reload_config_request) \
+		{ \
+			reload_config(); \
+			reload_config_request = 0; \
+		} \
+    } while (0)
+
+/*
+ * metrics exporter main loop
+ */
+void do_metrics_child(int fd)
+{
+	fd_set rmask;
+	int afd;
+	int n;
+
+	pool_debug("I am metrics exporter %d", getpid());
+
+	/* Identify myself via ps */
+	init_ps_display("", "", "", "");
+	set_ps_display("metrics exporter", false);
+
+	/* set up signal handlers */
+	signal(SIGALRM, SIG_DFL);
+	signal(SIGTERM, my_signal_handler);
+	signal(SIGINT, my_signal_handler);
+	signal(SIGHUP, reload_config_handler);
+	signal(SIGQUIT, my_signal_handler);
+	signal(SIGCHLD, SIG_IGN);
+	signal(SIGUSR1, SIG_IGN);
+	signal(SIGUSR2, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;)
+	{
+		CHECK_REQUEST;
+
+		FD_ZERO(&rmask);
+		FD_SET(fd, &rmask);
+
+		/* select(2) returns EINTR on signals, so reload request is checked */
+		n = select(fd+1, &rmask, NULL, NULL, NULL);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			pool_error("do_metrics_child: select() failed. reason: %s", strerror(errno));
+			exit(1);
+		}
+
+		afd = accept(fd, NULL, NULL);
+		if (afd < 0)
+		{
+			if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK &&
+				errno != ECONNABORTED)
+				pool_error("do_metrics_child: accept() failed. reason: %s", strerror(errno));
+			continue;
+		}
+
+		metrics_handle_request(afd);
+		close(afd);
+	}
+	exit(0);
+}
+
+/*
+ * Read a HTTP request and send the response.
+ */
+static void metrics_handle_request(int fd)
+{
+	char request[METRICS_MAX_REQUEST_LEN+1];
+	char *path;
+	char *p;
+	METRICS_BUFFER buf;
+
+	if (!metrics_read_request(fd, request, sizeof(request)))
+		return;
+
+	if (strncmp(request, "GET ", 4))
+	{
+		metrics_send_response(fd, "405 Method Not Allowed", "method not allowed\n", 19);
+		return;
+	}
+
+	path = request + 4;
+	p = strpbrk(path, " \r\n?");
+	if (p)
+		*p = '\0';
+
+	if (strcmp(path, "/metrics") && strcmp(path, "/"))
+	{
+		metrics_send_response(fd, "404 Not Found", "not found\n", 10);
+		return;
+	}
+
+	memset(&buf, 0, sizeof(buf));
+	metrics_render(&buf);
+
+	if (buf.failed)
+	{
+		metrics_send_response(fd, "500 Internal Server Error", "out of memory\n", 14);
+	}
+	else
+	{
+		metrics_send_response(fd, "200 OK", buf.data, buf.len);
+	}
+	free(buf.data);
+}
+
+/*
+ * Read HTTP request header up to the empty line. Returns false if the
+ * client closed the connection, timed out or sent too long header.
+ */
+static bool metrics_read_request(int fd, char *buf, int buflen)
+{
+	int len = 0;
+	int n;
+	fd_set rmask;
+	struct timeval timeout;
+
+	for (;;)
+	{
+		FD_ZERO(&rmask);
+		FD_SET(fd, &rmask);
+		timeout.tv_sec = METRICS_REQUEST_TIMEOUT;
+		timeout.tv_usec = 0;
+
+		n = select(fd+1, &rmask, NULL, NULL, &timeout);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		else if (n == 0)
+		{
+			pool_debug("metrics_read_request: timeout while reading request");
+			return false;
+		}
+
+		n = read(fd, buf + len, buflen - 1 - len);
+		if (n < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return false;
+		}
+		else if (n == 0)
+			return false;
+
+		len += n;
+		buf[len] = '\0';
+
+		if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n"))
+			return true;
+
+		if (len >= buflen - 1)
+		{
+			pool_debug("metrics_read_request: too long request");
+			return false;
+		}
+	}
+}
+
+/*
+ * Send HTTP response and close the connection.
+ */
+static void metrics_send_response(int fd, char *status, char *body, size_t len)
+{
+	char header[256];
+	int hlen;
+	size_t offset;
+	ssize_t n;
+	int i;
+
+	hlen = snprintf(header, sizeof(header),
+					"HTTP/1.0 %s\r\n"
+					"Content-Type: text/plain; version=0.0.4\r\n"
+					"Content-Length: %zu\r\n"
+					"Connection: close\r\n"
+					"\r\n", status, len);
+
+	for (i = 0; i < 2; i++)
+	{
+		char *p = i == 0 ? header : body;
+		size_t plen = i == 0 ? hlen : len;
+
+		offset = 0;
+		while (offset < plen)
+		{
+			n = write(fd, p + offset, plen - offset);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				pool_debug("metrics_send_response: write() failed. reason: %s", strerror(errno));
+				return;
+			}
+			offset += n;
+		}
+	}
+}
+
+/*
+ * Render all metrics into "buf".
+ */
+static void metrics_render(METRICS_BUFFER *buf)
+{
+	POOL_REPORT_VERSION *version;
+	POOL_REPORT_PROCESSES *processes;
+	POOL_REPORT_POOLS *pools;
+	POOL_REPORT_NODES *nodes;
+	POOL_LATENCY_HISTOGRAM histogram;
+	char labels[MAX_NUM_BACKENDS][POOLCONFIG_MAXIDENTLEN*2+128];
+	char escaped[POOLCONFIG_MAXIDENTLEN*2+1];
+	long long int connections[MAX_NUM_BACKENDS];
+	long long int copy_count = 0;
+	long long int copy_bytes = 0;
+	long long int copy_usec = 0;
+	static double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+	int nrows;
+	int nnodes;
+	int active;
+	int i, j;
+
+	/* version */
+	version = get_version();
+	if (version)
+	{
+		metrics_header(buf, "pgpool_info", "gauge", "pgpool-II version");
+		metrics_printf(buf, "pgpool_info{version=\"%s\"} 1\n",
+					   metrics_escape(version->version, escaped, sizeof(escaped)));
+		free(version);
+	}
+
+	/* children */
+	metrics_header(buf, "pgpool_num_init_children", "gauge", "Number of pgpool child processes");
+	metrics_printf(buf, "pgpool_num_init_children %d\n", pool_config->num_init_children);
+
+	metrics_header(buf, "pgpool_max_pool", "gauge", "Number of connection pool slots per child");
+	metrics_printf(buf, "pgpool_max_pool %d\n", pool_config->max_pool);
+
+	processes = get_processes(&nrows);
+	if (processes)
+	{
+		active = 0;
+		for (i = 0; i < nrows; i++)
+		{
+			if (processes[i].database[0])
+				active++;
+		}
+		free(processes);
+
+		metrics_header(buf, "pgpool_children_with_connection", "gauge", "Number of children having pooled connections");
+		metrics_printf(buf, "pgpool_children_with_connection %d\n", active);
+	}
+
+	/* nodes */
+	nodes = get_nodes(&nnodes);
+	if (!nodes)
+	{
+		buf->failed = true;
+		return;
+	}
+
+	for (i = 0; i < nnodes; i++)
+	{
+		snprintf(labels[i], sizeof(labels[i]), "node_id=\"%s\",hostname=\"%s\",port=\"%s\",role=\"%s\"",
+				 nodes[i].node_id,
+				 metrics_escape(nodes[i].hostname, escaped, sizeof(escaped)),
+				 nodes[i].port, nodes[i].role);
+	}
+
+#define NODE_METRIC(name, type, help, field) \
+	do { \
+		metrics_header(buf, name, type, help); \
+		for (i = 0; i < nnodes; i++) \
+			metrics_printf(buf, "%s{%s} %s\n", name, labels[i], nodes[i].field); \
+	} while (0)
+
+	NODE_METRIC("pgpool_backend_status", "gauge", "Backend status (1: up no connection 2: up 3: down)", status);
+	NODE_METRIC("pgpool_backend_lb_weight", "gauge", "Load balance weight of backend", lb_weight);
+	NODE_METRIC("pgpool_backend_select_total", "counter", "Number of SELECTs sent to backend", select_cnt);
+	NODE_METRIC("pgpool_backend_write_total", "counter", "Number of other statements sent to backend", write_cnt);
+	NODE_METRIC("pgpool_backend_transactions_total", "counter", "Number of transactions finished", xact_cnt);
+	NODE_METRIC("pgpool_backend_received_bytes_total", "counter", "Bytes received from backend", bytes_in);
+	NODE_METRIC("pgpool_backend_sent_bytes_total", "counter", "Bytes sent to backend", bytes_out);
+	NODE_METRIC("pgpool_backend_errors_total", "counter", "Number of errors returned by backend", error_cnt);
+
+#undef NODE_METRIC
+
+	/* backend connections */
+	pools = get_pools(&nrows);
+	if (pools)
+	{
+		memset(connections, 0, sizeof(connections));
+		for (i = 0; i < nrows; i++)
+		{
+			if (pools[i].pool_connected && pools[i].backend_id < MAX_NUM_BACKENDS)
+				connections[pools[i].backend_id]++;
+		}
+		free(pools);
+
+		metrics_header(buf, "pgpool_backend_connections", "gauge", "Number of pooled connections to backend");
+		for (i = 0; i < nnodes; i++)
+			metrics_printf(buf, "pgpool_backend_connections{%s} %lld\n", labels[i], connections[i]);
+	}
+	free(nodes);
+
+	/* query cache */
+	if (pool_config->memory_cache_enabled)
+	{
+		POOL_QUERY_CACHE_STATS cache_stats;
+		POOL_SHMEM_STATS shmem_stats;
+#ifdef HAVE_SIGPROCMASK
+		sigset_t oldmask;
+#else
+		int	oldmask;
+#endif
+
+		memset(&shmem_stats, 0, sizeof(shmem_stats));
+
+		if (pool_is_shmem_cache())
+		{
+			POOL_SETMASK2(&BlockSig, &oldmask);
+			pool_shmem_lock(POOL_MEMQ_SHARED_LOCK);
+			shmem_stats = *pool_get_shmem_storage_stats();
+			pool_shmem_unlock();
+			POOL_SETMASK(&oldmask);
+			cache_stats = shmem_stats.cache_stats;
+		}
+		else
+		{
+			cache_stats = *pool_get_memqcache_stats();
+		}
+
+		metrics_header(buf, "pgpool_query_cache_hits_total", "counter", "Number of SELECTs returned from query cache");
+		metrics_printf(buf, "pgpool_query_cache_hits_total %lld\n", cache_stats.num_cache_hits);
+		metrics_header(buf, "pgpool_query_cache_misses_total", "counter", "Number of SELECTs not found in query cache");
+		metrics_printf(buf, "pgpool_query_cache_misses_total %lld\n", cache_stats.num_selects);
+
+		if (pool_is_shmem_cache())
+		{
+			metrics_header(buf, "pgpool_query_cache_hash_entries", "gauge", "Number of hash entries");
+			metrics_printf(buf, "pgpool_query_cache_hash_entries %d\n", shmem_stats.num_hash_entries);
+			metrics_header(buf, "pgpool_query_cache_used_hash_entries", "gauge", "Number of used hash entries");
+			metrics_printf(buf, "pgpool_query_cache_used_hash_entries %d\n", shmem_stats.used_hash_entries);
+			metrics_header(buf, "pgpool_query_cache_entries", "gauge", "Number of cache entries");
+			metrics_printf(buf, "pgpool_query_cache_entries %d\n", shmem_stats.num_cache_entries);
+			metrics_header(buf, "pgpool_query_cache_used_bytes", "gauge", "Total size of used cache entries");
+			metrics_printf(buf, "pgpool_query_cache_used_bytes %ld\n", shmem_stats.used_cache_entries_size);
+			metrics_header(buf, "pgpool_query_cache_free_bytes", "gauge", "Total size of free cache space");
+			metrics_printf(buf, "pgpool_query_cache_free_bytes %ld\n", shmem_stats.free_cache_entries_size);
+			metrics_header(buf, "pgpool_query_cache_fragment_bytes", "gauge", "Total size of fragmented cache space");
+			metrics_printf(buf, "pgpool_query_cache_fragment_bytes %ld\n", shmem_stats.fragment_cache_entries_size);
+		}
+	}
+
+	/* latency */
+	metrics_header(buf, "pgpool_query_latency_seconds", "summary", "Query latency");
+	for (i = 0; i < pool_latency_num_histograms(); i++)
+	{
+		char *name = pool_latency_histogram_name(i);
+
+		pool_latency_get_histogram(i, &histogram);
+
+		for (j = 0; j < sizeof(quantiles)/sizeof(double); j++)
+		{
+			metrics_printf(buf, "pgpool_query_latency_seconds{kind=\"%s\",quantile=\"%g\"} %.6f\n",
+						   name, quantiles[j],
+						   pool_latency_percentile(&histogram, quantiles[j] * 100.0) / 1000000.0);
+		}
+		metrics_printf(buf, "pgpool_query_latency_seconds_sum{kind=\"%s\"} %.6f\n",
+					   name, histogram.total_usec / 1000000.0);
+		metrics_printf(buf, "pgpool_query_latency_seconds_count{kind=\"%s\"} %lld\n",
+					   name, histogram.count);
+	}
+
+	/* COPY */
+	for (i = 0; i < pool_config->num_init_children; i++)
+	{
+		copy_count += process_info[i].copy_in_count;
+		copy_bytes += process_info[i].copy_in_bytes;
+		copy_usec += process_info[i].copy_in_usec;
+	}
+
+	metrics_header(buf, "pgpool_copy_in_total", "counter", "Number of COPY FROM STDIN processed");
+	metrics_printf(buf, "pgpool_copy_in_total %lld\n", copy_count);
+	metrics_header(buf, "pgpool_copy_in_bytes_total", "counter", "Bytes of COPY data forwarded to backends");
+	metrics_printf(buf, "pgpool_copy_in_bytes_total %lld\n", copy_bytes);
+	metrics_header(buf, "pgpool_copy_in_seconds_total", "counter", "Time spent for forwarding COPY data");
+	metrics_printf(buf, "pgpool_copy_in_seconds_total %.6f\n", copy_usec / 1000000.0);
+}
+
+/*
+ * Append formatted string to the buffer, growing it as needed.
+ */
+static void metrics_printf(METRICS_BUFFER *buf, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+	size_t newsize;
+	char *p;
+
+	if (buf->failed)
+		return;
+
+	for (;;)
+	{
+		if (buf->size - buf->len > 0)
+		{
+			va_start(ap, fmt);
+			n = vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, ap);
+			va_end(ap);
+
+			if (n < 0)
+			{
+				buf->failed = true;
+				return;
+			}
+
+			if (n < buf->size - buf->len)
+			{
+				buf->len += n;
+				return;
+			}
+		}
+		else
+			n = 0;
+
+		newsize = buf->size ? buf->size * 2 : 8192;
+		while (newsize < buf->len + n + 1)
+			newsize *= 2;
+
+		p = realloc(buf->data, newsize);
+		if (!p)
+		{
+			pool_error("metrics_printf: realloc failed");
+			buf->failed = true;
+			return;
+		}
+		buf->data = p;
+		buf->size = newsize;
+	}
+}
+
+static void metrics_header(METRICS_BUFFER *buf, char *name, char *type, char *help)
+{
+	metrics_printf(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*
+ * Escape backslash, double quote and newline for label value.
+ */
+static char *metrics_escape(const char *src, char *dst, size_t dstlen)
+{
+	char *p = dst;
+
+	while (*src && p < dst + dstlen - 2)
+	{
+		if (*src == '\\' || *src == '"')
+		{
+			*p++ = '\\';
+			*p++ = *src;
+		}
+		else if (*src == '\n')
+		{
+			*p++ = '\\';
+			*p++ = 'n';
+		}
+		else
+			*p++ = *src;
+		src++;
+	}
+	*p = '\0';
+	return dst;
+}
+
+static RETSIGTYPE my_signal_handler(int sig)
+{
+	POOL_SETMASK(&BlockSig);
+
+	switch (sig)
+	{
+		case SIGTERM:
+		case SIGINT:
+		case SIGQUIT:
+			exit(0);
+			break;
+
+		default:
+			exit(1);
+			break;
+	}
+
+	POOL_SETMASK(&UnBlockSig);
+}
+
+static RETSIGTYPE reload_config_handler(int sig)
+{
+	POOL_SETMASK(&BlockSig);
+	reload_config_request = 1;
+	POOL_SETMASK(&UnBlockSig);
+}
+
+static void reload_config(void)
+{
+	pool_log("metrics exporter: reload config files.");
+	pool_get_config(get_config_file_name(), RELOAD_CONFIG);
+	reload_config_request = 0;
+}
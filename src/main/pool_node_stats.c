@@ -0,0 +1,205 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_node_stats.c: Per backend node statement statistics
+ *
+ * Number of statements, transactions, errors and bytes transferred
+ * are counted for each backend node so that we can verify load
+ * balancing works as expected. Each child has its own set of counters
+ * on shared memory, which is updated without locking. Counters are
+ * summed up over children when read. Counts made by processes other
+ * than children (e.g. health check) are not recorded.
+ */
+#include "config.h"
+#include <string.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_node_stats.h"
+
+/*
+ * Header of node statistics area placed on shared memory. Slots
+ * follow in the next cache line.
+ */
+typedef struct
+{
+	int num_slots;				/* number of slots (= num_init_children) */
+	int num_nodes;				/* number of nodes per slot */
+	size_t slot_size;			/* size of a slot in bytes */
+} POOL_NODE_STATS_AREA;
+
+static POOL_NODE_STATS_AREA *node_stats_area;
+
+/* Counters of the node in the slot */
+#define NODE_STATS(slot, node_id) \
+	((POOL_NODE_STATS *)((char *)node_stats_area + POOL_CACHE_LINE_SIZE + \
+						 node_stats_area->slot_size * (slot)) + (node_id))
+
+static volatile POOL_NODE_STATS *my_node_stats(int node_id);
+
+/*
+ * Allocate node statistics on shared memory. Counters are allocated
+ * for backends known at this point.
+ */
+int pool_init_node_stats(void)
+{
+	size_t size;
+	size_t slot_size;
+
+	/* round up slot size so that each slot starts at cache line boundary */
+	slot_size = sizeof(POOL_NODE_STATS) * NUM_BACKENDS;
+	slot_size = (slot_size + POOL_CACHE_LINE_SIZE - 1) / POOL_CACHE_LINE_SIZE * POOL_CACHE_LINE_SIZE;
+
+	size = POOL_CACHE_LINE_SIZE + slot_size * pool_config->num_init_children;
+
+	node_stats_area = pool_shared_memory_create(size);
+	if (node_stats_area == NULL)
+	{
+		pool_error("pool_init_node_stats: failed to allocate shared memory. request size: %zd",
+				   size);
+		return -1;
+	}
+
+	memset(node_stats_area, 0, size);
+	node_stats_area->num_slots = pool_config->num_init_children;
+	node_stats_area->num_nodes = NUM_BACKENDS;
+	node_stats_area->slot_size = slot_size;
+
+	return 0;
+}
+
+/*
+ * Count up number of statements sent to the node.
+ */
+void pool_node_stats_count_statement(int node_id, bool is_select)
+{
+	volatile POOL_NODE_STATS *stats = my_node_stats(node_id);
+
+	if (!stats)
+		return;
+
+	if (is_select)
+		stats->select_cnt++;
+	else
+		stats->write_cnt++;
+}
+
+/*
+ * Count up number of transactions finished on the node.
+ */
+void pool_node_stats_count_transaction(int node_id)
+{
+	volatile POOL_NODE_STATS *stats = my_node_stats(node_id);
+
+	if (stats)
+		stats->xact_cnt++;
+}
+
+/*
+ * Count up number of errors for each node the current query was sent
+ * to.
+ */
+void pool_node_stats_count_errors(POOL_CONNECTION_POOL *backend)
+{
+	volatile POOL_NODE_STATS *stats;
+	int i;
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (!VALID_BACKEND(i))
+			continue;
+
+		stats = my_node_stats(i);
+		if (stats)
+			stats->error_cnt++;
+	}
+}
+
+/*
+ * Count up bytes received from backend.
+ */
+void pool_node_stats_count_bytes_in(POOL_CONNECTION *cp, int len)
+{
+	volatile POOL_NODE_STATS *stats;
+
+	if (!cp->isbackend || len <= 0)
+		return;
+
+	stats = my_node_stats(cp->db_node_id);
+	if (stats)
+		stats->bytes_in += len;
+}
+
+/*
+ * Count up bytes sent to backend.
+ */
+void pool_node_stats_count_bytes_out(POOL_CONNECTION *cp, int len)
+{
+	volatile POOL_NODE_STATS *stats;
+
+	if (!cp->isbackend || len <= 0)
+		return;
+
+	stats = my_node_stats(cp->db_node_id);
+	if (stats)
+		stats->bytes_out += len;
+}
+
+/*
+ * Sum up statistics of the node over all children. Since counters
+ * are updated without locking, the result may miss counts being
+ * updated at the same time.
+ */
+void pool_get_node_stats(int node_id, POOL_NODE_STATS *stats)
+{
+	volatile POOL_NODE_STATS *s;
+	int i;
+
+	memset(stats, 0, sizeof(POOL_NODE_STATS));
+
+	if (!node_stats_area || node_id < 0 || node_id >= node_stats_area->num_nodes)
+		return;
+
+	for (i=0;i<node_stats_area->num_slots;i++)
+	{
+		s = NODE_STATS(i, node_id);
+
+		stats->select_cnt += s->select_cnt;
+		stats->write_cnt += s->write_cnt;
+		stats->xact_cnt += s->xact_cnt;
+		stats->bytes_in += s->bytes_in;
+		stats->bytes_out += s->bytes_out;
+		stats->error_cnt += s->error_cnt;
+	}
+}
+
+/*
+ * Return counters of the node in this process's slot. Returns NULL
+ * if called in a process other than children or the node was added
+ * after pgpool started.
+ */
+static volatile POOL_NODE_STATS *my_node_stats(int node_id)
+{
+	if (!node_stats_area || my_proc_id < 0 || my_proc_id >= node_stats_area->num_slots ||
+		node_id < 0 || node_id >= node_stats_area->num_nodes)
+		return NULL;
+
+	return NODE_STATS(my_proc_id, node_id);
+}
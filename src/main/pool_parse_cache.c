@@ -0,0 +1,360 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_parse_cache.c: Per process cache of parse trees
+ *
+ * Parse trees of query strings are kept in a LRU cache so that we do
+ * not need to call raw_parser() for frequently used queries. Along
+ * with the parse tree, results of syntactical analysis which do not
+ * depend on session state (POOL_SYNTAX_INFO) are kept.  Cached parse
+ * trees are never handed out directly. Callers always get a copy
+ * allocated in the current memory context since the parse tree may
+ * be modified while processing the query.
+ *
+ * The result of rewrite_timestamp() can be kept in the entry as well,
+ * with the timestamp literal replaced by a placeholder.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_parse_cache.h"
+#include "parser/parser.h"
+#include "parser/nodes.h"
+#include "utils/pool_memqcache.h"
+
+static POOL_PARSE_CACHE_ENTRY **parse_cache_buckets;	/* hash buckets */
+static int parse_cache_nbuckets;		/* number of buckets. power of 2 */
+static int parse_cache_size;			/* max number of entries */
+static int parse_cache_entries;			/* current number of entries */
+static POOL_PARSE_CACHE_ENTRY *lru_head;	/* most recently used entry */
+static POOL_PARSE_CACHE_ENTRY *lru_tail;	/* least recently used entry */
+static long long int parse_cache_hits;
+static long long int parse_cache_misses;
+
+static bool parse_cache_init(void);
+static POOL_PARSE_CACHE_ENTRY *parse_cache_search(const char *query, uint32 hash);
+static void parse_cache_remove(POOL_PARSE_CACHE_ENTRY *entry);
+static void lru_unlink(POOL_PARSE_CACHE_ENTRY *entry);
+static void lru_push_head(POOL_PARSE_CACHE_ENTRY *entry);
+
+/*
+ * Search parse cache for the query. If found, return copy of the
+ * parse tree list allocated in current memory context and set derived
+ * syntax info to "info". Otherwise return NIL.
+ */
+List *pool_parse_cache_lookup(const char *query, POOL_SYNTAX_INFO *info)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+
+	if (pool_config->parse_cache_size <= 0 || !parse_cache_buckets)
+		return NIL;
+
+	entry = parse_cache_search(query, hash_any((unsigned char *)query, strlen(query)));
+	if (!entry)
+	{
+		parse_cache_misses++;
+		return NIL;
+	}
+
+	parse_cache_hits++;
+
+	lru_unlink(entry);
+	lru_push_head(entry);
+
+	*info = entry->syntax_info;
+
+	pool_debug("pool_parse_cache_lookup: cache hit. hits: %lld misses: %lld", parse_cache_hits, parse_cache_misses);
+
+	return copyObject(entry->parse_tree_list);
+}
+
+/*
+ * Register copy of parse tree list of the query to parse cache. If
+ * the cache is full, least recently used entry is removed.
+ */
+void pool_parse_cache_add(const char *query, List *parse_tree_list)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+	POOL_MEMORY_POOL *old_context;
+	uint32 hash;
+	size_t len;
+
+	if (pool_config->parse_cache_size <= 0 || parse_tree_list == NIL)
+		return;
+
+	len = strlen(query);
+	if (len > POOL_PARSE_CACHE_MAX_QUERY_LENGTH)
+		return;
+
+	if (!parse_cache_buckets && !parse_cache_init())
+		return;
+
+	hash = hash_any((unsigned char *)query, len);
+	if (parse_cache_search(query, hash))
+		return;
+
+	if (parse_cache_entries >= parse_cache_size)
+		parse_cache_remove(lru_tail);
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+	{
+		pool_error("pool_parse_cache_add: calloc failed");
+		return;
+	}
+
+	entry->query = strdup(query);
+	if (!entry->query)
+	{
+		pool_error("pool_parse_cache_add: strdup failed");
+		free(entry);
+		return;
+	}
+
+	entry->memory_context = pool_memory_create(PREPARE_BLOCK_SIZE);
+	if (!entry->memory_context)
+	{
+		pool_error("pool_parse_cache_add: pool_memory_create failed");
+		free(entry->query);
+		free(entry);
+		return;
+	}
+
+	entry->hash = hash;
+	entry->standard_conforming_strings = standard_conforming_strings;
+
+	old_context = pool_memory_context_switch_to(entry->memory_context);
+	entry->parse_tree_list = copyObject(parse_tree_list);
+	pool_memory_context_switch_to(old_context);
+
+	entry->hash_next = parse_cache_buckets[hash & (parse_cache_nbuckets - 1)];
+	parse_cache_buckets[hash & (parse_cache_nbuckets - 1)] = entry;
+	lru_push_head(entry);
+	parse_cache_entries++;
+}
+
+/*
+ * Save syntax info of the query derived while processing the query
+ * so that later lookups do not need to analyze the parse tree again.
+ */
+void pool_parse_cache_update(const char *query, POOL_SYNTAX_INFO *info)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+
+	if (pool_config->parse_cache_size <= 0 || !parse_cache_buckets)
+		return;
+
+	entry = parse_cache_search(query, hash_any((unsigned char *)query, strlen(query)));
+	if (entry)
+		entry->syntax_info = *info;
+}
+
+/*
+ * Return rewritten query saved by
+ * pool_parse_cache_set_rewritten_query() and set the data it depends
+ * on to "dependency". The result points to the cache entry and must be
+ * copied before calling other parse cache functions. Returns NULL if
+ * not saved.
+ */
+char *pool_parse_cache_get_rewritten_query(const char *query, void **dependency)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+
+	if (pool_config->parse_cache_size <= 0 || !parse_cache_buckets)
+		return NULL;
+
+	entry = parse_cache_search(query, hash_any((unsigned char *)query, strlen(query)));
+	if (!entry || !entry->rewritten_query)
+		return NULL;
+
+	*dependency = entry->rewrite_dependency;
+	return entry->rewritten_query;
+}
+
+/*
+ * Save rewritten query of the query. "dependency" is data (if any)
+ * the rewrite result was derived from. The rewritten query is
+ * forgotten when pool_parse_cache_forget_rewritten_queries() is
+ * called for the data.
+ */
+void pool_parse_cache_set_rewritten_query(const char *query, const char *rewritten_query, void *dependency)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+	char *p;
+
+	if (pool_config->parse_cache_size <= 0 || !parse_cache_buckets)
+		return;
+
+	entry = parse_cache_search(query, hash_any((unsigned char *)query, strlen(query)));
+	if (!entry)
+		return;
+
+	p = strdup(rewritten_query);
+	if (!p)
+	{
+		pool_error("pool_parse_cache_set_rewritten_query: strdup failed");
+		return;
+	}
+
+	free(entry->rewritten_query);
+	entry->rewritten_query = p;
+	entry->rewrite_dependency = dependency;
+}
+
+/*
+ * Forget rewritten queries which depend on the data. This must be
+ * called before the data is freed.
+ */
+void pool_parse_cache_forget_rewritten_queries(void *dependency)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+
+	if (!parse_cache_buckets || dependency == NULL)
+		return;
+
+	for (entry = lru_head; entry; entry = entry->lru_next)
+	{
+		if (entry->rewritten_query && entry->rewrite_dependency == dependency)
+		{
+			free(entry->rewritten_query);
+			entry->rewritten_query = NULL;
+			entry->rewrite_dependency = NULL;
+		}
+	}
+}
+
+/*
+ * Discard all parse cache entries. This must be called when
+ * configuration affecting syntax info is changed.
+ */
+void pool_parse_cache_reset(void)
+{
+	if (!parse_cache_buckets)
+		return;
+
+	while (lru_head)
+		parse_cache_remove(lru_head);
+
+	free(parse_cache_buckets);
+	parse_cache_buckets = NULL;
+	parse_cache_nbuckets = 0;
+	parse_cache_size = 0;
+}
+
+/*
+ * Allocate hash buckets according to parse_cache_size.
+ */
+static bool parse_cache_init(void)
+{
+	int nbuckets = 1;
+
+	parse_cache_size = pool_config->parse_cache_size;
+
+	while (nbuckets < parse_cache_size)
+		nbuckets <<= 1;
+
+	parse_cache_buckets = calloc(nbuckets, sizeof(POOL_PARSE_CACHE_ENTRY *));
+	if (!parse_cache_buckets)
+	{
+		pool_error("parse_cache_init: calloc failed");
+		return false;
+	}
+
+	parse_cache_nbuckets = nbuckets;
+	parse_cache_entries = 0;
+	lru_head = lru_tail = NULL;
+
+	return true;
+}
+
+/*
+ * Search hash table for the query. Entries made under different
+ * standard_conforming_strings setting are ignored since the parse
+ * result may differ.
+ */
+static POOL_PARSE_CACHE_ENTRY *parse_cache_search(const char *query, uint32 hash)
+{
+	POOL_PARSE_CACHE_ENTRY *entry;
+
+	for (entry = parse_cache_buckets[hash & (parse_cache_nbuckets - 1)];
+		 entry; entry = entry->hash_next)
+	{
+		if (entry->hash == hash &&
+			entry->standard_conforming_strings == standard_conforming_strings &&
+			!strcmp(entry->query, query))
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Remove entry from the cache and free it.
+ */
+static void parse_cache_remove(POOL_PARSE_CACHE_ENTRY *entry)
+{
+	POOL_PARSE_CACHE_ENTRY **p;
+
+	for (p = &parse_cache_buckets[entry->hash & (parse_cache_nbuckets - 1)];
+		 *p; p = &(*p)->hash_next)
+	{
+		if (*p == entry)
+		{
+			*p = entry->hash_next;
+			break;
+		}
+	}
+
+	lru_unlink(entry);
+	parse_cache_entries--;
+
+	pool_memory_delete(entry->memory_context, 0);
+	free(entry->rewritten_query);
+	free(entry->query);
+	free(entry);
+}
+
+static void lru_unlink(POOL_PARSE_CACHE_ENTRY *entry)
+{
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		lru_head = entry->lru_next;
+
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		lru_tail = entry->lru_prev;
+
+	entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_head(POOL_PARSE_CACHE_ENTRY *entry)
+{
+	entry->lru_prev = NULL;
+	entry->lru_next = lru_head;
+	if (lru_head)
+		lru_head->lru_prev = entry;
+	lru_head = entry;
+	if (!lru_tail)
+		lru_tail = entry;
+}
@@ -44,6 +44,7 @@
 
 #include "pool.h"
 #include "pool_config.h"
+#include "pool_activity.h"
 #include "pool_timestamp.h"
 #include "pool_proto_modules.h"
 #include "pool_relcache.h"
@@ -75,10 +76,14 @@ static int detect_error(POOL_CONNECTION *master, char *error_code, int major, ch
 static int detect_postmaster_down_error(POOL_CONNECTION *master, int major);
 static bool is_internal_transaction_needed(Node *node);
 static bool pool_has_insert_lock(void);
+static bool pool_has_advisory_xact_lock(void);
+static char *get_sequence_lock_query(POOL_CONNECTION_POOL *backend, char *table);
+static void *sequence_lock_register_func(POOL_SELECT_RESULT *res);
 static POOL_STATUS add_lock_target(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, char* table);
 static bool has_lock_target(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, char* table, bool for_update);
 static POOL_STATUS insert_oid_into_insert_lock(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, char* table);
 static POOL_STATUS read_packets_and_process(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, int reset_request, int *state, short *num_fields, bool *cont);
+static bool is_all_backends_idle(POOL_CONNECTION_POOL *backend);
 
 /* timeout sec for pool_check_fd */
 static int timeoutsec;
@@ -887,6 +892,29 @@ POOL_STATUS send_extended_protocol_message(POOL_CONNECTION_POOL *backend,
 	return POOL_CONTINUE;
 }
 
+/*
+ * Forward extended query protocol message without Flush message.  The
+ * message stays in the write buffer until Sync or Flush is sent or the
+ * buffer is full.
+ */
+POOL_STATUS send_pipelined_protocol_message(POOL_CONNECTION_POOL *backend,
+											int node_id, char *kind,
+											int len, char *string)
+{
+	POOL_CONNECTION *cp = CONNECTION(backend, node_id);
+	int sendlen;
+
+	pool_write(cp, kind, 1);
+	sendlen = htonl(len + 4);
+	pool_write(cp, &sendlen, sizeof(sendlen));
+	if (pool_write(cp, string, len) < 0)
+	{
+		return POOL_ERROR;
+	}
+
+	return POOL_CONTINUE;
+}
+
 /*
  * wait until read data is ready
  */
@@ -907,6 +935,38 @@ void pool_set_timeout(int timeoutval)
 		timeoutsec = 0;
 }
 
+/*
+ * Fill read buffers of valid backends except "exclude_node" with at
+ * least len bytes, reading them concurrently. Nothing is done if there
+ * is only one such backend.
+ * returns 0 on success otherwise -1.
+ */
+int pool_fill_backend_read_buffers(POOL_CONNECTION_POOL *backend, int exclude_node, int len)
+{
+	POOL_CONNECTION *cps[MAX_NUM_BACKENDS];
+	int ncps = 0;
+	int i;
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (VALID_BACKEND(i) && i != exclude_node)
+			cps[ncps++] = CONNECTION(backend, i);
+	}
+
+	if (ncps < 2)
+		return 0;
+
+	return pool_fill_read_buffers(cps, ncps, len);
+}
+
+/*
+ * get timeout in seconds for pool_check_fd. 0 means no timeout.
+ */
+int pool_get_timeout(void)
+{
+	return timeoutsec;
+}
+
 /*
  * Wait until read data is ready.
  * return values: 0: normal 1: data is not ready -1: error
@@ -2895,6 +2955,7 @@ POOL_STATUS do_query(POOL_CONNECTION *backend, char *query, POOL_SELECT_RESULT *
  * 1: table lock is required
  * 2: row lock against sequence table is required
  * 3: row lock against insert_lock table is required
+ * 4: advisory lock against sequences is required
  */
 int need_insert_lock(POOL_CONNECTION_POOL *backend, char *query, Node *node)
 {
@@ -2946,6 +3007,16 @@ int need_insert_lock(POOL_CONNECTION_POOL *backend, char *query, Node *node)
 		return 0;
 	}
 
+#if !defined(USE_TABLE_LOCK) && !defined(USE_SEQUENCE_LOCK)
+	/*
+	 * If transaction level advisory locks are available, lock
+	 * sequences used by the table instead of the table itself. No
+	 * lock is needed if the table does not use sequences.
+	 */
+	if (pool_has_advisory_xact_lock())
+		return get_sequence_lock_query(backend, str) ? 4 : 0;
+#endif
+
 	/*
 	 * If relcache does not exist, create it.
 	 */
@@ -2991,6 +3062,7 @@ int need_insert_lock(POOL_CONNECTION_POOL *backend, char *query, Node *node)
  * 1: Issue LOCK TABLE IN SHARE ROW EXCLUSIVE MODE
  * 2: Issue row lock against sequence table
  * 3: Issue row lock against pgpool_catalog.insert_lock table
+ * 4: Issue advisory lock against sequences used by the table
  * "lock_kind == 2" is deprecated because PostgreSQL disallows 
  * SELECT FOR UPDATE/SHARE on sequence tables since 2011/06/03.
  * See following threads for more details: 
@@ -3002,6 +3074,7 @@ POOL_STATUS insert_lock(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend
 	char *table, *p;
 	int len = 0;
 	char qbuf[1024];
+	char *lock_query = qbuf;
 	POOL_STATUS status;
 	int i, deadlock_detected = 0;
 
@@ -3119,6 +3192,16 @@ POOL_STATUS insert_lock(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend
 		pool_debug("seq rel name: %s", seq_rel_name);
 		snprintf(qbuf, sizeof(qbuf), "SELECT 1 FROM %s FOR UPDATE", seq_rel_name);
 	}
+	/* advisory lock for sequences? */
+	else if (lock_kind == 4)
+	{
+		lock_query = get_sequence_lock_query(backend, table);
+		if (lock_query == NULL)
+		{
+			/* the table does not use sequences */
+			return POOL_CONTINUE;
+		}
+	}
 	/* row lock for insert_lock table? */
 	else
 	{
@@ -3137,17 +3220,17 @@ POOL_STATUS insert_lock(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend
 		}
 	}
 
-	per_node_statement_log(backend, MASTER_NODE_ID, qbuf);
+	per_node_statement_log(backend, MASTER_NODE_ID, lock_query);
 
 	if (lock_kind == 1)
 	{
 		status = do_command(frontend, MASTER(backend), qbuf, MAJOR(backend), MASTER_CONNECTION(backend)->pid,
 							MASTER_CONNECTION(backend)->key, 0);
 	}
-	else if (lock_kind == 2)
+	else if (lock_kind == 2 || lock_kind == 4)
 	{
 		POOL_SELECT_RESULT *result;
-		status = do_query(MASTER(backend), qbuf, &result, MAJOR(backend));
+		status = do_query(MASTER(backend), lock_query, &result, MAJOR(backend));
 		if (result)
 			free_select_result(result);
 	}
@@ -3268,6 +3351,116 @@ static bool pool_has_insert_lock(void)
 	return result;
 }
 
+/*
+ * Judge if transaction level advisory locks (PostgreSQL 9.1 or later)
+ * are available or not.
+ */
+static bool pool_has_advisory_xact_lock(void)
+{
+/*
+ * Query to know if pg_advisory_xact_lock() exists.
+ */
+#define HASADVISORY_XACT_LOCKQUERY "SELECT count(*) FROM pg_catalog.pg_proc p JOIN pg_catalog.pg_namespace n ON (p.pronamespace = n.oid) WHERE nspname = 'pg_catalog' AND proname = '%s'"
+	bool result;
+	static POOL_RELCACHE *relcache;
+	POOL_CONNECTION_POOL *backend;
+
+	backend = pool_get_session_context()->backend;
+
+	if (!relcache)
+	{
+		relcache = pool_create_relcache(pool_config->relcache_size, HASADVISORY_XACT_LOCKQUERY,
+										int_register_func, int_unregister_func,
+										false);
+		if (relcache == NULL)
+		{
+			pool_error("pool_has_advisory_xact_lock: pool_create_relcache error");
+			return false;
+		}
+	}
+
+	result = pool_search_relcache(relcache, backend, "pg_advisory_xact_lock")==0?0:1;
+	return result;
+}
+
+/*
+ * Return query to acquire advisory locks against sequences used by
+ * the table's column defaults, or NULL if the table does not use
+ * sequences. Sequences are looked up through pg_depend so that we do
+ * not need to parse pg_attrdef.adsrc. The result is kept in relcache.
+ */
+static char *get_sequence_lock_query(POOL_CONNECTION_POOL *backend, char *table)
+{
+/*
+ * Query to get oids of sequences the table's column defaults depend on.
+ */
+#define SEQUENCEOIDQUERY "SELECT DISTINCT d.refobjid FROM pg_catalog.pg_class c, pg_catalog.pg_attrdef a, pg_catalog.pg_depend d, pg_catalog.pg_class s WHERE a.adrelid = c.oid AND d.classid = 'pg_catalog.pg_attrdef'::pg_catalog.regclass AND d.objid = a.oid AND d.refclassid = 'pg_catalog.pg_class'::pg_catalog.regclass AND d.refobjid = s.oid AND s.relkind = 'S' AND c.relname = '%s' ORDER BY 1"
+
+#define SEQUENCEOIDQUERY2 "SELECT DISTINCT d.refobjid FROM pg_catalog.pg_attrdef a, pg_catalog.pg_depend d, pg_catalog.pg_class s WHERE a.adrelid = pgpool_regclass('%s') AND d.classid = 'pg_catalog.pg_attrdef'::pg_catalog.regclass AND d.objid = a.oid AND d.refclassid = 'pg_catalog.pg_class'::pg_catalog.regclass AND d.refobjid = s.oid AND s.relkind = 'S' ORDER BY 1"
+
+	static POOL_RELCACHE *relcache;
+
+	if (!relcache)
+	{
+		char *query;
+
+		if (pool_has_pgpool_regclass())
+		{
+			query = SEQUENCEOIDQUERY2;
+		}
+		else
+		{
+			query = SEQUENCEOIDQUERY;
+		}
+
+		relcache = pool_create_relcache(pool_config->relcache_size, query,
+										sequence_lock_register_func, string_unregister_func,
+										false);
+		if (relcache == NULL)
+		{
+			pool_error("get_sequence_lock_query: pool_create_relcache error");
+			return NULL;
+		}
+	}
+
+	return pool_search_relcache(relcache, backend, table);
+}
+
+/*
+ * Build advisory lock query from oids of sequences. Since sequences
+ * are sorted by oid, every session acquires the locks in the same
+ * order.
+ */
+static void *sequence_lock_register_func(POOL_SELECT_RESULT *res)
+{
+#define SEQUENCE_LOCK_FORMAT "%spg_catalog.pg_advisory_xact_lock(%d, %d)"
+	char *query;
+	int len;
+	int i;
+
+	if (res->numrows == 0)
+		return NULL;
+
+	len = strlen("SELECT ") +
+		res->numrows * (sizeof(SEQUENCE_LOCK_FORMAT) + 2 * 11 + 2) + 1;
+	query = malloc(len);
+	if (query == NULL)
+	{
+		pool_error("sequence_lock_register_func: malloc failed");
+		return NULL;
+	}
+
+	strcpy(query, "SELECT ");
+	for (i = 0; i < res->numrows; i++)
+	{
+		snprintf(query + strlen(query), len - strlen(query), SEQUENCE_LOCK_FORMAT,
+				 i == 0 ? "" : ", ", INSERT_LOCK_ADVISORY_CLASSID,
+				 (int)strtoul(res->data[i], NULL, 10));
+	}
+
+	return query;
+}
+
 /*
  * Insert a lock target row into insert_lock table.
  * This function is called after the transaction has been started.
@@ -3674,6 +3867,16 @@ POOL_STATUS read_kind_from_backend(POOL_CONNECTION *frontend, POOL_CONNECTION_PO
 		pool_unread(CONNECTION(backend, MASTER_NODE_ID), &kind, sizeof(kind));
 	}
 
+	/*
+	 * Read responses from all the nodes as they arrive before
+	 * examining them in node order.
+	 */
+	if (pool_fill_backend_read_buffers(backend, -1, MAJOR(backend) == PROTO_MAJOR_V3 ? 5 : 1))
+	{
+		pool_error("read_kind_from_backend: failed to read from backends");
+		return POOL_ERROR;
+	}
+
 	for (i=0;i<NUM_BACKENDS;i++)
 	{
 		/* initialize degenerate record */
@@ -4001,7 +4204,8 @@ void query_ps_status(char *query, POOL_CONNECTION_POOL *backend)
 	char psbuf[1024];
 	int i;
 
-	if (*query == '\0')
+	if (*query == '\0' || !pool_config->update_process_title ||
+		!pool_activity_ps_display_due())
 		return;
 
 	sp = MASTER_CONNECTION(backend)->sp;
@@ -4705,6 +4909,14 @@ SELECT_RETRY:
 
 	num_fds = 0;
 
+	/*
+	 * If some DB nodes have been detached by failover, close the
+	 * connections to them before waiting for new data so that this
+	 * session can continue with the remaining nodes.
+	 */
+	if (!reset_request && is_all_backends_idle(backend))
+		pool_detach_down_nodes();
+
 	if (!reset_request)
 	{
 		FD_SET(frontend->fd, &readmask);
@@ -4806,6 +5018,16 @@ SELECT_RETRY:
 		goto SELECT_RETRY;
 	}
 
+	/*
+	 * Failover of a node other than the master or the primary does not
+	 * wake up children, so the node may have been detached while we
+	 * were waiting in select(). Check again before processing the input
+	 * so that the next query is not sent to the detached node.
+	 */
+	if (!reset_request && is_all_backends_idle(backend) &&
+		pool_detach_down_nodes())
+		goto SELECT_RETRY;
+
 	for (i = 0; i < NUM_BACKENDS; i++)
 	{
 		if (VALID_BACKEND(i))
@@ -4852,6 +5074,14 @@ SELECT_RETRY:
 					if (!VALID_BACKEND(i))
 						break;
 					notice_backend_error(i);
+					if (!reset_request && is_all_backends_idle(backend) &&
+						!POOL_DISALLOW_TO_FAILOVER(BACKEND_INFO(i).flag) &&
+						pool_detach_node_locally(i))
+					{
+						/* Other nodes are still usable. Keep this session. */
+						was_error = 0;
+						goto SELECT_RETRY;
+					}
 					sleep(5);
 					break;
 				}
@@ -4862,6 +5092,22 @@ SELECT_RETRY:
 					 * detaching the backend. In this case reading from backend socket will
 					 * return EOF and it's better to close this session. So returns POOL_END.
 					 */ 
+					if (!reset_request && is_all_backends_idle(backend) &&
+						!POOL_DISALLOW_TO_FAILOVER(BACKEND_INFO(i).flag))
+					{
+						/*
+						 * The connection to a DB node other than the
+						 * master was closed while the session is idle.
+						 * Request failover and keep using the other
+						 * nodes.
+						 */
+						notice_backend_error(i);
+						if (pool_detach_node_locally(i))
+						{
+							pool_log("detect_postmaster_down_error returns error on backend %d. Detached the node from this session.", i);
+							goto SELECT_RETRY;
+						}
+					}
 					pool_log("detect_postmaster_down_error returns error on backend %d. Going to close this session.", i);
 					return POOL_END;
 				}
@@ -4898,6 +5144,26 @@ SELECT_RETRY:
 	return POOL_CONTINUE;
 }
 
+/*
+ * Return true if no query is in progress and all backends are idle,
+ * i.e. not in a transaction block.  DB nodes can be detached from the
+ * session only at this point.
+ */
+static bool is_all_backends_idle(POOL_CONNECTION_POOL *backend)
+{
+	int i;
+
+	if (pool_is_query_in_progress() || pool_is_ignore_till_sync())
+		return false;
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (VALID_BACKEND(i) && TSTATE(backend, i) != 'I')
+			return false;
+	}
+	return true;
+}
+
 /*
  * Debugging aid for VALID_BACKEND macro.
  */
@@ -24,6 +24,10 @@
 #include "pool_proto_modules.h"
 #include "pool_stream.h"
 #include "pool_config.h"
+#include "pool_latency.h"
+#include "pool_node_stats.h"
+#include "pool_activity.h"
+#include "pool_query_stats.h"
 #include "utils/pool_memqcache.h"
 #include "version.h"
 
@@ -99,6 +103,57 @@ void send_row_description(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backe
 	pool_flush(frontend);
 }
 
+/*
+ * Send a row consisting of text values
+ */
+void send_data_row(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
+				   short num_fields, char **values)
+{
+	static unsigned char nullmap[2] = {0xff, 0xff};
+	int nbytes = (num_fields + 7)/8;
+	short s;
+	int len;
+	int size;
+	int hsize;
+	int i;
+
+	if (MAJOR(backend) == PROTO_MAJOR_V2)
+	{
+		/* ascii row */
+		pool_write(frontend, "D", 1);
+		pool_write(frontend, nullmap, nbytes);
+
+		for (i=0;i<num_fields;i++)
+		{
+			size = strlen(values[i]);
+			hsize = htonl(size+4);
+			pool_write(frontend, &hsize, sizeof(hsize));
+			pool_write(frontend, values[i], size);
+		}
+	}
+	else
+	{
+		/* data row */
+		len = 6; /* int32 + int16; */
+		for (i=0;i<num_fields;i++)
+			len += 4 + strlen(values[i]); /* int32 + data */
+
+		pool_write(frontend, "D", 1);
+		len = htonl(len);
+		pool_write(frontend, &len, sizeof(len));
+		s = htons(num_fields);
+		pool_write(frontend, &s, sizeof(s));
+
+		for (i=0;i<num_fields;i++)
+		{
+			size = strlen(values[i]);
+			hsize = htonl(size);
+			pool_write(frontend, &hsize, sizeof(hsize));
+			pool_write(frontend, values[i], size);
+		}
+	}
+}
+
 void send_complete_and_ready(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend, const int num_rows)
 {
 	int len;
@@ -182,6 +237,11 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "PCP socket directory", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "metrics_port", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->metrics_port);
+	strncpy(status[i].desc, "metrics exporter port # to bind", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	/* # - Authentication - */
 	strncpy(status[i].name, "enable_pool_hba", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->enable_pool_hba);
@@ -266,6 +326,21 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "logging destination", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "log_buffer_size", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->log_buffer_size);
+	strncpy(status[i].desc, "per process log buffer size. 0 disables logger", POOLCONFIG_MAXDESCLEN);
+	i++;
+
+	strncpy(status[i].name, "log_file", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%s", pool_config->log_file);
+	strncpy(status[i].desc, "log file written by logger process", POOLCONFIG_MAXDESCLEN);
+	i++;
+
+	strncpy(status[i].name, "log_rotation_size", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->log_rotation_size);
+	strncpy(status[i].desc, "rotate log file after this kB is written", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	/* - What to log - */
 	strncpy(status[i].name, "print_timestamp", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->print_timestamp);
@@ -282,6 +357,11 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "if true, resolve hostname for ps and log print", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "update_process_title", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->update_process_title);
+	strncpy(status[i].desc, "if true, show activity of each child in ps", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	strncpy(status[i].name, "log_statement", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->log_statement);
 	strncpy(status[i].desc, "if non 0, logs all SQL statements", POOLCONFIG_MAXDESCLEN);
@@ -292,6 +372,16 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "if non 0, logs all SQL statements on each node", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "log_statement_sample_rate", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->log_statement_sample_rate);
+	strncpy(status[i].desc, "log only 1 in this many statements", POOLCONFIG_MAXDESCLEN);
+	i++;
+
+	strncpy(status[i].name, "log_min_duration_statement", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->log_min_duration_statement);
+	strncpy(status[i].desc, "log statements taking this many msec or more", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	strncpy(status[i].name, "log_standby_delay", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%s", pool_config->log_standby_delay);
 	strncpy(status[i].desc, "how to log standby delay", POOLCONFIG_MAXDESCLEN);
@@ -363,11 +453,21 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "insert lock", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "timestamp_sync_interval", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->timestamp_sync_interval);
+	strncpy(status[i].desc, "interval to sync master clock for timestamp rewriting", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	strncpy(status[i].name, "lobj_lock_table", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%s", pool_config->lobj_lock_table);
 	strncpy(status[i].desc, "table name used for large object replication control", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "lobj_oid_block_size", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->lobj_oid_block_size);
+	strncpy(status[i].desc, "number of large object OIDs reserved at once", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	/* - Degenerate handling - */
 	strncpy(status[i].name, "replication_stop_on_mismatch", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->replication_stop_on_mismatch);
@@ -386,6 +486,11 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "non 0 if operating in load balancing mode", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "multi_statement_load_balance", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->multi_statement_load_balance);
+	strncpy(status[i].desc, "load balance multi statement SELECT queries", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	strncpy(status[i].name, "ignore_leading_white_space", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->ignore_leading_white_space);
 	strncpy(status[i].desc, "ignore leading white spaces", POOLCONFIG_MAXDESCLEN);
@@ -587,6 +692,26 @@ POOL_REPORT_CONFIG* get_config(int *nrows)
 	strncpy(status[i].desc, "relation cache expiration time in seconds", POOLCONFIG_MAXDESCLEN);
 	i++;
 
+	strncpy(status[i].name, "parse_cache_size", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->parse_cache_size);
+	strncpy(status[i].desc, "number of parse cache entries per child", POOLCONFIG_MAXDESCLEN);
+	i++;
+
+	strncpy(status[i].name, "query_stats_size", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->query_stats_size);
+	strncpy(status[i].desc, "number of queries kept in query statistics", POOLCONFIG_MAXDESCLEN);
+	i++;
+
+	strncpy(status[i].name, "shared_relcache_size", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->shared_relcache_size);
+	strncpy(status[i].desc, "number of relation cache entries shared by children", POOLCONFIG_MAXDESCLEN);
+	i++;
+
+	strncpy(status[i].name, "extended_query_pipelining", POOLCONFIG_MAXNAMELEN);
+	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->extended_query_pipelining);
+	strncpy(status[i].desc, "if non 0, forward extended query messages without waiting", POOLCONFIG_MAXDESCLEN);
+	i++;
+
 	strncpy(status[i].name, "parallel_mode", POOLCONFIG_MAXNAMELEN);
 	snprintf(status[i].value, POOLCONFIG_MAXVALLEN, "%d", pool_config->parallel_mode);
 	strncpy(status[i].desc, "if non 0, run in parallel query mode", POOLCONFIG_MAXDESCLEN);
@@ -1007,6 +1132,7 @@ POOL_REPORT_NODES* get_nodes(int *nrows)
 	int i;
 	POOL_REPORT_NODES* nodes = malloc(NUM_BACKENDS * sizeof(POOL_REPORT_NODES));
 	BackendInfo *bi = NULL;
+	POOL_NODE_STATS stats;
 
     for (i = 0; i < NUM_BACKENDS; i++)
 	{
@@ -1030,6 +1156,14 @@ POOL_REPORT_NODES* get_nodes(int *nrows)
 			else
 				snprintf(nodes[i].role, POOLCONFIG_MAXWEIGHTLEN, "%s", "slave");
 		}
+
+		pool_get_node_stats(i, &stats);
+		snprintf(nodes[i].select_cnt, POOLCONFIG_MAXCOUNTLEN+1, "%lld", stats.select_cnt);
+		snprintf(nodes[i].write_cnt, POOLCONFIG_MAXCOUNTLEN+1, "%lld", stats.write_cnt);
+		snprintf(nodes[i].xact_cnt, POOLCONFIG_MAXCOUNTLEN+1, "%lld", stats.xact_cnt);
+		snprintf(nodes[i].bytes_in, POOLCONFIG_MAXCOUNTLEN+1, "%lld", stats.bytes_in);
+		snprintf(nodes[i].bytes_out, POOLCONFIG_MAXCOUNTLEN+1, "%lld", stats.bytes_out);
+		snprintf(nodes[i].error_cnt, POOLCONFIG_MAXCOUNTLEN+1, "%lld", stats.error_cnt);
 	}
 
 	*nrows = i;
@@ -1039,102 +1173,32 @@ POOL_REPORT_NODES* get_nodes(int *nrows)
 
 void nodes_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
 {
-	static char *field_names[] = {"node_id","hostname", "port", "status", "lb_weight", "role"};
+	static char *field_names[] = {"node_id","hostname", "port", "status", "lb_weight", "role",
+								  "select_cnt", "write_cnt", "xact_cnt", "bytes_in", "bytes_out", "error_cnt"};
 	short num_fields = sizeof(field_names)/sizeof(char *);
+	char *values[12];
 	int i;
-	short s;
-	int len;
 	int nrows;
-	int size;
-	int hsize;
-	static unsigned char nullmap[2] = {0xff, 0xff};
-	int nbytes = (num_fields + 7)/8;
 
 	POOL_REPORT_NODES* nodes = get_nodes(&nrows);
 
 	send_row_description(frontend, backend, num_fields, field_names);
 
-	if (MAJOR(backend) == PROTO_MAJOR_V2)
+	for (i=0;i<nrows;i++)
 	{
-		/* ascii row */
-		for (i=0;i<nrows;i++)
-		{
-			pool_write(frontend, "D", 1);
-			pool_write_and_flush(frontend, nullmap, nbytes);
-
-			size = strlen(nodes[i].node_id);
-			hsize = htonl(size+4);
-			pool_write(frontend, &hsize, sizeof(hsize));
-			pool_write(frontend, nodes[i].node_id, size);
-
-			size = strlen(nodes[i].hostname);
-			hsize = htonl(size+4);
-			pool_write(frontend, &hsize, sizeof(hsize));
-			pool_write(frontend, nodes[i].hostname, size);
-
-			size = strlen(nodes[i].port);
-			hsize = htonl(size+4);
-			pool_write(frontend, &hsize, sizeof(hsize));
-			pool_write(frontend, nodes[i].port, size);
-
-			size = strlen(nodes[i].status);
-			hsize = htonl(size+4);
-			pool_write(frontend, &hsize, sizeof(hsize));
-			pool_write(frontend, nodes[i].status, size);
-
-			size = strlen(nodes[i].lb_weight);
-			hsize = htonl(size+4);
-			pool_write(frontend, &hsize, sizeof(hsize));
-			pool_write(frontend, nodes[i].lb_weight, size);
-
-			size = strlen(nodes[i].role);
-			hsize = htonl(size+4);
-			pool_write(frontend, &hsize, sizeof(hsize));
-			pool_write(frontend, nodes[i].role, size);
-		}
-	}
-	else
-	{
-		/* data row */
-		for (i=0;i<nrows;i++)
-		{
-			pool_write(frontend, "D", 1);
-			len = 6; /* int32 + int16; */
-			len += 4 + strlen(nodes[i].node_id);   /* int32 + data; */
-			len += 4 + strlen(nodes[i].hostname);  /* int32 + data; */
-			len += 4 + strlen(nodes[i].port);      /* int32 + data; */
-			len += 4 + strlen(nodes[i].status);    /* int32 + data; */
-			len += 4 + strlen(nodes[i].lb_weight); /* int32 + data; */
-			len += 4 + strlen(nodes[i].role);      /* int32 + data; */
-			len = htonl(len);
-			pool_write(frontend, &len, sizeof(len));
-			s = htons(num_fields);
-			pool_write(frontend, &s, sizeof(s));
-
-			len = htonl(strlen(nodes[i].node_id));
-			pool_write(frontend, &len, sizeof(len));
-			pool_write(frontend, nodes[i].node_id, strlen(nodes[i].node_id));
-
-			len = htonl(strlen(nodes[i].hostname));
-			pool_write(frontend, &len, sizeof(len));
-			pool_write(frontend, nodes[i].hostname, strlen(nodes[i].hostname));
-
-			len = htonl(strlen(nodes[i].port));
-			pool_write(frontend, &len, sizeof(len));
-			pool_write(frontend, nodes[i].port, strlen(nodes[i].port));
-
-			len = htonl(strlen(nodes[i].status));
-			pool_write(frontend, &len, sizeof(len));
-			pool_write(frontend, nodes[i].status, strlen(nodes[i].status));
-
-			len = htonl(strlen(nodes[i].lb_weight));
-			pool_write(frontend, &len, sizeof(len));
-			pool_write(frontend, nodes[i].lb_weight, strlen(nodes[i].lb_weight));
-
-			len = htonl(strlen(nodes[i].role));
-			pool_write(frontend, &len, sizeof(len));
-			pool_write(frontend, nodes[i].role, strlen(nodes[i].role));
-		}
+		values[0] = nodes[i].node_id;
+		values[1] = nodes[i].hostname;
+		values[2] = nodes[i].port;
+		values[3] = nodes[i].status;
+		values[4] = nodes[i].lb_weight;
+		values[5] = nodes[i].role;
+		values[6] = nodes[i].select_cnt;
+		values[7] = nodes[i].write_cnt;
+		values[8] = nodes[i].xact_cnt;
+		values[9] = nodes[i].bytes_in;
+		values[10] = nodes[i].bytes_out;
+		values[11] = nodes[i].error_cnt;
+		send_data_row(frontend, backend, num_fields, values);
 	}
 
 	send_complete_and_ready(frontend, backend, nrows);
@@ -1586,7 +1650,7 @@ void cache_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
 	 * Get raw cache stat data
 	 */
 	POOL_SETMASK2(&BlockSig, &oldmask);
-	pool_shmem_lock();
+	pool_shmem_lock(POOL_MEMQ_SHARED_LOCK);
 	mystats = pool_get_shmem_storage_stats();
 	pool_shmem_unlock();
 	POOL_SETMASK(&oldmask);
@@ -1664,3 +1728,276 @@ void cache_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
 
 	free(strp);
 }
+
+/*
+ * Show COPY FROM STDIN statistics summed up over all child processes
+ */
+void copy_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	static char *field_names[] = {"copy_in_count", "copy_in_bytes", "copy_in_time", "copy_in_throughput"};
+	short num_fields = sizeof(field_names)/sizeof(char *);
+	char values[4][POOLCONFIG_MAXVALLEN+1];
+	char *valuep[4];
+	long long int count = 0;
+	long long int bytes = 0;
+	long long int usec = 0;
+	int child;
+	int i;
+
+	for (child = 0; child < pool_config->num_init_children; child++)
+	{
+		count += process_info[child].copy_in_count;
+		bytes += process_info[child].copy_in_bytes;
+		usec += process_info[child].copy_in_usec;
+	}
+
+	i = 0;
+	snprintf(values[i++], POOLCONFIG_MAXVALLEN+1, "%lld", count);
+	snprintf(values[i++], POOLCONFIG_MAXVALLEN+1, "%lld", bytes);
+	snprintf(values[i++], POOLCONFIG_MAXVALLEN+1, "%.3f", usec / 1000000.0);
+	snprintf(values[i++], POOLCONFIG_MAXVALLEN+1, "%.0f", usec > 0 ? bytes * 1000000.0 / usec : 0.0);
+
+	for (i=0;i<num_fields;i++)
+		valuep[i] = values[i];
+
+	send_row_description(frontend, backend, num_fields, field_names);
+	send_data_row(frontend, backend, num_fields, valuep);
+	send_complete_and_ready(frontend, backend, 1);
+}
+
+/*
+ * Get query latency histograms summed up over all child
+ * processes. Latencies are in usec.
+ */
+POOL_REPORT_LATENCY* get_latency(int *nrows)
+{
+	int i;
+	int num_histograms = pool_latency_num_histograms();
+	POOL_REPORT_LATENCY *latency;
+	POOL_LATENCY_HISTOGRAM histogram;
+
+	latency = malloc((num_histograms > 0 ? num_histograms : 1) * sizeof(POOL_REPORT_LATENCY));
+	if (latency == NULL)
+	{
+		pool_error("get_latency: malloc failed");
+		*nrows = 0;
+		return NULL;
+	}
+
+	for (i=0;i<num_histograms;i++)
+	{
+		pool_latency_get_histogram(i, &histogram);
+
+		strlcpy(latency[i].name, pool_latency_histogram_name(i), POOLCONFIG_MAXNAMELEN+1);
+		snprintf(latency[i].count, POOLCONFIG_MAXCOUNTLEN+1, "%lld", histogram.count);
+		snprintf(latency[i].avg, POOLCONFIG_MAXCOUNTLEN+1, "%lld",
+				 histogram.count > 0 ? histogram.total_usec / histogram.count : 0);
+		snprintf(latency[i].p50, POOLCONFIG_MAXCOUNTLEN+1, "%lld", pool_latency_percentile(&histogram, 50.0));
+		snprintf(latency[i].p90, POOLCONFIG_MAXCOUNTLEN+1, "%lld", pool_latency_percentile(&histogram, 90.0));
+		snprintf(latency[i].p99, POOLCONFIG_MAXCOUNTLEN+1, "%lld", pool_latency_percentile(&histogram, 99.0));
+		snprintf(latency[i].p999, POOLCONFIG_MAXCOUNTLEN+1, "%lld", pool_latency_percentile(&histogram, 99.9));
+		snprintf(latency[i].max, POOLCONFIG_MAXCOUNTLEN+1, "%lld", histogram.max_usec);
+	}
+
+	*nrows = num_histograms;
+	return latency;
+}
+
+/*
+ * Show query latency for each kind of query and each backend node
+ */
+void latency_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	static char *field_names[] = {"name", "count", "avg_usec", "p50_usec", "p90_usec",
+								  "p99_usec", "p999_usec", "max_usec"};
+	short num_fields = sizeof(field_names)/sizeof(char *);
+	char *values[8];
+	int nrows;
+	int i;
+	POOL_REPORT_LATENCY *latency = get_latency(&nrows);
+
+	send_row_description(frontend, backend, num_fields, field_names);
+
+	for (i=0;i<nrows;i++)
+	{
+		values[0] = latency[i].name;
+		values[1] = latency[i].count;
+		values[2] = latency[i].avg;
+		values[3] = latency[i].p50;
+		values[4] = latency[i].p90;
+		values[5] = latency[i].p99;
+		values[6] = latency[i].p999;
+		values[7] = latency[i].max;
+		send_data_row(frontend, backend, num_fields, values);
+	}
+
+	send_complete_and_ready(frontend, backend, nrows);
+
+	free(latency);
+}
+
+/*
+ * Show what each child is doing. Activity of a child being updated
+ * at the moment may not be shown.
+ */
+void activity_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	static char *field_names[] = {"pool_pid", "state", "database", "username", "client",
+								  "node_ids", "state_change", "query_start", "fingerprint",
+								  "statements", "portals", "query"};
+	short num_fields = sizeof(field_names)/sizeof(char *);
+	char values[11][POOLCONFIG_MAXVALLEN+1];
+	char *valuep[12];
+	POOL_ACTIVITY activity;
+	time_t t;
+	int child;
+	int nrows = 0;
+	int len;
+	int i;
+
+	send_row_description(frontend, backend, num_fields, field_names);
+
+	for (child = 0; child < pool_config->num_init_children; child++)
+	{
+		if (!pool_get_activity(child, &activity))
+			continue;
+
+		snprintf(values[0], POOLCONFIG_MAXVALLEN+1, "%d", process_info[child].pid);
+		strlcpy(values[1], pool_activity_state_name(activity.state), POOLCONFIG_MAXVALLEN+1);
+		strlcpy(values[2], activity.database, POOLCONFIG_MAXVALLEN+1);
+		strlcpy(values[3], activity.username, POOLCONFIG_MAXVALLEN+1);
+		strlcpy(values[4], activity.client, POOLCONFIG_MAXVALLEN+1);
+
+		*values[5] = '\0';
+		len = 0;
+		for (i = 0; i < NUM_BACKENDS; i++)
+		{
+			if (activity.where_to_send[i])
+				len += snprintf(values[5] + len, POOLCONFIG_MAXVALLEN+1 - len, "%s%d", len > 0 ? "," : "", i);
+		}
+
+		t = activity.state_change.tv_sec;
+		*values[6] = '\0';
+		if (t > 0)
+			strftime(values[6], POOLCONFIG_MAXVALLEN+1, "%Y-%m-%d %H:%M:%S", localtime(&t));
+
+		t = activity.query_start.tv_sec;
+		*values[7] = '\0';
+		if (t > 0)
+			strftime(values[7], POOLCONFIG_MAXVALLEN+1, "%Y-%m-%d %H:%M:%S", localtime(&t));
+
+		*values[8] = '\0';
+		if (*activity.query)
+			snprintf(values[8], POOLCONFIG_MAXVALLEN+1, "%08x", activity.fingerprint);
+
+		snprintf(values[9], POOLCONFIG_MAXVALLEN+1, "%d", activity.num_statements);
+		snprintf(values[10], POOLCONFIG_MAXVALLEN+1, "%d", activity.num_portals);
+
+		for (i = 0; i < 11; i++)
+			valuep[i] = values[i];
+		valuep[11] = activity.query;
+
+		send_data_row(frontend, backend, num_fields, valuep);
+		nrows++;
+	}
+
+	send_complete_and_ready(frontend, backend, nrows);
+}
+
+/*
+ * Show statistics of each normalized query, in descending order of
+ * total latency.
+ */
+void query_stats_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	static char *field_names[] = {"fingerprint", "calls", "cache_hits", "cache_misses", "node_calls",
+								  "total_usec", "avg_usec", "max_usec", "query"};
+	short num_fields = sizeof(field_names)/sizeof(char *);
+	char values[8][POOLCONFIG_MAXVALLEN+1];
+	char *valuep[9];
+	POOL_QUERY_STATS *stats;
+	int nrows;
+	int len;
+	int i, j;
+
+	stats = pool_get_query_stats(&nrows);
+
+	send_row_description(frontend, backend, num_fields, field_names);
+
+	for (i = 0; i < nrows; i++)
+	{
+		*values[0] = '\0';
+		if (stats[i].fingerprint)
+			snprintf(values[0], POOLCONFIG_MAXVALLEN+1, "%08x", stats[i].fingerprint);
+		snprintf(values[1], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].calls);
+		snprintf(values[2], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].cache_hits);
+		snprintf(values[3], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].cache_misses);
+
+		/* "node id:number of queries" of each node the queries were sent to */
+		*values[4] = '\0';
+		len = 0;
+		for (j = 0; j < NUM_BACKENDS && len < POOLCONFIG_MAXVALLEN; j++)
+		{
+			if (stats[i].node_calls[j] > 0)
+				len += snprintf(values[4] + len, POOLCONFIG_MAXVALLEN+1 - len, "%s%d:%lld",
+								len > 0 ? "," : "", j, stats[i].node_calls[j]);
+		}
+
+		snprintf(values[5], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].total_usec);
+		snprintf(values[6], POOLCONFIG_MAXVALLEN+1, "%lld",
+				 stats[i].calls > 0 ? stats[i].total_usec / stats[i].calls : 0);
+		snprintf(values[7], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].max_usec);
+
+		for (j = 0; j < 8; j++)
+			valuep[j] = values[j];
+		valuep[8] = stats[i].query;
+
+		send_data_row(frontend, backend, num_fields, valuep);
+	}
+
+	send_complete_and_ready(frontend, backend, nrows);
+
+	free(stats);
+}
+
+void cache_tables_reporting(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	static char *field_names[] = {"database_oid", "table_oid", "num_registered", "num_hits",
+								  "num_invalidated", "invalidated_bytes", "num_evicted", "evicted_bytes"};
+	short num_fields = sizeof(field_names)/sizeof(char *);
+	char values[8][POOLCONFIG_MAXVALLEN+1];
+	char *valuep[8];
+	POOL_CACHE_TABLE_STATS *stats;
+	int nrows;
+	int i, j;
+
+	stats = pool_get_cache_table_stats(&nrows);
+
+	send_row_description(frontend, backend, num_fields, field_names);
+
+	for (i = 0; i < nrows; i++)
+	{
+		/* database oid is empty for the overflow entry, table oid for database */
+		*values[0] = '\0';
+		if (stats[i].dboid)
+			snprintf(values[0], POOLCONFIG_MAXVALLEN+1, "%d", stats[i].dboid);
+		*values[1] = '\0';
+		if (stats[i].table_oid)
+			snprintf(values[1], POOLCONFIG_MAXVALLEN+1, "%d", stats[i].table_oid);
+		snprintf(values[2], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].num_registered);
+		snprintf(values[3], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].num_hits);
+		snprintf(values[4], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].num_invalidated);
+		snprintf(values[5], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].invalidated_bytes);
+		snprintf(values[6], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].num_evicted);
+		snprintf(values[7], POOLCONFIG_MAXVALLEN+1, "%lld", stats[i].evicted_bytes);
+
+		for (j = 0; j < 8; j++)
+			valuep[j] = values[j];
+
+		send_data_row(frontend, backend, num_fields, valuep);
+	}
+
+	send_complete_and_ready(frontend, backend, nrows);
+
+	free(stats);
+}
@@ -26,6 +26,9 @@
 #include "pool_session_context.h"
 #include "pool_query_context.h"
 #include "pool_select_walker.h"
+#include "pool_node_stats.h"
+#include "pool_latency.h"
+#include "pool_activity.h"
 #include "parser/nodes.h"
 
 #include <string.h>
@@ -43,7 +46,12 @@ typedef enum {
 } POOL_DEST;
 
 static POOL_DEST send_to_where(Node *node, char *query);
+static POOL_DEST where_to_send_dest(POOL_QUERY_CONTEXT *query_context, Node *node, char *query);
+static bool where_to_send_has_function_call(POOL_QUERY_CONTEXT *query_context, Node *node);
 static void where_to_send_deallocate(POOL_QUERY_CONTEXT *query_context, Node *node);
+static bool is_load_balanceable_select(POOL_QUERY_CONTEXT *query_context, Node *node);
+static bool is_load_balanceable_multi_statement(POOL_QUERY_CONTEXT *query_context, char *query);
+static bool has_no_load_balance_comment(char *query);
 static char* remove_read_write(int len, const char *contents, int *rewritten_len);
 
 /*
@@ -252,7 +260,7 @@ bool pool_is_node_to_be_sent_in_current_query(int node_id)
 	if (!sc)
 		return true;
 
-	if (pool_is_query_in_progress() && sc->query_context)
+	if ((pool_is_query_in_progress() || pool_pipeline_pending()) && sc->query_context)
 	{
 		return pool_is_node_to_be_sent(sc->query_context, node_id);
 	}
@@ -330,6 +338,22 @@ void pool_where_to_send(POOL_QUERY_CONTEXT *query_context, char *query, Node *no
 		return;
 	}
 
+	/*
+	 * Look up system catalog needed to examine SELECTs with a single
+	 * query before any of the checks below, whatever the mode is.
+	 */
+	if (!RAW_MODE && node)
+	{
+		POOL_MEMORY_POOL *old_context;
+
+		old_context = pool_memory_context_switch_to(query_context->memory_context);
+		if (query_context->is_multi_statement && query_context->parse_tree_list != NIL)
+			pool_prefetch_relcache((Node *) query_context->parse_tree_list);
+		else
+			pool_prefetch_relcache(node);
+		pool_memory_context_switch_to(old_context);
+	}
+
 	/*
 	 * In raw mode, we send only to master node. Simple enough.
 	 */
@@ -349,11 +373,25 @@ void pool_where_to_send(POOL_QUERY_CONTEXT *query_context, char *query, Node *no
 		 * FROM table;END". Note that from pgpool-II 3.1.0
 		 * transactional statements such as "BEGIN" is unconditionally
 		 * sent to all nodes(see send_to_where() for more details).
-		 * Someday we might be able to understand all part of multi
-		 * statement queries, but until that day we need this band
-		 * aid.
+		 * If multi_statement_load_balance is enabled, we examine each
+		 * statement and send the query to the load balance node if
+		 * all of them are load balanceable SELECTs. The query is
+		 * never split up since it is executed in an implicit
+		 * transaction.
 		 */
-		if (query_context->is_multi_statement)
+		POOL_MEMORY_POOL *old_context;
+		bool load_balance;
+
+		old_context = pool_memory_context_switch_to(query_context->memory_context);
+		load_balance = is_load_balanceable_multi_statement(query_context, query);
+		pool_memory_context_switch_to(old_context);
+
+		if (load_balance)
+		{
+			pool_set_node_to_be_sent(query_context,
+									 session_context->load_balance_node_id);
+		}
+		else
 		{
 			pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
 		}
@@ -364,7 +402,7 @@ void pool_where_to_send(POOL_QUERY_CONTEXT *query_context, char *query, Node *no
 		POOL_MEMORY_POOL *old_context;
 
 		old_context = pool_memory_context_switch_to(query_context->memory_context);
-		dest = send_to_where(node, query);
+		dest = where_to_send_dest(query_context, node, query);
 		pool_memory_context_switch_to(old_context);
 
 		pool_debug("send_to_where: %d query: %s", dest, query);
@@ -400,70 +438,17 @@ void pool_where_to_send(POOL_QUERY_CONTEXT *query_context, char *query, Node *no
 					 !pool_is_failed_transaction() &&
 					 pool_get_transaction_isolation() != POOL_SERIALIZABLE))
 				{
-					BackendInfo *bkinfo = pool_get_node_info(session_context->load_balance_node_id);
-
 					/*
 					 * Load balance if possible
 					 */
-
-					/*
-					 * If replication delay is too much, we prefer to send to the primary.
-					 */
-					if (!strcmp(pool_config->master_slave_sub_mode, MODE_STREAMREP) &&
-						pool_config->delay_threshold &&
-						bkinfo->standby_delay > pool_config->delay_threshold)
-					{
-						pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
-					}
-
-					/*
-					 * If a writing function call is used, 
-					 * we prefer to send to the primary.
-					 */
-					else if (pool_has_function_call(node))
+					if (is_load_balanceable_select(query_context, node))
 					{
-						pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
-					}
-
-					/*
-					 * If system catalog is used in the SELECT, we
-					 * prefer to send to the primary. Example: SELECT
-					 * * FROM pg_class WHERE relname = 't1'; Because
-					 * 't1' is a constant, it's hard to recognize as
-					 * table name.  Most use case such query is
-					 * against system catalog, and the table name can
-					 * be a temporary table, it's best to query
-					 * against primary system catalog.
-					 * Please note that this test must be done *before*
-					 * test using pool_has_temp_table.
-					 */
-					else if (pool_has_system_catalog(node))
-					{
-						pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
-					}
-
-					/*
-					 * If temporary table is used in the SELECT,
-					 * we prefer to send to the primary.
-					 */
-					else if (pool_config->check_temp_table && pool_has_temp_table(node))
-					{
-						pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
-					}
-
-					/*
-					 * If unlogged table is used in the SELECT,
-					 * we prefer to send to the primary.
-					 */
-					else if (pool_has_unlogged_table(node))
-					{
-						pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
+						pool_set_node_to_be_sent(query_context,
+												 session_context->load_balance_node_id);
 					}
-
 					else
 					{
-						pool_set_node_to_be_sent(query_context,
-												 session_context->load_balance_node_id);
+						pool_set_node_to_be_sent(query_context, PRIMARY_NODE_ID);
 					}
 				}
 				else
@@ -487,7 +472,7 @@ void pool_where_to_send(POOL_QUERY_CONTEXT *query_context, char *query, Node *no
 			 * If a writing function call is used or replicate_select is true,
 			 * we prefer to send to all nodes.
 			 */
-			if (pool_has_function_call(node) || pool_config->replicate_select)
+			if (where_to_send_has_function_call(query_context, node) || pool_config->replicate_select)
 			{
 				pool_setall_node_to_be_sent(query_context);
 			}
@@ -567,6 +552,7 @@ POOL_STATUS pool_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 	POOL_CONNECTION_POOL *backend;
 	bool is_commit;
 	bool is_begin_read_write;
+	bool is_select;
 	int i;
 	int len;
 	char *string;
@@ -576,9 +562,13 @@ POOL_STATUS pool_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 	backend = session_context->backend;
 	is_commit = is_commit_or_rollback_query(query_context->parse_tree);
 	is_begin_read_write = false;
+	is_select = is_select_query(query_context->parse_tree, query_context->original_query);
 	len = 0;
 	string = NULL;
 
+	/* show DB nodes the query is sent to in SHOW pool_activity */
+	pool_activity_set_nodes(query_context);
+
 	/*
 	 * If the query is BEGIN READ WRITE or
 	 * BEGIN ... SERIALIZABLE in master/slave mode,
@@ -655,6 +645,8 @@ POOL_STATUS pool_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 		{
 			return POOL_END;
 		}
+
+		pool_node_stats_count_statement(i, is_select);
 	}
 
 	/* Wait for response */
@@ -728,6 +720,7 @@ POOL_STATUS pool_extended_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 	POOL_CONNECTION_POOL *backend;
 	bool is_commit;
 	bool is_begin_read_write;
+	bool pipelining;
 	int i;
 	int str_len;
 	int rewritten_len;
@@ -739,11 +732,15 @@ POOL_STATUS pool_extended_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 	backend = session_context->backend;
 	is_commit = is_commit_or_rollback_query(query_context->parse_tree);
 	is_begin_read_write = false;
+	pipelining = pool_is_pipelining_message();
 	str_len = 0;
 	rewritten_len = 0;
 	str = NULL;
 	rewritten_begin = NULL;
 
+	if (*kind == 'E')
+		pool_activity_set_nodes(query_context);
+
 	/*
 	 * If the query is BEGIN READ WRITE or
 	 * BEGIN ... SERIALIZABLE in master/slave mode,
@@ -804,7 +801,7 @@ POOL_STATUS pool_extended_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 			}
 		}
 
-		if (pool_config->log_per_node_statement)
+		if (pool_config->log_per_node_statement && pool_log_statement_sampled())
 		{
 			char msgbuf[QUERY_STRING_BUFFER_LEN];
 			char *stmt;
@@ -843,11 +840,33 @@ POOL_STATUS pool_extended_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 			per_node_statement_log(backend, i, msgbuf);
 		}
 
-		if (send_extended_protocol_message(backend, i, kind, str_len, str) != POOL_CONTINUE)
+		if (pipelining)
+		{
+			if (send_pipelined_protocol_message(backend, i, kind, str_len, str) != POOL_CONTINUE)
+			{
+				free(rewritten_begin);
+				return POOL_END;
+			}
+		}
+		else if (send_extended_protocol_message(backend, i, kind, str_len, str) != POOL_CONTINUE)
 		{
 			free(rewritten_begin);
 			return POOL_END;
 		}
+
+		if (*kind == 'E')
+			pool_node_stats_count_statement(i, is_select_query(query_context->parse_tree,
+															   query_context->original_query));
+	}
+
+	/*
+	 * Responses of pipelined messages are read by
+	 * ProcessBackendResponse() after Sync is forwarded.
+	 */
+	if (pipelining)
+	{
+		free(rewritten_begin);
+		return POOL_CONTINUE;
 	}
 
 	if (!is_begin_read_write)
@@ -913,6 +932,157 @@ POOL_STATUS pool_extended_send_and_wait(POOL_QUERY_CONTEXT *query_context,
 	return POOL_CONTINUE;
 }
 
+/*
+ * Return send_to_where() result. If the node is the parse tree of the
+ * query context, the result is remembered in the query context's
+ * syntax info so that it can be reused from the parse cache.
+ */
+static POOL_DEST where_to_send_dest(POOL_QUERY_CONTEXT *query_context, Node *node, char *query)
+{
+	POOL_SYNTAX_INFO *info = &query_context->syntax_info;
+
+	if (node != query_context->parse_tree)
+		return send_to_where(node, query);
+
+	if (!info->dest_valid)
+	{
+		info->dest = send_to_where(node, query);
+		info->dest_valid = true;
+	}
+	return info->dest;
+}
+
+/*
+ * Return pool_has_function_call() result. See where_to_send_dest()
+ * for the caching of the result.
+ */
+static bool where_to_send_has_function_call(POOL_QUERY_CONTEXT *query_context, Node *node)
+{
+	POOL_SYNTAX_INFO *info = &query_context->syntax_info;
+
+	if (node != query_context->parse_tree)
+		return pool_has_function_call(node);
+
+	if (!info->function_call_valid)
+	{
+		info->has_function_call = pool_has_function_call(node);
+		info->function_call_valid = true;
+	}
+	return info->has_function_call;
+}
+
+/*
+ * Return true if the SELECT can be sent to the load balance node.
+ * Caller must check that the transaction state allows load balancing.
+ */
+static bool is_load_balanceable_select(POOL_QUERY_CONTEXT *query_context, Node *node)
+{
+	POOL_SESSION_CONTEXT *session_context = pool_get_session_context();
+	BackendInfo *bkinfo = pool_get_node_info(session_context->load_balance_node_id);
+
+	/*
+	 * If replication delay is too much, we prefer to send to the primary.
+	 */
+	if (!strcmp(pool_config->master_slave_sub_mode, MODE_STREAMREP) &&
+		pool_config->delay_threshold &&
+		bkinfo->standby_delay > pool_config->delay_threshold)
+		return false;
+
+	/*
+	 * If a writing function call is used, we prefer to send to the
+	 * primary.
+	 */
+	if (where_to_send_has_function_call(query_context, node))
+		return false;
+
+	/*
+	 * If system catalog is used in the SELECT, we prefer to send to
+	 * the primary. Example: SELECT * FROM pg_class WHERE relname =
+	 * 't1'; Because 't1' is a constant, it's hard to recognize as
+	 * table name.  Most use case such query is against system
+	 * catalog, and the table name can be a temporary table, it's best
+	 * to query against primary system catalog.  Please note that this
+	 * test must be done *before* test using pool_has_temp_table.
+	 */
+	if (pool_has_system_catalog(node))
+		return false;
+
+	/*
+	 * If temporary table is used in the SELECT, we prefer to send to
+	 * the primary.
+	 */
+	if (pool_config->check_temp_table && pool_has_temp_table(node))
+		return false;
+
+	/*
+	 * If unlogged table is used in the SELECT, we prefer to send to
+	 * the primary.
+	 */
+	if (pool_has_unlogged_table(node))
+		return false;
+
+	return true;
+}
+
+/*
+ * Return true if the multi statement query can be sent to the load
+ * balance node as a whole. This is the case only when we are outside
+ * of an explicit transaction and every statement is a SELECT which
+ * could be load balanced by itself.
+ */
+static bool is_load_balanceable_multi_statement(POOL_QUERY_CONTEXT *query_context, char *query)
+{
+	POOL_CONNECTION_POOL *backend = pool_get_session_context()->backend;
+	ListCell *cell;
+
+	if (!pool_config->multi_statement_load_balance ||
+		!pool_config->load_balance_mode ||
+		MAJOR(backend) != PROTO_MAJOR_V3 ||
+		TSTATE(backend, PRIMARY_NODE_ID) != 'I' ||
+		query_context->parse_tree_list == NIL)
+		return false;
+
+	/*
+	 * The parser does not record where each statement starts, so a
+	 * NO LOAD BALANCE comment given to a later statement cannot be
+	 * told apart. Honor it wherever it appears.
+	 */
+	if (has_no_load_balance_comment(query))
+	{
+		pool_debug("is_load_balanceable_multi_statement: NO LOAD BALANCE comment found. query: %s", query);
+		return false;
+	}
+
+	foreach(cell, query_context->parse_tree_list)
+	{
+		Node *node = (Node *) lfirst(cell);
+
+		if (!is_select_query(node, query) ||
+			where_to_send_dest(query_context, node, query) != POOL_EITHER ||
+			!is_load_balanceable_select(query_context, node))
+		{
+			pool_debug("is_load_balanceable_multi_statement: statement is not load balanceable. query: %s", query);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Return true if NO LOAD BALANCE comment appears anywhere in the query.
+ */
+static bool has_no_load_balance_comment(char *query)
+{
+	char *p;
+
+	for (p = query; (p = strchr(p, '/')) != NULL; p++)
+	{
+		if (!strncasecmp(p, NO_LOAD_BALANCE, NO_LOAD_BALANCE_COMMENT_SZ))
+			return true;
+	}
+	return false;
+}
+
 /*
  * From syntactically analysis decide the statement to be sent to the
  * primary, the standby or either or both in master/slave+HR/SR mode.
@@ -0,0 +1,480 @@
+/* -*-pgsql-c-*- */
+/*
+ * $Header$
+ *
+ * pgpool: a language independent connection pool server for PostgreSQL
+ * written by Tatsuo Ishii
+ *
+ * Copyright (c) 2003-2013	PgPool Global Development Group
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that the above copyright notice appear in all
+ * copies and that both that copyright notice and this permission
+ * notice appear in supporting documentation, and that the name of the
+ * author not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The author makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * pool_query_stats.c: Per query statistics
+ *
+ * Queries are normalized by replacing constants found in the raw parse
+ * tree with '?', and the hash of the normalized query is used as the
+ * fingerprint of the query. Statistics of each fingerprint are kept in
+ * a hash table on shared memory, which holds up to query_stats_size
+ * fingerprints. Once the table is full, queries of new fingerprints
+ * are counted in the overflow entry. The table is protected by
+ * QUERY_STATS_SEM. Since the table is shared by all children, signals
+ * are blocked while holding the lock so that a child killed by a
+ * signal never leaves the lock held.
+ */
+#include "config.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "pool_config.h"
+#include "pool_parse_cache.h"
+#include "pool_query_stats.h"
+#include "pool_select_walker.h"
+#include "parser/parsenodes.h"
+#include "parser/parser.h"
+#include "parser/pool_memory.h"
+#include "parser/scanner.h"
+#include "utils/pool_memqcache.h"
+#include "utils/pool_signal.h"
+
+/*
+ * Header of query statistics area placed on shared memory. Hash
+ * buckets and entries follow.
+ */
+typedef struct
+{
+	int max_entries;			/* query_stats_size */
+	int num_entries;			/* entries in use except the overflow entry */
+	int num_buckets;			/* number of hash buckets. power of 2 */
+} POOL_QUERY_STATS_AREA;
+
+static POOL_QUERY_STATS_AREA *query_stats_area;
+static int *query_stats_buckets;	/* entry index + 1, or 0 if empty */
+static POOL_QUERY_STATS *query_stats_entries;	/* overflow entry comes last */
+
+/* Memory context used while normalizing a query */
+static POOL_MEMORY_POOL *query_stats_memory;
+
+/* Location and length of a constant in query string */
+typedef struct
+{
+	int location;
+	int length;
+} CONST_LOCATION;
+
+typedef struct
+{
+	CONST_LOCATION *locations;
+	int num_locations;
+	int max_locations;
+	int query_len;
+} CONST_LOCATIONS;
+
+static char *normalize_query(char *query, Node *parse_tree);
+static bool const_location_walker(Node *node, void *context);
+static void fill_const_lengths(char *query, CONST_LOCATIONS *ctx);
+static int compare_const_location(const void *p1, const void *p2);
+static int compare_total_usec(const void *p1, const void *p2);
+static POOL_QUERY_STATS *query_stats_lookup(unsigned int fingerprint, char *query);
+
+#define ROUND_UP_CACHE_LINE(size) \
+	(((size) + POOL_CACHE_LINE_SIZE - 1) / POOL_CACHE_LINE_SIZE * POOL_CACHE_LINE_SIZE)
+
+/*
+ * Allocate query statistics area on shared memory if enabled.
+ */
+int pool_init_query_stats(void)
+{
+	size_t size;
+	size_t buckets_size;
+	int num_buckets;
+
+	if (pool_config->query_stats_size <= 0)
+		return 0;
+
+	/* keep the hash table at most half full */
+	for (num_buckets = 1; num_buckets < pool_config->query_stats_size * 2; num_buckets <<= 1)
+		;
+
+	buckets_size = ROUND_UP_CACHE_LINE(sizeof(int) * num_buckets);
+	size = POOL_CACHE_LINE_SIZE + buckets_size +
+		sizeof(POOL_QUERY_STATS) * (pool_config->query_stats_size + 1);
+
+	query_stats_area = pool_shared_memory_create(size);
+	if (query_stats_area == NULL)
+	{
+		pool_error("pool_init_query_stats: failed to allocate shared memory. request size: %zd",
+				   size);
+		return -1;
+	}
+
+	memset(query_stats_area, 0, size);
+	query_stats_area->max_entries = pool_config->query_stats_size;
+	query_stats_area->num_buckets = num_buckets;
+	query_stats_buckets = (int *)((char *)query_stats_area + POOL_CACHE_LINE_SIZE);
+	query_stats_entries = (POOL_QUERY_STATS *)((char *)query_stats_buckets + buckets_size);
+	strlcpy(query_stats_entries[query_stats_area->max_entries].query, "<other queries>",
+			POOL_QUERY_STATS_QUERY_LEN);
+
+	return 0;
+}
+
+/*
+ * Record a query. parse_tree is either a statement or a List of all
+ * statements of a multi statement query. If it is NULL, the query is
+ * parsed here (parse cache is used if possible). where_to_send is NULL
+ * if the result was returned from query cache.
+ */
+void pool_query_stats_record(char *query, Node *parse_tree, POOL_LATENCY_KIND kind,
+							 char *where_to_send, long long int usec)
+{
+#ifdef HAVE_SIGPROCMASK
+	sigset_t oldmask;
+#else
+	int	oldmask;
+#endif
+	POOL_MEMORY_POOL *old_context;
+	POOL_QUERY_STATS *entry;
+	unsigned int fingerprint;
+	char *normalized;
+	int i;
+
+	if (!query_stats_area || !query)
+		return;
+
+	if (query_stats_memory == NULL)
+	{
+		query_stats_memory = pool_memory_create(PARSER_BLOCK_SIZE);
+		if (query_stats_memory == NULL)
+		{
+			pool_error("pool_query_stats_record: pool_memory_create failed");
+			return;
+		}
+	}
+	old_context = pool_memory_context_switch_to(query_stats_memory);
+
+	normalized = normalize_query(query, parse_tree);
+
+	/* 0 is reserved for the overflow entry */
+	fingerprint = hash_any((unsigned char *)normalized, strlen(normalized));
+	if (fingerprint == 0)
+		fingerprint = 1;
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(QUERY_STATS_SEM);
+
+	entry = query_stats_lookup(fingerprint, normalized);
+
+	entry->calls++;
+	if (kind == POOL_LATENCY_CACHE_HIT)
+		entry->cache_hits++;
+	else if (kind == POOL_LATENCY_CACHE_MISS)
+		entry->cache_misses++;
+	entry->total_usec += usec;
+	if (usec > entry->max_usec)
+		entry->max_usec = usec;
+
+	if (where_to_send)
+	{
+		for (i=0;i<NUM_BACKENDS;i++)
+		{
+			if (where_to_send[i])
+				entry->node_calls[i]++;
+		}
+	}
+
+	pool_semaphore_unlock(QUERY_STATS_SEM);
+	POOL_SETMASK(&oldmask);
+
+	pool_memory_context_switch_to(old_context);
+	pool_memory_delete(query_stats_memory, 1);
+}
+
+/*
+ * Return copy of query statistics sorted by total latency in
+ * descending order. The overflow entry is included only if it has
+ * been used. Caller must free the result.
+ */
+POOL_QUERY_STATS *pool_get_query_stats(int *nrows)
+{
+#ifdef HAVE_SIGPROCMASK
+	sigset_t oldmask;
+#else
+	int	oldmask;
+#endif
+	POOL_QUERY_STATS *stats;
+	int num_entries;
+
+	*nrows = 0;
+
+	if (!query_stats_area)
+		return NULL;
+
+	stats = malloc(sizeof(POOL_QUERY_STATS) * (query_stats_area->max_entries + 1));
+	if (stats == NULL)
+	{
+		pool_error("pool_get_query_stats: malloc failed");
+		return NULL;
+	}
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(QUERY_STATS_SEM);
+
+	num_entries = query_stats_area->num_entries;
+	memcpy(stats, query_stats_entries, sizeof(POOL_QUERY_STATS) * num_entries);
+	if (query_stats_entries[query_stats_area->max_entries].calls > 0)
+	{
+		memcpy(&stats[num_entries], &query_stats_entries[query_stats_area->max_entries],
+			   sizeof(POOL_QUERY_STATS));
+		num_entries++;
+	}
+
+	pool_semaphore_unlock(QUERY_STATS_SEM);
+	POOL_SETMASK(&oldmask);
+
+	qsort(stats, num_entries, sizeof(POOL_QUERY_STATS), compare_total_usec);
+
+	*nrows = num_entries;
+	return stats;
+}
+
+/*
+ * Return normalized query, in which constants are replaced with '?'
+ * and trailing spaces and semicolons are removed. If the query cannot
+ * be parsed, only the latter is done. Constants in every statement of
+ * a multi statement query are replaced.
+ */
+static char *normalize_query(char *query, Node *parse_tree)
+{
+	CONST_LOCATIONS ctx;
+	POOL_SYNTAX_INFO info;
+	List *parse_tree_list;
+	char *normalized;
+	int last;
+	int len;
+	int i;
+
+	if (parse_tree == NULL)
+	{
+		parse_tree_list = pool_parse_cache_lookup(query, &info);
+		if (parse_tree_list == NIL)
+			parse_tree_list = raw_parser(query);
+		parse_tree = (Node *) parse_tree_list;
+	}
+
+	ctx.num_locations = 0;
+	ctx.max_locations = 16;
+	ctx.locations = palloc(sizeof(CONST_LOCATION) * ctx.max_locations);
+	ctx.query_len = strlen(query);
+
+	if (parse_tree)
+	{
+		const_location_walker(parse_tree, &ctx);
+		if (ctx.num_locations > 0)
+			fill_const_lengths(query, &ctx);
+	}
+
+	/* Replacing a constant with '?' never makes the query longer */
+	normalized = palloc(ctx.query_len + 1);
+	len = 0;
+	last = 0;
+
+	for (i=0;i<ctx.num_locations;i++)
+	{
+		CONST_LOCATION *loc = &ctx.locations[i];
+
+		if (loc->length <= 0 || loc->location < last)
+			continue;
+
+		memcpy(normalized + len, query + last, loc->location - last);
+		len += loc->location - last;
+		normalized[len++] = '?';
+		last = loc->location + loc->length;
+	}
+	memcpy(normalized + len, query + last, ctx.query_len - last);
+	len += ctx.query_len - last;
+
+	while (len > 0 && (isspace((unsigned char)normalized[len - 1]) || normalized[len - 1] == ';'))
+		len--;
+	normalized[len] = '\0';
+
+	return normalized;
+}
+
+/*
+ * Walker function to collect locations of constants. INSERT, UPDATE
+ * and DELETE are not handled by raw_expression_tree_walker.
+ */
+static bool const_location_walker(Node *node, void *context)
+{
+	CONST_LOCATIONS *ctx = (CONST_LOCATIONS *) context;
+
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, A_Const))
+	{
+		A_Const *c = (A_Const *) node;
+
+		/* constants added by pgpool have no location */
+		if (c->location < 0 || c->location >= ctx->query_len)
+			return false;
+
+		if (ctx->num_locations >= ctx->max_locations)
+		{
+			ctx->max_locations *= 2;
+			ctx->locations = repalloc(ctx->locations, sizeof(CONST_LOCATION) * ctx->max_locations);
+		}
+		ctx->locations[ctx->num_locations].location = c->location;
+		ctx->locations[ctx->num_locations].length = -1;
+		ctx->num_locations++;
+		return false;
+	}
+	else if (IsA(node, InsertStmt))
+	{
+		InsertStmt *stmt = (InsertStmt *) node;
+
+		if (const_location_walker(stmt->selectStmt, context))
+			return true;
+		if (const_location_walker((Node *) stmt->returningList, context))
+			return true;
+		return const_location_walker((Node *) stmt->withClause, context);
+	}
+	else if (IsA(node, UpdateStmt))
+	{
+		UpdateStmt *stmt = (UpdateStmt *) node;
+
+		if (const_location_walker((Node *) stmt->targetList, context))
+			return true;
+		if (const_location_walker(stmt->whereClause, context))
+			return true;
+		if (const_location_walker((Node *) stmt->fromClause, context))
+			return true;
+		if (const_location_walker((Node *) stmt->returningList, context))
+			return true;
+		return const_location_walker((Node *) stmt->withClause, context);
+	}
+	else if (IsA(node, DeleteStmt))
+	{
+		DeleteStmt *stmt = (DeleteStmt *) node;
+
+		if (const_location_walker((Node *) stmt->usingClause, context))
+			return true;
+		if (const_location_walker(stmt->whereClause, context))
+			return true;
+		if (const_location_walker((Node *) stmt->returningList, context))
+			return true;
+		return const_location_walker((Node *) stmt->withClause, context);
+	}
+
+	return raw_expression_tree_walker(node, const_location_walker, context);
+}
+
+/*
+ * Find length of each constant by scanning the query. The scanner
+ * leaves a null byte after the text of the current token, so the
+ * length of the token is strlen() from its location. The location of
+ * a negative number is that of '-', which is a separate token.
+ */
+static void fill_const_lengths(char *query, CONST_LOCATIONS *ctx)
+{
+	core_yyscan_t yyscanner;
+	core_yy_extra_type yyextra;
+	core_YYSTYPE yylval;
+	YYLTYPE yylloc;
+	int start;
+	int tok;
+	int i;
+
+	qsort(ctx->locations, ctx->num_locations, sizeof(CONST_LOCATION), compare_const_location);
+
+	yyscanner = scanner_init(query, &yyextra, ScanKeywords, NumScanKeywords);
+
+	i = 0;
+	while (i < ctx->num_locations)
+	{
+		tok = core_yylex(&yylval, &yylloc, yyscanner);
+		if (tok == 0)
+			break;
+
+		/* skip duplicated locations */
+		while (i < ctx->num_locations && ctx->locations[i].location < yylloc)
+			i++;
+		if (i >= ctx->num_locations || ctx->locations[i].location != yylloc)
+			continue;
+
+		start = yylloc;
+		if (tok == '-')
+		{
+			tok = core_yylex(&yylval, &yylloc, yyscanner);
+			if (tok == 0)
+				break;
+		}
+		ctx->locations[i].length = yylloc - start + strlen(yyextra.scanbuf + yylloc);
+		i++;
+	}
+
+	scanner_finish(yyscanner);
+}
+
+static int compare_const_location(const void *p1, const void *p2)
+{
+	int l1 = ((CONST_LOCATION *) p1)->location;
+	int l2 = ((CONST_LOCATION *) p2)->location;
+
+	return (l1 > l2) ? 1 : ((l1 == l2) ? 0 : -1);
+}
+
+static int compare_total_usec(const void *p1, const void *p2)
+{
+	long long int t1 = ((POOL_QUERY_STATS *) p1)->total_usec;
+	long long int t2 = ((POOL_QUERY_STATS *) p2)->total_usec;
+
+	return (t1 < t2) ? 1 : ((t1 == t2) ? 0 : -1);
+}
+
+/*
+ * Find the entry of the normalized query. The normalized query is
+ * compared as well as the fingerprint so that queries whose
+ * fingerprints collide are kept apart. Only the first
+ * POOL_QUERY_STATS_QUERY_LEN - 1 bytes are kept in the entry, so
+ * queries which differ only after that and have the same fingerprint
+ * still share an entry. A new entry is added if not found. If the
+ * table is full, the overflow entry is returned. Must be called while
+ * holding QUERY_STATS_SEM.
+ */
+static POOL_QUERY_STATS *query_stats_lookup(unsigned int fingerprint, char *query)
+{
+	POOL_QUERY_STATS *entry;
+	int mask = query_stats_area->num_buckets - 1;
+	int i;
+
+	for (i = fingerprint & mask; query_stats_buckets[i]; i = (i + 1) & mask)
+	{
+		entry = &query_stats_entries[query_stats_buckets[i] - 1];
+		if (entry->fingerprint == fingerprint &&
+			!strncmp(entry->query, query, POOL_QUERY_STATS_QUERY_LEN - 1))
+			return entry;
+	}
+
+	if (query_stats_area->num_entries >= query_stats_area->max_entries)
+		return &query_stats_entries[query_stats_area->max_entries];
+
+	entry = &query_stats_entries[query_stats_area->num_entries++];
+	memset(entry, 0, sizeof(POOL_QUERY_STATS));
+	entry->fingerprint = fingerprint;
+	strlcpy(entry->query, query, POOL_QUERY_STATS_QUERY_LEN);
+	query_stats_buckets[i] = query_stats_area->num_entries;
+
+	return entry;
+}
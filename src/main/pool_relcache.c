@@ -22,13 +22,75 @@
  */
 #include "config.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "pool.h"
 #include "pool_relcache.h"
 #include "pool_session_context.h"
 #include "pool_config.h"
+#include "utils/pool_memqcache.h"
+
+/*
+ * Interned string. Database names and table names in relcaches point
+ * to str of this.
+ */
+typedef struct RelCacheString {
+	struct RelCacheString *next;	/* next string in the hash bucket */
+	uint32 hash;		/* case insensitive hash value of str */
+	int refcnt;			/* number of relcache entries referring this */
+	char str[1];		/* string data follows */
+} RelCacheString;
+
+static RelCacheString **string_buckets;	/* hash table of interned strings */
+static int string_nbuckets;		/* number of buckets. power of 2 */
+static int string_count;		/* number of interned strings */
+
+static volatile POOL_SHARED_RELCACHE *shared_relcache;	/* shared relcache on shmem */
+
+/*
+ * Lookups registered by pool_relcache_prefetch_add() and results of
+ * them fetched by pool_relcache_prefetch(). A result is handed to
+ * pool_search_relcache() once and then removed.
+ */
+#define MAX_RELCACHE_PREFETCH 64
+
+typedef struct {
+	POOL_RELCACHE *relcache;	/* relcache to be searched */
+	char *rel;			/* table name without double quotes */
+	int session_id;		/* LocalSessionId when registered */
+	int generation;		/* shared relcache generation when registered */
+	POOL_SELECT_RESULT *res;	/* query result. NULL if not fetched yet */
+} RelCachePrefetch;
+
+static RelCachePrefetch prefetch[MAX_RELCACHE_PREFETCH];
+static int num_prefetch;
+
+static char *relcache_strip_quote(char *table);
+static int relcache_lookup(POOL_RELCACHE *relcache, char *dbname, uint32 dbhash,
+						   char *rel, uint32 relhash, int local_session_id,
+						   time_t now, int generation);
+static POOL_SELECT_RESULT *relcache_prefetched_result(POOL_RELCACHE *relcache, char *rel,
+													  int local_session_id, int generation);
+static POOL_SELECT_RESULT *make_column_result(POOL_SELECT_RESULT *res, int column);
+static void relcache_remove_entry(POOL_RELCACHE *relcache, int index);
+static void relcache_lru_unlink(POOL_RELCACHE *relcache, int index);
+static void relcache_lru_push_head(POOL_RELCACHE *relcache, int index);
+static void relcache_lru_push_tail(POOL_RELCACHE *relcache, int index);
+static uint32 string_hash(const char *str);
+static char *lookup_interned_string(const char *str, uint32 hash);
+static char *intern_string(const char *str, uint32 hash);
+static void release_string(char *str);
+
+static int shared_relcache_generation(void);
+static uint32 shared_relcache_hash(uint32 sql_hash, char *dbname, char *relname);
+static POOL_SELECT_RESULT *shared_relcache_search(POOL_RELCACHE *relcache, char *dbname, char *relname);
+static void shared_relcache_register(POOL_RELCACHE *relcache, char *dbname, char *relname,
+									 POOL_SELECT_RESULT *res, int generation, time_t now);
+static int serialize_select_result(POOL_SELECT_RESULT *res, char *buf, int buflen);
+static POOL_SELECT_RESULT *deserialize_select_result(char *buf, int len);
 
 /*
  * Create relation cache
@@ -39,6 +101,9 @@ POOL_RELCACHE *pool_create_relcache(int cachesize, char *sql,
 {
 	POOL_RELCACHE *p;
 	PoolRelCache *ip;
+	int *buckets;
+	int nbuckets;
+	int i;
 
 	if (cachesize < 0)
 	{
@@ -46,7 +111,8 @@ POOL_RELCACHE *pool_create_relcache(int cachesize, char *sql,
 		return NULL;
 	}
 
-	ip = (PoolRelCache *)malloc(sizeof(PoolRelCache)*cachesize);
+	/* Allocate one more entry to avoid malloc(0) */
+	ip = (PoolRelCache *)malloc(sizeof(PoolRelCache)*(cachesize+1));
 	if (ip == NULL)
 	{
 		pool_error("pool_create_relcache: cannot allocate memory %zd", sizeof(PoolRelCache)*cachesize);
@@ -54,10 +120,25 @@ POOL_RELCACHE *pool_create_relcache(int cachesize, char *sql,
 	}
 	memset(ip, 0, sizeof(PoolRelCache)*cachesize);
 
+	/* Number of hash buckets is power of 2 */
+	for (nbuckets = 1; nbuckets < cachesize; nbuckets <<= 1)
+		;
+
+	buckets = (int *)malloc(sizeof(int)*nbuckets);
+	if (buckets == NULL)
+	{
+		pool_error("pool_create_relcache: cannot allocate memory %zd", sizeof(int)*nbuckets);
+		free(ip);
+		return NULL;
+	}
+	for (i=0;i<nbuckets;i++)
+		buckets[i] = -1;
+
 	p = (POOL_RELCACHE *)malloc(sizeof(POOL_RELCACHE));
 	if (p == NULL)
 	{
 		pool_error("pool_create_relcache: cannot allocate memory %zd", sizeof(POOL_RELCACHE));
+		free(buckets);
 		free(ip);
 		return NULL;
 	}
@@ -69,7 +150,20 @@ POOL_RELCACHE *pool_create_relcache(int cachesize, char *sql,
 	p->cache_is_session_local = issessionlocal;
 	p->no_cache_if_zero = false;
 	p->cache = ip;
-	
+	p->sql_hash = hash_any((unsigned char *)p->sql, strlen(p->sql));
+	p->buckets = buckets;
+	p->nbuckets = nbuckets;
+
+	/* All entries are unused and linked to LRU list in order */
+	for (i=0;i<cachesize;i++)
+	{
+		ip[i].hash_next = -1;
+		ip[i].lru_prev = i - 1;
+		ip[i].lru_next = (i == cachesize - 1) ? -1 : i + 1;
+	}
+	p->lru_head = cachesize > 0 ? 0 : -1;
+	p->lru_tail = cachesize - 1;
+
 	return p;
 }
 /*
@@ -79,10 +173,30 @@ void pool_discard_relcache(POOL_RELCACHE *relcache)
 {
 	int i;
 
+	/* Forget prefetched results for the relcache */
+	for (i=0;i<num_prefetch;)
+	{
+		if (prefetch[i].relcache != relcache)
+		{
+			i++;
+			continue;
+		}
+		free(prefetch[i].rel);
+		if (prefetch[i].res)
+			free_select_result(prefetch[i].res);
+		prefetch[i] = prefetch[--num_prefetch];
+	}
+
 	for (i=0;i<relcache->num;i++)
 	{
-		(*relcache->unregister_func)(relcache->cache[i].data);
+		if (relcache->cache[i].dbname)
+		{
+			(*relcache->unregister_func)(relcache->cache[i].data);
+			release_string(relcache->cache[i].dbname);
+			release_string(relcache->cache[i].relname);
+		}
 	}
+	free(relcache->buckets);
 	free(relcache->cache);
 	free(relcache);
 }
@@ -96,21 +210,17 @@ void *pool_search_relcache(POOL_RELCACHE *relcache, POOL_CONNECTION_POOL *backen
 	char *rel;
 	char *dbname;
 	int i;
-	int maxrefcnt = INT_MAX;
 	char query[1024];
 	POOL_SELECT_RESULT *res = NULL;
-	int index = 0;
+	int index;
 	int local_session_id;
 	time_t now;
 	void *result;
-
-	/* Eliminate double quotes */
-	rel = malloc(strlen(table)+1);
-	if (!rel)
-	{
-		pool_error("pool_search_relcache: malloc failed");
-		return NULL;
-	}
+	int generation;
+	bool use_shared;
+	uint32 dbhash;
+	uint32 relhash;
+	uint32 hash;
 
 	local_session_id = pool_get_local_session_id();
 	if (local_session_id < 0)
@@ -119,128 +229,625 @@ void *pool_search_relcache(POOL_RELCACHE *relcache, POOL_CONNECTION_POOL *backen
 		return NULL;
 	}
 
-	for(i=0;*table;table++)
-	{
-		if (*table != '"')
-			rel[i++] = *table;
-	}
-	rel[i] = '\0';
+	/* Eliminate double quotes */
+	rel = relcache_strip_quote(table);
+	if (!rel)
+		return NULL;
 
 	/* Obtain database name */
 	dbname = MASTER_CONNECTION(backend)->sp->database;
 
 	now = time(NULL);
 
+	/*
+	 * Session local caches are not shared among children since they
+	 * depend on session's status such as temporary tables.
+	 */
+	use_shared = shared_relcache != NULL && !relcache->cache_is_session_local;
+	generation = shared_relcache_generation();
+
+	dbhash = string_hash(dbname);
+	relhash = string_hash(rel);
+	hash = dbhash ^ (relhash * 31);
+
 	/* Look for cache first */
-	for (i=0;i<relcache->num;i++)
+	i = relcache_lookup(relcache, dbname, dbhash, rel, relhash,
+						local_session_id, now, generation);
+	if (i >= 0)
+	{
+		/* Found */
+		if (relcache->cache[i].refcnt < INT_MAX)
+			relcache->cache[i].refcnt++;
+		relcache_lru_unlink(relcache, i);
+		relcache_lru_push_head(relcache, i);
+		free(rel);
+		return relcache->cache[i].data;
+	}
+
+	/* Not in cache. Check the result prefetched by pool_relcache_prefetch() */
+	res = relcache_prefetched_result(relcache, rel, local_session_id, generation);
+
+	/* Check the shared relcache */
+	if (res == NULL && use_shared)
+		res = shared_relcache_search(relcache, dbname, rel);
+
+	/* Not in shared relcache either. Check the system catalog */
+	if (res == NULL)
+	{
+		snprintf(query, sizeof(query), relcache->sql, rel);
+
+		per_node_statement_log(backend, MASTER_NODE_ID, query);
+
+		if (do_query(MASTER(backend), query, &res, MAJOR(backend)) != POOL_CONTINUE)
+		{
+			pool_error("pool_search_relcache: do_query failed");
+			if (res)
+				free_select_result(res);
+			free(rel);
+			return NULL;
+		}
+
+		if (use_shared)
+			shared_relcache_register(relcache, dbname, rel, res, generation, now);
+	}
+
+	/* Register cache */
+	result = (*relcache->register_func)(res);
+
+	if (relcache->num > 0 && (!relcache->no_cache_if_zero || result))
 	{
 		/*
-		 * If cache is session local, we need to check session id
+		 * Least recently used entry is replaced. Unused entries are
+		 * always at the tail of LRU list.
 		 */
-		if (relcache->cache_is_session_local)
+		index = relcache->lru_tail;
+
+		if (relcache->cache[index].dbname)
 		{
-			if (relcache->cache[i].session_id != local_session_id)
-				continue;
+			pool_log("pool_search_relcache: cache replacement happend");
+			relcache_remove_entry(relcache, index);
 		}
 
-		if (strcasecmp(relcache->cache[i].dbname, dbname) == 0 &&
-			strcasecmp(relcache->cache[i].relname, rel) == 0)
+		relcache->cache[index].dbname = intern_string(dbname, dbhash);
+		relcache->cache[index].relname = intern_string(rel, relhash);
+		relcache->cache[index].hash = hash;
+		relcache->cache[index].refcnt = 1;
+		relcache->cache[index].session_id = local_session_id;
+		relcache->cache[index].generation = generation;
+		if (pool_config->relcache_expire > 0)
 		{
-			if (relcache->cache[i].expire > 0)
-			{
-				if (now > relcache->cache[i].expire)
-				{
-					pool_debug("pool_search_relcache: relcache for database:%s table:%s expired. now:%ld expiration time:%ld", dbname, rel, now, relcache->cache[i].expire);
-					relcache->cache[i].refcnt = 0;
-					break;
-				}
-			}
+			relcache->cache[index].expire = now + pool_config->relcache_expire;
+		}
+		else
+		{
+			relcache->cache[index].expire = 0;
+		}
+		relcache->cache[index].data = result;
+
+		relcache->cache[index].hash_next = relcache->buckets[hash & (relcache->nbuckets - 1)];
+		relcache->buckets[hash & (relcache->nbuckets - 1)] = index;
+		relcache_lru_unlink(relcache, index);
+		relcache_lru_push_head(relcache, index);
+	}
+	free(rel);
+	free_select_result(res);
+
+	return 	result;
+}
+
+/*
+ * Register a relcache lookup which is going to be done by
+ * pool_search_relcache() so that pool_relcache_prefetch() can issue
+ * it along with other lookups in a single query. The query of the
+ * relcache must return exactly one row with one column. Lookups
+ * found in the cache are not registered.
+ */
+void pool_relcache_prefetch_add(POOL_RELCACHE *relcache, POOL_CONNECTION_POOL *backend, char *table)
+{
+	char *rel;
+	char *dbname;
+	int local_session_id;
+	int generation;
+	int i;
+
+	if (relcache == NULL || num_prefetch >= MAX_RELCACHE_PREFETCH)
+		return;
+
+	local_session_id = pool_get_local_session_id();
+	if (local_session_id < 0)
+		return;
 
-			/* Found */
-			if (relcache->cache[i].refcnt < INT_MAX)
-				relcache->cache[i].refcnt++;
+	rel = relcache_strip_quote(table);
+	if (!rel)
+		return;
+
+	dbname = MASTER_CONNECTION(backend)->sp->database;
+	generation = shared_relcache_generation();
+
+	if (relcache_lookup(relcache, dbname, string_hash(dbname), rel, string_hash(rel),
+						local_session_id, time(NULL), generation) >= 0)
+	{
+		free(rel);
+		return;
+	}
+
+	for (i = 0; i < num_prefetch; i++)
+	{
+		if (prefetch[i].relcache == relcache && !strcmp(prefetch[i].rel, rel))
+		{
 			free(rel);
-			return relcache->cache[i].data;
+			return;
 		}
 	}
 
-	/* Not in cache. Check the system catalog */
-	snprintf(query, sizeof(query), relcache->sql, rel);
+	prefetch[num_prefetch].relcache = relcache;
+	prefetch[num_prefetch].rel = rel;
+	prefetch[num_prefetch].session_id = local_session_id;
+	prefetch[num_prefetch].generation = generation;
+	prefetch[num_prefetch].res = NULL;
+
+	if (shared_relcache != NULL && !relcache->cache_is_session_local)
+		prefetch[num_prefetch].res = shared_relcache_search(relcache, dbname, rel);
+
+	num_prefetch++;
+}
+
+/*
+ * Issue queries of lookups registered by pool_relcache_prefetch_add()
+ * as sub queries of one SELECT so that they need only one round trip
+ * to the master node. Results are kept until pool_search_relcache()
+ * asks for them. If the query fails, pool_search_relcache() does the
+ * lookups one by one as usual.
+ */
+void pool_relcache_prefetch(POOL_CONNECTION_POOL *backend)
+{
+	POOL_SELECT_RESULT *res = NULL;
+	char *query;
+	char *p;
+	char *dbname;
+	size_t len;
+	time_t now;
+	int num_fetch = 0;
+	int column;
+	int i;
+
+	len = sizeof("SELECT ");
+	for (i = 0; i < num_prefetch; i++)
+	{
+		if (prefetch[i].res)
+			continue;
+		len += strlen(prefetch[i].relcache->sql) + strlen(prefetch[i].rel) + sizeof("(), ");
+		num_fetch++;
+	}
+
+	/* Nothing to be gained */
+	if (num_fetch <= 1)
+		return;
+
+	query = malloc(len);
+	if (!query)
+	{
+		pool_error("pool_relcache_prefetch: malloc failed");
+		return;
+	}
+
+	p = query;
+	p += sprintf(p, "SELECT ");
+	for (i = 0; i < num_prefetch; i++)
+	{
+		if (prefetch[i].res)
+			continue;
+		if (p != query + strlen("SELECT "))
+			p += sprintf(p, ", ");
+		*p++ = '(';
+		p += sprintf(p, prefetch[i].relcache->sql, prefetch[i].rel);
+		*p++ = ')';
+	}
+	*p = '\0';
 
 	per_node_statement_log(backend, MASTER_NODE_ID, query);
 
-	if (do_query(MASTER(backend), query, &res, MAJOR(backend)) != POOL_CONTINUE)
+	if (do_query(MASTER(backend), query, &res, MAJOR(backend)) != POOL_CONTINUE ||
+		res == NULL || res->numrows != 1 || res->rowdesc->num_attrs != num_fetch)
 	{
-		pool_error("pool_search_relcache: do_query failed");
+		pool_debug("pool_relcache_prefetch: prefetch failed");
 		if (res)
 			free_select_result(res);
-		free(rel);
+		free(query);
+		return;
+	}
+	free(query);
+
+	dbname = MASTER_CONNECTION(backend)->sp->database;
+	now = time(NULL);
+	column = 0;
+
+	for (i = 0; i < num_prefetch; i++)
+	{
+		POOL_RELCACHE *relcache = prefetch[i].relcache;
+
+		if (prefetch[i].res)
+			continue;
+
+		prefetch[i].res = make_column_result(res, column++);
+		if (prefetch[i].res && shared_relcache != NULL && !relcache->cache_is_session_local)
+			shared_relcache_register(relcache, dbname, prefetch[i].rel, prefetch[i].res,
+									 prefetch[i].generation, now);
+	}
+	free_select_result(res);
+
+	pool_debug("pool_relcache_prefetch: fetched %d lookups", num_fetch);
+}
+
+/*
+ * Forget lookups registered by pool_relcache_prefetch_add() and not
+ * used yet.
+ */
+void pool_relcache_prefetch_reset(void)
+{
+	int i;
+
+	for (i = 0; i < num_prefetch; i++)
+	{
+		free(prefetch[i].rel);
+		if (prefetch[i].res)
+			free_select_result(prefetch[i].res);
+	}
+	num_prefetch = 0;
+}
+
+/*
+ * Return malloced copy of table name with double quotes eliminated.
+ */
+static char *relcache_strip_quote(char *table)
+{
+	char *rel;
+	int i;
+
+	rel = malloc(strlen(table)+1);
+	if (!rel)
+	{
+		pool_error("relcache_strip_quote: malloc failed");
 		return NULL;
 	}
 
+	for(i=0;*table;table++)
+	{
+		if (*table != '"')
+			rel[i++] = *table;
+	}
+	rel[i] = '\0';
+	return rel;
+}
+
+/*
+ * Look for valid cache entry of the database and the table. Returns
+ * index of the entry or -1 if not found. Entries no longer valid are
+ * removed.
+ */
+static int relcache_lookup(POOL_RELCACHE *relcache, char *dbname, uint32 dbhash,
+						   char *rel, uint32 relhash, int local_session_id,
+						   time_t now, int generation)
+{
+	char *interned_dbname;
+	char *interned_rel;
+	int i;
+
+	if (relcache->num <= 0)
+		return -1;
+
 	/*
-	 * Look for replacement in cache
+	 * Since database names and table names in the cache are interned,
+	 * we can compare them by pointers. If they are not interned yet,
+	 * they are not in the cache.
 	 */
-	for (i=0;i<relcache->num;i++)
+	interned_dbname = lookup_interned_string(dbname, dbhash);
+	interned_rel = lookup_interned_string(rel, relhash);
+
+	if (!interned_dbname || !interned_rel)
+		return -1;
+
+	for (i = relcache->buckets[(dbhash ^ (relhash * 31)) & (relcache->nbuckets - 1)]; i >= 0;
+		 i = relcache->cache[i].hash_next)
 	{
+		if (relcache->cache[i].dbname != interned_dbname ||
+			relcache->cache[i].relname != interned_rel)
+			continue;
+
 		/*
-		 * If cache is session local, we can discard old cache immediately
+		 * If cache is session local, we need to check session id
 		 */
-		if (relcache->cache_is_session_local)
+		if (relcache->cache_is_session_local &&
+			relcache->cache[i].session_id != local_session_id)
+		{
+			relcache_remove_entry(relcache, i);
+			return -1;
+		}
+
+		if (relcache->cache[i].expire > 0)
 		{
-			if (relcache->cache[i].session_id != local_session_id)
+			if (now > relcache->cache[i].expire)
 			{
-				index = i;
-				relcache->cache[i].refcnt = 0;
-				break;
+				pool_debug("pool_search_relcache: relcache for database:%s table:%s expired. now:%ld expiration time:%ld", dbname, rel, now, relcache->cache[i].expire);
+				relcache_remove_entry(relcache, i);
+				return -1;
 			}
 		}
 
-		if (relcache->cache[i].refcnt == 0)
+		/* Relations might have been modified by other child */
+		if (relcache->cache[i].generation != generation)
 		{
-			/* Found empty slot */
-			index = i;
-			break;
+			pool_debug("pool_search_relcache: relcache for database:%s table:%s invalidated", dbname, rel);
+			relcache_remove_entry(relcache, i);
+			return -1;
 		}
-		else if (relcache->cache[i].refcnt < maxrefcnt)
+
+		return i;
+	}
+	return -1;
+}
+
+/*
+ * Take out the result prefetched for the lookup. Returns NULL if
+ * there is none. Results fetched in another session or before DDL
+ * are discarded.
+ */
+static POOL_SELECT_RESULT *relcache_prefetched_result(POOL_RELCACHE *relcache, char *rel,
+													  int local_session_id, int generation)
+{
+	POOL_SELECT_RESULT *res;
+	int i;
+
+	for (i = 0; i < num_prefetch; i++)
+	{
+		if (prefetch[i].relcache != relcache || strcmp(prefetch[i].rel, rel))
+			continue;
+
+		res = prefetch[i].res;
+		if (res && (prefetch[i].session_id != local_session_id ||
+					prefetch[i].generation != generation))
 		{
-			maxrefcnt = relcache->cache[i].refcnt;
-			index = i;
+			free_select_result(res);
+			res = NULL;
 		}
+
+		free(prefetch[i].rel);
+		prefetch[i] = prefetch[--num_prefetch];
+		return res;
 	}
+	return NULL;
+}
 
-	if (relcache->cache[index].refcnt != 0)
+/*
+ * Build a query result consisting of the column of the first row of
+ * res.
+ */
+static POOL_SELECT_RESULT *make_column_result(POOL_SELECT_RESULT *res, int column)
+{
+	char buf[SHARED_RELCACHE_DATA_LEN];
+	char *data = res->data[column];
+	int num = 1;
+	int len = data ? strlen(data) : -1;
+	int pos = 0;
+
+	if (sizeof(int) * 3 + (len > 0 ? len : 0) > sizeof(buf))
+		return NULL;
+
+	memcpy(buf + pos, &num, sizeof(int));
+	pos += sizeof(int);
+	memcpy(buf + pos, &num, sizeof(int));
+	pos += sizeof(int);
+	memcpy(buf + pos, &len, sizeof(int));
+	pos += sizeof(int);
+	if (len > 0)
 	{
-		pool_log("pool_search_relcache: cache replacement happend");
+		memcpy(buf + pos, data, len);
+		pos += len;
 	}
+	return deserialize_select_result(buf, pos);
+}
 
-	/* Register cache */
-	result = (*relcache->register_func)(res);
+/*
+ * Remove i th entry from the hash table and move it to the tail of LRU
+ * list as an unused entry. User data is unregistered.
+ */
+static void relcache_remove_entry(POOL_RELCACHE *relcache, int index)
+{
+	PoolRelCache *entry = &relcache->cache[index];
+	int *p;
 
-	if (!relcache->no_cache_if_zero || result)
+	for (p = &relcache->buckets[entry->hash & (relcache->nbuckets - 1)]; *p >= 0;
+		 p = &relcache->cache[*p].hash_next)
 	{
-		strlcpy(relcache->cache[index].dbname, dbname, MAX_ITEM_LENGTH);
-		strlcpy(relcache->cache[index].relname, rel, MAX_ITEM_LENGTH);
-		relcache->cache[index].refcnt = 1;
-		relcache->cache[index].session_id = local_session_id;
-		if (pool_config->relcache_expire > 0)
+		if (*p == index)
 		{
-			relcache->cache[index].expire = now + pool_config->relcache_expire;
+			*p = entry->hash_next;
+			break;
 		}
-		else
+	}
+	entry->hash_next = -1;
+
+	(*relcache->unregister_func)(entry->data);
+	entry->data = NULL;
+	release_string(entry->dbname);
+	release_string(entry->relname);
+	entry->dbname = entry->relname = NULL;
+	entry->refcnt = 0;
+
+	relcache_lru_unlink(relcache, index);
+	relcache_lru_push_tail(relcache, index);
+}
+
+static void relcache_lru_unlink(POOL_RELCACHE *relcache, int index)
+{
+	PoolRelCache *entry = &relcache->cache[index];
+
+	if (entry->lru_prev >= 0)
+		relcache->cache[entry->lru_prev].lru_next = entry->lru_next;
+	else
+		relcache->lru_head = entry->lru_next;
+
+	if (entry->lru_next >= 0)
+		relcache->cache[entry->lru_next].lru_prev = entry->lru_prev;
+	else
+		relcache->lru_tail = entry->lru_prev;
+
+	entry->lru_prev = entry->lru_next = -1;
+}
+
+static void relcache_lru_push_head(POOL_RELCACHE *relcache, int index)
+{
+	PoolRelCache *entry = &relcache->cache[index];
+
+	entry->lru_prev = -1;
+	entry->lru_next = relcache->lru_head;
+	if (relcache->lru_head >= 0)
+		relcache->cache[relcache->lru_head].lru_prev = index;
+	relcache->lru_head = index;
+	if (relcache->lru_tail < 0)
+		relcache->lru_tail = index;
+}
+
+static void relcache_lru_push_tail(POOL_RELCACHE *relcache, int index)
+{
+	PoolRelCache *entry = &relcache->cache[index];
+
+	entry->lru_next = -1;
+	entry->lru_prev = relcache->lru_tail;
+	if (relcache->lru_tail >= 0)
+		relcache->cache[relcache->lru_tail].lru_next = index;
+	relcache->lru_tail = index;
+	if (relcache->lru_head < 0)
+		relcache->lru_head = index;
+}
+
+/*
+ * Case insensitive hash function for database and table names.
+ */
+static uint32 string_hash(const char *str)
+{
+	uint32 h = 0;
+
+	for (; *str; str++)
+	{
+		h += (unsigned char)tolower((unsigned char)*str);
+		h += (h << 10);
+		h ^= (h >> 6);
+	}
+	h += (h << 3);
+	h ^= (h >> 11);
+	h += (h << 15);
+
+	return h;
+}
+
+/*
+ * Look for interned string which is equal to str ignoring case. If
+ * not found, returns NULL.
+ */
+static char *lookup_interned_string(const char *str, uint32 hash)
+{
+	RelCacheString *s;
+
+	if (string_buckets == NULL)
+		return NULL;
+
+	for (s = string_buckets[hash & (string_nbuckets - 1)]; s; s = s->next)
+	{
+		if (s->hash == hash && strcasecmp(s->str, str) == 0)
+			return s->str;
+	}
+	return NULL;
+}
+
+/*
+ * Intern a string. Database names and table names used in relcaches
+ * are kept only once in a process, with a reference count.
+ */
+static char *intern_string(const char *str, uint32 hash)
+{
+	RelCacheString *s;
+	int i;
+
+	if (string_buckets == NULL || string_count >= string_nbuckets)
+	{
+		/* Create or enlarge the hash table */
+		int nbuckets = string_nbuckets ? string_nbuckets * 2 : 256;
+		RelCacheString **buckets = calloc(nbuckets, sizeof(RelCacheString *));
+
+		if (buckets)
 		{
-			relcache->cache[index].expire = 0;
+			for (i = 0; i < string_nbuckets; i++)
+			{
+				while ((s = string_buckets[i]) != NULL)
+				{
+					string_buckets[i] = s->next;
+					s->next = buckets[s->hash & (nbuckets - 1)];
+					buckets[s->hash & (nbuckets - 1)] = s;
+				}
+			}
+			free(string_buckets);
+			string_buckets = buckets;
+			string_nbuckets = nbuckets;
+		}
+		else if (string_buckets == NULL)
+		{
+			pool_error("intern_string: calloc failed");
+			child_exit(1);
 		}
-		/*
-		 * Call user defined unregister/register function.
-		 */
-		(*relcache->unregister_func)(relcache->cache[index].data);
-		relcache->cache[index].data = result;
 	}
-	free(rel);
-	free_select_result(res);
 
-	return 	result;
+	for (s = string_buckets[hash & (string_nbuckets - 1)]; s; s = s->next)
+	{
+		if (s->hash == hash && strcasecmp(s->str, str) == 0)
+		{
+			s->refcnt++;
+			return s->str;
+		}
+	}
+
+	s = malloc(offsetof(RelCacheString, str) + strlen(str) + 1);
+	if (s == NULL)
+	{
+		pool_error("intern_string: malloc failed");
+		child_exit(1);
+	}
+	s->hash = hash;
+	s->refcnt = 1;
+	strcpy(s->str, str);
+	s->next = string_buckets[hash & (string_nbuckets - 1)];
+	string_buckets[hash & (string_nbuckets - 1)] = s;
+	string_count++;
+
+	return s->str;
+}
+
+/*
+ * Release an interned string. If nobody refers to it anymore, it is
+ * freed.
+ */
+static void release_string(char *str)
+{
+	RelCacheString *s;
+	RelCacheString **p;
+
+	if (str == NULL)
+		return;
+
+	s = (RelCacheString *)(str - offsetof(RelCacheString, str));
+	if (--s->refcnt > 0)
+		return;
+
+	for (p = &string_buckets[s->hash & (string_nbuckets - 1)]; *p; p = &(*p)->next)
+	{
+		if (*p == s)
+		{
+			*p = s->next;
+			break;
+		}
+	}
+	string_count--;
+	free(s);
 }
 
 /*
@@ -282,3 +889,316 @@ void *string_unregister_func(void *data)
 	free(data);
 	return data;
 }
+
+/*
+ * Create shared relcache. This must be called by pgpool main
+ * process before forking children.
+ */
+int pool_init_shared_relcache(void)
+{
+	size_t size;
+	int num;
+
+	/* Round up to multiple of the number of ways */
+	num = (pool_config->shared_relcache_size + SHARED_RELCACHE_WAYS - 1) /
+		SHARED_RELCACHE_WAYS * SHARED_RELCACHE_WAYS;
+
+	size = sizeof(POOL_SHARED_RELCACHE) + sizeof(POOL_SHARED_RELCACHE_ENTRY) * (num - 1);
+	shared_relcache = pool_shared_memory_create(size);
+	if (shared_relcache == NULL)
+	{
+		pool_error("pool_init_shared_relcache: failed to allocate shared relcache");
+		return -1;
+	}
+	memset((void *)shared_relcache, 0, size);
+	shared_relcache->generation = 1;
+	shared_relcache->num = num;
+
+	pool_log("pool_init_shared_relcache: %d entries (%zd bytes) allocated", num, size);
+	return 0;
+}
+
+/*
+ * Invalidate all shared relcache entries and relcaches of children
+ * registered before. This should be called when a DDL which might
+ * change the result of relcache queries has been executed.
+ */
+void pool_invalidate_shared_relcache(void)
+{
+#ifdef HAVE_SIGPROCMASK
+	sigset_t oldmask;
+#else
+	int	oldmask;
+#endif
+
+	if (shared_relcache == NULL)
+		return;
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(RELCACHE_SEM);
+	shared_relcache->generation++;
+	/* 0 is reserved for unused entries */
+	if (shared_relcache->generation <= 0)
+		shared_relcache->generation = 1;
+	pool_semaphore_unlock(RELCACHE_SEM);
+	POOL_SETMASK(&oldmask);
+
+	pool_debug("pool_invalidate_shared_relcache: generation:%d", shared_relcache->generation);
+}
+
+/*
+ * Return current generation of shared relcache. If shared relcache is
+ * not enabled, returns 0.
+ */
+static int shared_relcache_generation(void)
+{
+	if (shared_relcache == NULL)
+		return 0;
+	return shared_relcache->generation;
+}
+
+static uint32 shared_relcache_hash(uint32 sql_hash, char *dbname, char *relname)
+{
+	return sql_hash ^
+		hash_any((unsigned char *)dbname, strlen(dbname)) ^
+		(hash_any((unsigned char *)relname, strlen(relname)) * 31);
+}
+
+/*
+ * Search shared relcache. If found, returns the query result which
+ * must be freed by free_select_result(). Otherwise returns NULL.
+ */
+static POOL_SELECT_RESULT *shared_relcache_search(POOL_RELCACHE *relcache, char *dbname, char *relname)
+{
+	volatile POOL_SHARED_RELCACHE_ENTRY *entry;
+	POOL_SELECT_RESULT *res = NULL;
+	char buf[SHARED_RELCACHE_DATA_LEN];
+	int len = -1;
+	uint32 hash;
+	time_t now;
+	int set;
+	int i;
+#ifdef HAVE_SIGPROCMASK
+	sigset_t oldmask;
+#else
+	int	oldmask;
+#endif
+
+	if (strlen(dbname) >= SHARED_RELCACHE_DBNAME_LEN ||
+		strlen(relname) >= SHARED_RELCACHE_RELNAME_LEN)
+		return NULL;
+
+	hash = shared_relcache_hash(relcache->sql_hash, dbname, relname);
+	set = (hash % (shared_relcache->num / SHARED_RELCACHE_WAYS)) * SHARED_RELCACHE_WAYS;
+	now = time(NULL);
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(RELCACHE_SEM);
+
+	for (i = 0; i < SHARED_RELCACHE_WAYS; i++)
+	{
+		entry = &shared_relcache->entries[set + i];
+
+		if (entry->generation != shared_relcache->generation ||
+			entry->hash != hash ||
+			entry->sql_hash != relcache->sql_hash ||
+			strcmp((char *)entry->dbname, dbname) ||
+			strcmp((char *)entry->relname, relname))
+			continue;
+
+		if (entry->expire > 0 && now > entry->expire)
+		{
+			entry->generation = 0;
+			break;
+		}
+
+		entry->last_used = ++shared_relcache->tick;
+		len = entry->datalen;
+		memcpy(buf, (char *)entry->data, len);
+		break;
+	}
+
+	pool_semaphore_unlock(RELCACHE_SEM);
+	POOL_SETMASK(&oldmask);
+
+	if (len >= 0)
+	{
+		res = deserialize_select_result(buf, len);
+		pool_debug("shared_relcache_search: found database:%s table:%s", dbname, relname);
+	}
+
+	return res;
+}
+
+/*
+ * Register query result to shared relcache. "generation" is the
+ * generation before the query was issued. If a DDL has been executed
+ * meanwhile, the entry is not registered.
+ */
+static void shared_relcache_register(POOL_RELCACHE *relcache, char *dbname, char *relname,
+									 POOL_SELECT_RESULT *res, int generation, time_t now)
+{
+	volatile POOL_SHARED_RELCACHE_ENTRY *entry;
+	char buf[SHARED_RELCACHE_DATA_LEN];
+	int len;
+	uint32 hash;
+	int set;
+	int victim;
+	int i;
+#ifdef HAVE_SIGPROCMASK
+	sigset_t oldmask;
+#else
+	int	oldmask;
+#endif
+
+	if (strlen(dbname) >= SHARED_RELCACHE_DBNAME_LEN ||
+		strlen(relname) >= SHARED_RELCACHE_RELNAME_LEN)
+		return;
+
+	len = serialize_select_result(res, buf, sizeof(buf));
+	if (len < 0)
+	{
+		pool_debug("shared_relcache_register: query result for table:%s is too large to share", relname);
+		return;
+	}
+
+	hash = shared_relcache_hash(relcache->sql_hash, dbname, relname);
+	set = (hash % (shared_relcache->num / SHARED_RELCACHE_WAYS)) * SHARED_RELCACHE_WAYS;
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(RELCACHE_SEM);
+
+	if (generation == shared_relcache->generation)
+	{
+		/*
+		 * Choose an unused or invalidated entry, or the least recently
+		 * used entry in the set.
+		 */
+		victim = set;
+		for (i = 0; i < SHARED_RELCACHE_WAYS; i++)
+		{
+			entry = &shared_relcache->entries[set + i];
+
+			if (entry->generation != shared_relcache->generation)
+			{
+				victim = set + i;
+				break;
+			}
+			if (entry->last_used < shared_relcache->entries[victim].last_used)
+				victim = set + i;
+		}
+
+		entry = &shared_relcache->entries[victim];
+		entry->hash = hash;
+		entry->sql_hash = relcache->sql_hash;
+		strlcpy((char *)entry->dbname, dbname, SHARED_RELCACHE_DBNAME_LEN);
+		strlcpy((char *)entry->relname, relname, SHARED_RELCACHE_RELNAME_LEN);
+		entry->generation = generation;
+		if (pool_config->relcache_expire > 0)
+			entry->expire = now + pool_config->relcache_expire;
+		else
+			entry->expire = 0;
+		entry->last_used = ++shared_relcache->tick;
+		entry->datalen = len;
+		memcpy((char *)entry->data, buf, len);
+	}
+
+	pool_semaphore_unlock(RELCACHE_SEM);
+	POOL_SETMASK(&oldmask);
+}
+
+/*
+ * Serialize query result into buf. Format is: number of rows, number
+ * of attributes followed by length (-1 for NULL) and data of each
+ * column. Returns length of serialized data, or -1 if it does not fit
+ * into buf.
+ */
+static int serialize_select_result(POOL_SELECT_RESULT *res, char *buf, int buflen)
+{
+	int num_attrs = res->rowdesc->num_attrs;
+	int pos = 0;
+	int len;
+	int i;
+
+	if (buflen < sizeof(int) * 2)
+		return -1;
+
+	memcpy(buf + pos, &res->numrows, sizeof(int));
+	pos += sizeof(int);
+	memcpy(buf + pos, &num_attrs, sizeof(int));
+	pos += sizeof(int);
+
+	for (i = 0; i < res->numrows * num_attrs; i++)
+	{
+		len = res->data[i] ? strlen(res->data[i]) : -1;
+
+		if (pos + sizeof(int) + (len > 0 ? len : 0) > buflen)
+			return -1;
+
+		memcpy(buf + pos, &len, sizeof(int));
+		pos += sizeof(int);
+		if (len > 0)
+		{
+			memcpy(buf + pos, res->data[i], len);
+			pos += len;
+		}
+	}
+	return pos;
+}
+
+/*
+ * Build a query result from serialized data. Returned result must be
+ * freed by free_select_result().
+ */
+static POOL_SELECT_RESULT *deserialize_select_result(char *buf, int len)
+{
+	POOL_SELECT_RESULT *res;
+	int num_attrs;
+	int numrows;
+	int collen;
+	int pos = 0;
+	int i;
+
+	memcpy(&numrows, buf + pos, sizeof(int));
+	pos += sizeof(int);
+	memcpy(&num_attrs, buf + pos, sizeof(int));
+	pos += sizeof(int);
+
+	res = calloc(1, sizeof(*res));
+	if (res == NULL)
+		goto error;
+	res->rowdesc = calloc(1, sizeof(RowDesc));
+	if (res->rowdesc == NULL)
+		goto error;
+	res->rowdesc->num_attrs = num_attrs;
+	res->rowdesc->attrinfo = calloc(num_attrs > 0 ? num_attrs : 1, sizeof(AttrInfo));
+	res->nullflags = calloc(numrows * num_attrs + 1, sizeof(int));
+	res->data = calloc(numrows * num_attrs + 1, sizeof(char *));
+	if (res->rowdesc->attrinfo == NULL || res->nullflags == NULL || res->data == NULL)
+		goto error;
+	res->numrows = numrows;
+
+	for (i = 0; i < numrows * num_attrs; i++)
+	{
+		memcpy(&collen, buf + pos, sizeof(int));
+		pos += sizeof(int);
+		res->nullflags[i] = collen;
+
+		if (collen < 0)
+			continue;
+
+		res->data[i] = malloc(collen + 1);
+		if (res->data[i] == NULL)
+			goto error;
+		memcpy(res->data[i], buf + pos, collen);
+		res->data[i][collen] = '\0';
+		pos += collen;
+	}
+	return res;
+
+error:
+	pool_error("deserialize_select_result: out of memory");
+	if (res)
+		free_select_result(res);
+	return NULL;
+}
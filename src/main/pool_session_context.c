@@ -27,11 +27,17 @@
 #include "pool.h"
 #include "pool_config.h"
 #include "pool_session_context.h"
+#include "pool_activity.h"
 
 static POOL_SESSION_CONTEXT session_context_d;
 static POOL_SESSION_CONTEXT *session_context = NULL;
 
 static void init_sent_message_list(void);
+static uint32 sent_message_hash(char kind, const char *name);
+static void sent_message_hash_insert(POOL_SENT_MESSAGE_LIST *msglist, POOL_SENT_MESSAGE *message);
+static void sent_message_hash_delete(POOL_SENT_MESSAGE_LIST *msglist, POOL_SENT_MESSAGE *message);
+static void sent_message_hash_grow(POOL_SENT_MESSAGE_LIST *msglist);
+static void remove_sent_message_at(POOL_SENT_MESSAGE_LIST *msglist, int i);
 
 /*
  * Initialize per session context
@@ -58,12 +64,12 @@ void pool_init_session_context(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *
 	/* Initialize local session id */
 	pool_incremnet_local_session_id();
 
-	/* Initialize sent message list */
-	init_sent_message_list();
-
 	/* Create memory context */
 	session_context->memory_context = pool_memory_create(PREPARE_BLOCK_SIZE);
 
+	/* Initialize sent message list */
+	init_sent_message_list();
+
 	/* Choose load balancing node if necessary */
 	if (pool_config->load_balance_mode)
 	{
@@ -102,6 +108,9 @@ void pool_init_session_context(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *
 	/* Backends have not ignored messages yet */
 	pool_unset_ignore_till_sync();
 
+	/* We are not forwarding pipelined messages */
+	pool_unset_pipelining_message();
+
 	/* Initialize where to send map for PREPARE statements */
 #ifdef NOT_USED
 	memset(&session_context->prep_where, 0, sizeof(session_context->prep_where));
@@ -112,6 +121,11 @@ void pool_init_session_context(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *
 	 */
 	session_context->mismatch_ntuples = false;
 
+	session_context->invalidate_shared_relcache = false;
+
+	session_context->transaction_timestamp_valid = false;
+	session_context->clock_synced_at = 0;
+
 	if (pool_config->memory_cache_enabled)
 	{
 		session_context->query_cache_array = pool_create_query_cache_array();
@@ -126,8 +140,15 @@ void pool_session_context_destroy(void)
 {
 	if (session_context)
 	{
+		pool_debug("pool_session_context_destroy: %d prepared statements and %d portals are alive. peak number of sent messages: %d",
+				   session_context->message_list.num_statements,
+				   session_context->message_list.num_portals,
+				   session_context->message_list.max_size);
+
 		pool_clear_sent_message_list();
 		free(session_context->message_list.sent_messages);
+		free(session_context->pending_messages.messages);
+		free(session_context->pending_messages.discarded);
 		pool_memory_delete(session_context->memory_context, 0);
 		if (pool_config->memory_cache_enabled)
 		{
@@ -360,6 +381,7 @@ void pool_unset_ignore_till_sync(void)
 bool pool_remove_sent_message(char kind, const char *name)
 {
 	int i;
+	POOL_SENT_MESSAGE *msg;
 	POOL_SENT_MESSAGE_LIST *msglist;
 
 	if (!session_context)
@@ -370,27 +392,20 @@ bool pool_remove_sent_message(char kind, const char *name)
 
 	msglist = &session_context->message_list;
 
-	for (i = 0; i < msglist->size; i++)
-	{
-		if (msglist->sent_messages[i]->kind == kind &&
-			!strcmp(msglist->sent_messages[i]->name, name))
-		{
-			pool_sent_message_destroy(msglist->sent_messages[i]);
-			break;
-		}
-	}
+	msg = pool_get_sent_message(kind, name);
 
 	/* sent message not found */
-	if (i == msglist->size)
+	if (!msg)
 		return false;
 
-	if (i != msglist->size - 1)
+	i = msg->index;
+	if (i < 0 || i >= msglist->size || msglist->sent_messages[i] != msg)
 	{
-		memmove(&msglist->sent_messages[i], &msglist->sent_messages[i+1],
-				sizeof(POOL_SENT_MESSAGE *) * (msglist->size - i - 1));
+		pool_error("pool_remove_sent_message: message \"%s\" is not in the sent message list", name);
+		return false;
 	}
 
-	msglist->size--;
+	remove_sent_message_at(msglist, i);
 
 	return true;
 }
@@ -415,8 +430,8 @@ void pool_remove_sent_messages(char kind)
 	{
 		if (msglist->sent_messages[i]->kind == kind)
 		{
-			if (pool_remove_sent_message(kind, msglist->sent_messages[i]->name))
-				i--;	/* for relocation by removing */
+			remove_sent_message_at(msglist, i);
+			i--;	/* the last message has been moved here */
 		}
 	}
 }
@@ -577,7 +592,21 @@ void pool_add_sent_message(POOL_SENT_MESSAGE *message)
 		}
 	}
 
+	message->index = msglist->size;
 	msglist->sent_messages[msglist->size++] = message;
+	sent_message_hash_insert(msglist, message);
+
+	if (message->query_context)
+		message->query_context->num_sent_messages++;
+
+	if (message->kind == 'B')
+		msglist->num_portals++;
+	else
+		msglist->num_statements++;
+	pool_activity_set_sent_messages(msglist->num_statements, msglist->num_portals);
+
+	if (msglist->size > msglist->max_size)
+		msglist->max_size = msglist->size;
 }
 
 /*
@@ -585,7 +614,7 @@ void pool_add_sent_message(POOL_SENT_MESSAGE *message)
  */
 POOL_SENT_MESSAGE *pool_get_sent_message(char kind, const char *name)
 {
-	int i;
+	POOL_SENT_MESSAGE *msg;
 	POOL_SENT_MESSAGE_LIST *msglist;
 
 	if (!session_context)
@@ -596,16 +625,304 @@ POOL_SENT_MESSAGE *pool_get_sent_message(char kind, const char *name)
 
 	msglist = &session_context->message_list;
 
-	for (i = 0; i < msglist->size; i++)
+	msg = msglist->buckets[sent_message_hash(kind, name) & (msglist->nbuckets - 1)];
+
+	for (; msg; msg = msg->hash_next)
 	{
-		if (msglist->sent_messages[i]->kind == kind &&
-			!strcmp(msglist->sent_messages[i]->name, name))
-			return msglist->sent_messages[i];
+		if (msg->kind == kind && !strcmp(msg->name, name))
+			return msg;
 	}
 
 	return NULL;
 }
 
+/*
+ * Return true if extended query message is forwarded without waiting
+ * for response
+ */
+bool pool_is_pipelining_message(void)
+{
+	if (!session_context)
+	{
+		pool_error("pool_is_pipelining_message: session context is not initialized");
+		return false;
+	}
+
+	return session_context->pipelining_message;
+}
+
+/*
+ * Set pipelining_message
+ */
+void pool_set_pipelining_message(void)
+{
+	if (!session_context)
+	{
+		pool_error("pool_set_pipelining_message: session context is not initialized");
+		return;
+	}
+
+	session_context->pipelining_message = true;
+}
+
+/*
+ * Unset pipelining_message
+ */
+void pool_unset_pipelining_message(void)
+{
+	if (!session_context)
+	{
+		pool_error("pool_unset_pipelining_message: session context is not initialized");
+		return;
+	}
+
+	session_context->pipelining_message = false;
+}
+
+/*
+ * Add a message forwarded without waiting for response to the tail of
+ * pending message queue.
+ */
+bool pool_pipeline_add(char kind, POOL_SENT_MESSAGE *message, POOL_QUERY_CONTEXT *query_context)
+{
+	POOL_PENDING_MESSAGE_QUEUE *queue;
+	POOL_PENDING_MESSAGE *p;
+
+	if (!session_context)
+	{
+		pool_error("pool_pipeline_add: session context is not initialized");
+		return false;
+	}
+
+	queue = &session_context->pending_messages;
+
+	if (queue->tail == queue->capacity)
+	{
+		int capacity = queue->capacity > 0 ? queue->capacity * 2 : INIT_LIST_SIZE;
+
+		p = realloc(queue->messages, sizeof(POOL_PENDING_MESSAGE) * capacity);
+		if (!p)
+		{
+			pool_error("pool_pipeline_add: realloc failed: %s", strerror(errno));
+			return false;
+		}
+		queue->messages = p;
+		queue->capacity = capacity;
+	}
+
+	p = &queue->messages[queue->tail++];
+	p->kind = kind;
+	p->message = message;
+	p->query_context = query_context;
+
+	return true;
+}
+
+/*
+ * Return true if some pipelined messages have not received responses
+ */
+bool pool_pipeline_pending(void)
+{
+	if (!session_context)
+		return false;
+
+	return session_context->pending_messages.head < session_context->pending_messages.tail;
+}
+
+/*
+ * Return number of pipelined messages waiting for responses
+ */
+int pool_pipeline_length(void)
+{
+	if (!session_context)
+		return 0;
+
+	return session_context->pending_messages.tail - session_context->pending_messages.head;
+}
+
+/*
+ * Return the oldest pipelined message. NULL if none.
+ */
+POOL_PENDING_MESSAGE *pool_pipeline_head(void)
+{
+	if (!pool_pipeline_pending())
+		return NULL;
+
+	return &session_context->pending_messages.messages[session_context->pending_messages.head];
+}
+
+/*
+ * Return the newest pipelined message. NULL if none.
+ */
+POOL_PENDING_MESSAGE *pool_pipeline_tail(void)
+{
+	if (!pool_pipeline_pending())
+		return NULL;
+
+	return &session_context->pending_messages.messages[session_context->pending_messages.tail - 1];
+}
+
+/*
+ * Remove the oldest pipelined message, which has received its
+ * response.
+ */
+void pool_pipeline_pop(void)
+{
+	POOL_PENDING_MESSAGE_QUEUE *queue;
+
+	if (!pool_pipeline_pending())
+		return;
+
+	queue = &session_context->pending_messages;
+	queue->head++;
+	if (queue->head == queue->tail)
+		queue->head = queue->tail = 0;
+}
+
+/*
+ * Discard pipelined messages which backends ignored because of an
+ * error response. Messages after Sync are kept since backends process
+ * them. Returns true if Sync has been forwarded, i.e. backends will
+ * send ReadyForQuery without further Sync from frontend.
+ */
+bool pool_pipeline_discard(void)
+{
+	POOL_PENDING_MESSAGE_QUEUE *queue;
+	POOL_PENDING_MESSAGE *p;
+	POOL_QUERY_CONTEXT *qc;
+	int i;
+
+	if (!pool_pipeline_pending())
+		return false;
+
+	queue = &session_context->pending_messages;
+
+	while (queue->head < queue->tail && queue->messages[queue->head].kind != 'S')
+	{
+		p = &queue->messages[queue->head++];
+
+		if (!p->message)
+			continue;
+
+		/*
+		 * Parse and Bind messages have not been added to the sent
+		 * message list. Destroy them here, but leave the query context
+		 * to pool_pipeline_reset() since it may be shared with other
+		 * messages or be the current query context.
+		 */
+		qc = p->message->query_context;
+		p->message->query_context = NULL;
+		pool_sent_message_destroy(p->message);
+		p->message = NULL;
+
+		if (!qc)
+			continue;
+
+		for (i = 0; i < queue->num_discarded; i++)
+		{
+			if (queue->discarded[i] == qc)
+				break;
+		}
+		if (i < queue->num_discarded)
+			continue;
+
+		if (queue->num_discarded == queue->discarded_capacity)
+		{
+			int capacity = queue->discarded_capacity > 0 ? queue->discarded_capacity * 2 : INIT_LIST_SIZE;
+			POOL_QUERY_CONTEXT **d;
+
+			d = realloc(queue->discarded, sizeof(POOL_QUERY_CONTEXT *) * capacity);
+			if (!d)
+			{
+				pool_error("pool_pipeline_discard: realloc failed: %s", strerror(errno));
+				continue;
+			}
+			queue->discarded = d;
+			queue->discarded_capacity = capacity;
+		}
+		queue->discarded[queue->num_discarded++] = qc;
+	}
+
+	if (queue->head == queue->tail)
+	{
+		queue->head = queue->tail = 0;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Forget all pipelined messages and destroy query contexts of
+ * discarded messages which are not used by sent messages. This is
+ * called when ReadyForQuery is received.
+ */
+void pool_pipeline_reset(void)
+{
+	POOL_PENDING_MESSAGE_QUEUE *queue;
+	POOL_QUERY_CONTEXT *current;
+	POOL_QUERY_CONTEXT *qc;
+	bool in_progress;
+	int i;
+
+	if (!session_context)
+		return;
+
+	queue = &session_context->pending_messages;
+	queue->head = queue->tail = 0;
+
+	for (i = 0; i < queue->num_discarded; i++)
+	{
+		qc = queue->discarded[i];
+
+		/* still used by a sent message */
+		if (qc->num_sent_messages > 0)
+			continue;
+
+		/*
+		 * pool_query_context_destroy() unsets in_progress flag and
+		 * the current query context. Restore them unless the current
+		 * one is destroyed.
+		 */
+		current = session_context->query_context;
+		in_progress = pool_is_query_in_progress();
+		pool_query_context_destroy(qc);
+		if (current != qc)
+			session_context->query_context = current;
+		if (in_progress)
+			pool_set_query_in_progress();
+	}
+	queue->num_discarded = 0;
+}
+
+/*
+ * Get a sent message like pool_get_sent_message(). Parse and Bind
+ * messages waiting for responses are searched first since they
+ * replace sent messages of the same name when they complete.
+ */
+POOL_SENT_MESSAGE *pool_pipeline_get_sent_message(char kind, const char *name)
+{
+	POOL_PENDING_MESSAGE_QUEUE *queue;
+	POOL_PENDING_MESSAGE *p;
+	int i;
+
+	if (!session_context)
+	{
+		pool_error("pool_pipeline_get_sent_message: session context is not initialized");
+		return NULL;
+	}
+
+	queue = &session_context->pending_messages;
+
+	for (i = queue->tail - 1; i >= queue->head; i--)
+	{
+		p = &queue->messages[i];
+		if (p->message && p->message->kind == kind && !strcmp(p->message->name, name))
+			return p->message;
+	}
+
+	return pool_get_sent_message(kind, name);
+}
+
 /*
  * We don't have a write query in this transaction yet.
  */
@@ -918,33 +1235,141 @@ static void init_sent_message_list(void)
 		pool_error("init_sent_message_list: malloc failed: %s", strerror(errno));
 		exit(1);
 	}
+
+	msglist->nbuckets = INIT_LIST_SIZE;
+	msglist->buckets = pool_memory_alloc_zero(session_context->memory_context,
+											  sizeof(POOL_SENT_MESSAGE *) * msglist->nbuckets);
+
+	msglist->num_statements = 0;
+	msglist->num_portals = 0;
+	msglist->max_size = 0;
 }
 
 /*
- * Look for extended message list to check if given query context qc
- * is used. Returns true if it is not used.
+ * Remove i th element of sent message list and destroy it. The last
+ * element is moved to the i th position.
  */
-bool can_query_context_destroy(POOL_QUERY_CONTEXT *qc)
+static void remove_sent_message_at(POOL_SENT_MESSAGE_LIST *msglist, int i)
+{
+	POOL_SENT_MESSAGE *msg = msglist->sent_messages[i];
+	POOL_QUERY_CONTEXT *qc = msg->query_context;
+	bool qc_survives;
+
+	if (msg->kind == 'B')
+		msglist->num_portals--;
+	else
+		msglist->num_statements--;
+	pool_activity_set_sent_messages(msglist->num_statements, msglist->num_portals);
+
+	sent_message_hash_delete(msglist, msg);
+
+	/*
+	 * The message must be still counted in the query context while
+	 * destroying it.  See can_query_context_destroy().  If the query
+	 * context is not destroyed, uncount the message afterwards.
+	 */
+	qc_survives = qc && !can_query_context_destroy(qc);
+	pool_sent_message_destroy(msg);
+	if (qc_survives)
+		qc->num_sent_messages--;
+
+	if (i != msglist->size - 1)
+	{
+		msglist->sent_messages[i] = msglist->sent_messages[msglist->size - 1];
+		msglist->sent_messages[i]->index = i;
+	}
+
+	msglist->size--;
+}
+
+/*
+ * Calculate hash value of sent message
+ */
+static uint32 sent_message_hash(char kind, const char *name)
+{
+	return hash_any((unsigned char *)name, strlen(name)) ^ ((uint32)(unsigned char)kind * 0x9e3779b9);
+}
+
+/*
+ * Register a sent message to the hash table. If the number of
+ * messages exceeds the number of buckets, the hash table is enlarged.
+ */
+static void sent_message_hash_insert(POOL_SENT_MESSAGE_LIST *msglist, POOL_SENT_MESSAGE *message)
+{
+	uint32 h;
+
+	if (msglist->size > msglist->nbuckets)
+		sent_message_hash_grow(msglist);
+
+	h = sent_message_hash(message->kind, message->name) & (msglist->nbuckets - 1);
+	message->hash_next = msglist->buckets[h];
+	msglist->buckets[h] = message;
+}
+
+/*
+ * Unregister a sent message from the hash table
+ */
+static void sent_message_hash_delete(POOL_SENT_MESSAGE_LIST *msglist, POOL_SENT_MESSAGE *message)
+{
+	POOL_SENT_MESSAGE **p;
+
+	p = &msglist->buckets[sent_message_hash(message->kind, message->name) & (msglist->nbuckets - 1)];
+
+	for (; *p; p = &(*p)->hash_next)
+	{
+		if (*p == message)
+		{
+			*p = message->hash_next;
+			message->hash_next = NULL;
+			return;
+		}
+	}
+}
+
+/*
+ * Double the number of hash buckets and relocate all messages
+ */
+static void sent_message_hash_grow(POOL_SENT_MESSAGE_LIST *msglist)
 {
+	POOL_SENT_MESSAGE **old_buckets = msglist->buckets;
+	int old_nbuckets = msglist->nbuckets;
 	int i;
-	int count = 0;
-	POOL_SENT_MESSAGE_LIST *msglist;
 
-	msglist = &session_context->message_list;
+	msglist->nbuckets *= 2;
+	msglist->buckets = pool_memory_alloc_zero(session_context->memory_context,
+											  sizeof(POOL_SENT_MESSAGE *) * msglist->nbuckets);
 
-	for (i = 0; i < msglist->size; i++)
+	for (i = 0; i < old_nbuckets; i++)
 	{
-		if (msglist->sent_messages[i]->query_context == qc)
+		POOL_SENT_MESSAGE *msg = old_buckets[i];
+
+		while (msg)
 		{
-			pool_debug("can_query_context_destroy: query context %p is still used. query:%s",
-					   qc, qc->original_query);
-			count++;
+			POOL_SENT_MESSAGE *next = msg->hash_next;
+			uint32 h = sent_message_hash(msg->kind, msg->name) & (msglist->nbuckets - 1);
+
+			msg->hash_next = msglist->buckets[h];
+			msglist->buckets[h] = msg;
+			msg = next;
 		}
 	}
-	if (count > 1)
+
+	pool_memory_free(session_context->memory_context, old_buckets);
+
+	pool_debug("sent_message_hash_grow: number of hash buckets: %d", msglist->nbuckets);
+}
+
+/*
+ * Check if given query context qc is used by extended message list.
+ * Returns true if it is not used, or used by only one message (which
+ * is being destroyed).
+ */
+bool can_query_context_destroy(POOL_QUERY_CONTEXT *qc)
+{
+	if (qc && qc->num_sent_messages > 1)
 	{
-		pool_debug("can_query_context_destroy: query context %p is still used for %d times.",
-				   qc, count);
+		pool_debug("can_query_context_destroy: query context %p is still used for %d times. query:%s",
+				   qc, qc->num_sent_messages, qc->original_query);
 		return false;
 	}
 
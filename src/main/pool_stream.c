@@ -41,6 +41,7 @@
 #include "pool.h"
 #include "pool_stream.h"
 #include "pool_config.h"
+#include "pool_node_stats.h"
 
 static int mystrlen(char *str, int upper, int *flag);
 static int mystrlinelen(char *str, int upper, int *flag);
@@ -155,6 +156,7 @@ int pool_read(POOL_CONNECTION *cp, void *buf, int len)
 		} else {
 		  readlen = read(cp->fd, readbuf, READBUFSZ);
 		}
+		pool_node_stats_count_bytes_in(cp, readlen);
 
 		if (readlen == -1)
 		{
@@ -278,6 +280,7 @@ char *pool_read2(POOL_CONNECTION *cp, int len)
 		} else {
 		  readlen = read(cp->fd, buf, len);
 		}
+		pool_node_stats_count_bytes_in(cp, readlen);
 
 		if (readlen == -1)
 		{
@@ -337,6 +340,139 @@ char *pool_read2(POOL_CONNECTION *cp, int len)
 	return cp->buf2;
 }
 
+/*
+* read at most len bytes from cp. Pending data in the read buffer is
+* returned first. Otherwise wait for data arrival and read whatever
+* has arrived. This is used to read a bulk data stream from frontend.
+* returns number of bytes read on success otherwise -1.
+*/
+int pool_read_some(POOL_CONNECTION *cp, void *buf, int len)
+{
+	int readlen;
+
+	if (len <= 0)
+		return 0;
+
+	if (cp->len > 0)
+		return consume_pending_data(cp, buf, len);
+
+	for (;;)
+	{
+		if (pool_check_fd(cp))
+		{
+			pool_error("pool_read_some: pool_check_fd failed (%s)", strerror(errno));
+			return -1;
+		}
+
+		if (cp->ssl_active > 0) {
+		  readlen = pool_ssl_read(cp, buf, len);
+		} else {
+		  readlen = read(cp->fd, buf, len);
+		}
+		pool_node_stats_count_bytes_in(cp, readlen);
+
+		if (readlen == -1)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+			{
+				pool_debug("pool_read_some: retrying due to %s", strerror(errno));
+				continue;
+			}
+
+			pool_error("pool_read_some: read failed (%s)", strerror(errno));
+			return -1;
+		}
+		else if (readlen == 0)
+		{
+			pool_error("pool_read_some: EOF encountered");
+			return -1;
+		}
+
+		return readlen;
+	}
+}
+
+/*
+* wait until each of connections has at least len bytes in the read
+* buffer. Data is read from all the connections as it arrives so that
+* a slow connection does not delay reading others. Connections using
+* SSL, or on which an error or timeout occurs, are left to subsequent
+* pool_read() calls, which handle them as before.
+* returns 0 on success otherwise -1.
+*/
+int pool_fill_read_buffers(POOL_CONNECTION **cps, int ncps, int len)
+{
+	char readbuf[READBUFSZ];
+	bool skip[MAX_NUM_BACKENDS];
+	fd_set readmask;
+	struct timeval timeout;
+	int timeoutsec;
+	int maxfd;
+	int readlen;
+	int sts;
+	int i;
+
+	for (i=0;i<ncps;i++)
+		skip[i] = cps[i]->ssl_active > 0;
+
+	timeoutsec = pool_get_timeout();
+
+	for (;;)
+	{
+		FD_ZERO(&readmask);
+		maxfd = -1;
+
+		for (i=0;i<ncps;i++)
+		{
+			if (skip[i] || cps[i]->len >= len)
+				continue;
+
+			FD_SET(cps[i]->fd, &readmask);
+			if (cps[i]->fd > maxfd)
+				maxfd = cps[i]->fd;
+		}
+
+		if (maxfd < 0)
+			return 0;
+
+		timeout.tv_sec = timeoutsec;
+		timeout.tv_usec = 0;
+
+		sts = select(maxfd+1, &readmask, NULL, NULL, timeoutsec > 0 ? &timeout : NULL);
+		if (sts == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			pool_error("pool_fill_read_buffers: select() failed. reason: %s", strerror(errno));
+			return -1;
+		}
+		else if (sts == 0)
+		{
+			/* timeout. pool_read() will find it out */
+			return 0;
+		}
+
+		for (i=0;i<ncps;i++)
+		{
+			if (skip[i] || cps[i]->len >= len || !FD_ISSET(cps[i]->fd, &readmask))
+				continue;
+
+			readlen = read(cps[i]->fd, readbuf, sizeof(readbuf));
+			if (readlen > 0)
+			{
+				pool_node_stats_count_bytes_in(cps[i], readlen);
+				if (save_pending_data(cps[i], readbuf, readlen))
+					return -1;
+			}
+			else if (readlen == -1 && (errno == EINTR || errno == EAGAIN))
+				continue;
+			else
+				skip[i] = true;
+		}
+	}
+}
+
 /*
 * write len bytes to cp the write buffer.
 * returns 0 on success otherwise -1.
@@ -441,6 +577,7 @@ int pool_flush_it(POOL_CONNECTION *cp)
 		} else {
 		  sts = write(cp->fd, cp->wbuf + offset, wlen);
 		}
+		pool_node_stats_count_bytes_out(cp, sts);
 
 		if (sts > 0)
 		{
@@ -541,6 +678,133 @@ int pool_write_and_flush(POOL_CONNECTION *cp, void *buf, int len)
 	return pool_flush(cp);
 }
 
+/*
+ * write the same len bytes to all of connections bypassing the write
+ * buffer. Sockets are written in non-blocking mode as they become
+ * writable so that a slow connection does not hold back others.
+ * Connections using SSL are written one by one. If writing to a
+ * connection fails, the data is still written to the other
+ * connections so that they do not receive a partial message, then
+ * failover of the failed node is triggered as pool_flush() does.
+ * returns 0 on success otherwise -1.
+ */
+int pool_write_concurrently(POOL_CONNECTION **cps, int ncps, char *buf, int len)
+{
+	int offset[MAX_NUM_BACKENDS];
+	bool failed[MAX_NUM_BACKENDS];
+	int num_failed = 0;
+	fd_set writemask;
+	int maxfd;
+	int remaining;
+	int sts;
+	int i;
+
+	remaining = 0;
+
+	for (i=0;i<ncps;i++)
+	{
+		/* data in the write buffer must go first */
+		if (pool_flush(cps[i]))
+			return -1;
+
+		failed[i] = false;
+
+		if (cps[i]->ssl_active > 0)
+		{
+			if (pool_write_and_flush(cps[i], buf, len))
+				return -1;
+			offset[i] = len;
+			continue;
+		}
+
+		offset[i] = 0;
+		remaining++;
+		pool_set_nonblock(cps[i]->fd);
+	}
+
+	while (remaining > 0)
+	{
+		FD_ZERO(&writemask);
+		maxfd = 0;
+
+		for (i=0;i<ncps;i++)
+		{
+			if (offset[i] >= len || failed[i])
+				continue;
+
+			FD_SET(cps[i]->fd, &writemask);
+			if (cps[i]->fd > maxfd)
+				maxfd = cps[i]->fd;
+		}
+
+		sts = select(maxfd+1, NULL, &writemask, NULL, NULL);
+		if (sts == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			pool_error("pool_write_concurrently: select() failed. reason: %s", strerror(errno));
+			break;
+		}
+
+		for (i=0;i<ncps;i++)
+		{
+			if (offset[i] >= len || failed[i] || !FD_ISSET(cps[i]->fd, &writemask))
+				continue;
+
+			sts = write(cps[i]->fd, buf + offset[i], len - offset[i]);
+			if (sts > 0)
+			{
+				pool_node_stats_count_bytes_out(cps[i], sts);
+				offset[i] += sts;
+				if (offset[i] >= len)
+				{
+					pool_unset_nonblock(cps[i]->fd);
+					remaining--;
+				}
+			}
+			else if (sts == -1 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			else
+			{
+				pool_error("pool_write_concurrently: write failed to backend (%d). reason: %s offset: %d len: %d",
+						   cps[i]->db_node_id, strerror(errno), offset[i], len);
+
+				/* Go on writing to the other connections */
+				pool_unset_nonblock(cps[i]->fd);
+				failed[i] = true;
+				num_failed++;
+				remaining--;
+			}
+		}
+	}
+
+	if (remaining == 0 && num_failed == 0)
+		return 0;
+
+	for (i=0;i<ncps;i++)
+	{
+		if (offset[i] < len && !failed[i])
+			pool_unset_nonblock(cps[i]->fd);
+	}
+
+	if (num_failed > 0)
+	{
+		/* if fail_over_on_backend_error is true, then trigger failover */
+		if (pool_config->fail_over_on_backend_error)
+		{
+			for (i=0;i<ncps;i++)
+			{
+				if (failed[i] && cps[i]->isbackend)
+					notice_backend_error(cps[i]->db_node_id);
+			}
+			child_exit(1);
+		}
+		pool_log("pool_write_concurrently: do not failover because fail_over_on_backend_error is off");
+	}
+	return -1;
+}
+
 /*
  * read a string until EOF or NULL is encountered.
  * if line is not 0, read until new line is encountered.
@@ -641,6 +905,7 @@ char *pool_read_string(POOL_CONNECTION *cp, int *len, int line)
 		} else {
 		  readlen = read(cp->fd, cp->sbuf+readp, readsize);
 		}
+		pool_node_stats_count_bytes_in(cp, readlen);
 
 		if (readlen == -1)
 		{
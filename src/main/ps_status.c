@@ -39,11 +39,12 @@
 #endif
 
 #include "pool.h"
+#include "pool_config.h"
+#include "pool_activity.h"
 #include <stdlib.h>
 #include <string.h>
 
 extern char **environ;
-bool		update_process_title = true;
 
 
 /*
@@ -286,7 +287,7 @@ void
 set_ps_display(const char *activity, bool force)
 {
 
-	if (!force && !update_process_title)
+	if (!force && pool_config && !pool_config->update_process_title)
 		return;
 
 #ifndef PS_USE_NONE
@@ -386,13 +387,20 @@ get_ps_display(int *displen)
 }
 
 /*
- * Show ps idle status
+ * Show ps idle status. This is not rate limited unlike the query shown
+ * by query_ps_status(), so the title never keeps a finished query while
+ * the child waits for the next one.
  */
 void pool_ps_idle_display(POOL_CONNECTION_POOL *backend)
 {
 	StartupPacket *sp;
 	char psbuf[1024];
 
+	pool_activity_idle(MASTER(backend)->tstate == 'T');
+
+	if (!pool_config->update_process_title)
+		return;
+
 	sp = MASTER_CONNECTION(backend)->sp;
 	if (MASTER(backend)->tstate == 'T')
 		snprintf(psbuf, sizeof(psbuf), "%s %s %s idle in transaction",
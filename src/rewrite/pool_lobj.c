@@ -5,7 +5,7 @@
  * pgpool: a language independent connection pool server for PostgreSQL
  * written by Tatsuo Ishii
  *
- * Copyright (c) 2003-2010	PgPool Global Development Group
+ * Copyright (c) 2003-2013	PgPool Global Development Group
  *
  * Permission to use, copy, modify, and distribute this software and
  * its documentation for any purpose and without fee is hereby
@@ -26,22 +26,51 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #include <netinet/in.h>
 
 #include "pool.h"
 #include "pool_lobj.h"
 #include "pool_relcache.h"
 #include "pool_config.h"
+#include "parser/pool_parser.h"
+
+/* OIDs below this are reserved by PostgreSQL (from access/transam.h) */
+#define FirstNormalObjectId	16384
+
+static POOL_LOBJ_OID_ALLOCATOR *lobj_oid_allocator;
+
+static POOL_LOBJ_OID_RANGE *lobj_oid_range(char *database);
+static unsigned int lobj_allocate_oid(POOL_CONNECTION_POOL *backend);
+
+/*
+ * Create large object OID allocator. This must be called by pgpool
+ * main process before forking children.
+ */
+int pool_init_lobj_oid_allocator(void)
+{
+	lobj_oid_allocator = pool_shared_memory_create(sizeof(POOL_LOBJ_OID_ALLOCATOR));
+	if (lobj_oid_allocator == NULL)
+	{
+		pool_error("pool_init_lobj_oid_allocator: failed to allocate shared memory");
+		return -1;
+	}
+	memset((void *)lobj_oid_allocator, 0, sizeof(POOL_LOBJ_OID_ALLOCATOR));
+	return 0;
+}
 
 /*
  * Rewrite lo_creat call to lo_create call if:
  * 1) it's a lo_creat function call
  * 2) PostgreSQL has lo_create
  * 3) In replication mode
- * 4) lobj_lock_table exists and writable to everyone
+ * 4) lobj_oid_block_size is greater than 0, or lobj_lock_table exists
+ *    and writable to everyone
  *
- * The argument for lo_create is created by fetching max(loid)+1 from
- * pg_largeobject. To avoid race condition, we lock lobj_lock_table.
+ * The argument for lo_create is taken from the range of OIDs reserved
+ * by lobj_allocate_oid(). If the allocator is disabled or fails, it is
+ * created by fetching max(loid)+1 from pg_largeobject. To avoid race
+ * condition, we lock lobj_lock_table in this case.
  *
  * Caller should call this only if protocol is V3 or higher(for
  * now. There's no reason for this function not working with V2
@@ -74,7 +103,7 @@ char *pool_rewrite_lo_creat(char kind, char *packet, int packet_len,
 	char qbuf[1024];
 	char *p;
 	POOL_SELECT_RESULT *result;
-	int lobjid;
+	unsigned int lobjid;
 	int32 int32val;
 	int16 int16val;
 	int16 result_format_code;
@@ -82,8 +111,9 @@ char *pool_rewrite_lo_creat(char kind, char *packet, int packet_len,
 	if (kind != 'F')
 		return NULL;	/* not function call */
 
-	if (!strcmp(pool_config->lobj_lock_table,""))
-		return NULL;	/* no lock table */
+	if (!strcmp(pool_config->lobj_lock_table,"") &&
+		pool_config->lobj_oid_block_size <= 0)
+		return NULL;	/* no lock table nor OID allocator */
 
 	if (!REPLICATION)
 		return NULL;	/* not in replication mode */
@@ -158,50 +188,58 @@ char *pool_rewrite_lo_creat(char kind, char *packet, int packet_len,
 	/*
 	 * Ok, do it...
 	 */
-	/* issue lock table command to lob_lock_table */
-	snprintf(qbuf, sizeof(qbuf), "LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE", pool_config->lobj_lock_table);
-	per_node_statement_log(backend, MASTER_NODE_ID, qbuf);
-	status = do_command(frontend, MASTER(backend), qbuf, MAJOR(backend), MASTER_CONNECTION(backend)->pid,
-						MASTER_CONNECTION(backend)->key, 0);
-	if (status == POOL_END)
-	{
-		pool_error("pool_rewrite_lo_creat: failed to execute LOCK");
-		return NULL;
-	}
+	lobjid = lobj_allocate_oid(backend);
 
-	/*
-	 * If transaction state is E, do_command failed to execute command
-	 */
-	if (TSTATE(backend, MASTER_NODE_ID) == 'E')
+	if (lobjid == 0)
 	{
-		pool_log("pool_check_lo_creat: failed to execute: %s", qbuf);
-		return NULL;
-	}
+		if (!strcmp(pool_config->lobj_lock_table,""))
+			return NULL;	/* no lock table */
+
+		/* issue lock table command to lob_lock_table */
+		snprintf(qbuf, sizeof(qbuf), "LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE", pool_config->lobj_lock_table);
+		per_node_statement_log(backend, MASTER_NODE_ID, qbuf);
+		status = do_command(frontend, MASTER(backend), qbuf, MAJOR(backend), MASTER_CONNECTION(backend)->pid,
+							MASTER_CONNECTION(backend)->key, 0);
+		if (status == POOL_END)
+		{
+			pool_error("pool_rewrite_lo_creat: failed to execute LOCK");
+			return NULL;
+		}
 
-	/* get max lobj id */
-	per_node_statement_log(backend, MASTER_NODE_ID, GET_MAX_LOBJ_KEY);
-	status = do_query(MASTER(backend), GET_MAX_LOBJ_KEY, &result, MAJOR(backend));
-	if (status == POOL_END)
-	{
-		pool_error("pool_rewrite_lo_creat: do_query failed");
-		return NULL;
-	}
+		/*
+		 * If transaction state is E, do_command failed to execute command
+		 */
+		if (TSTATE(backend, MASTER_NODE_ID) == 'E')
+		{
+			pool_log("pool_check_lo_creat: failed to execute: %s", qbuf);
+			return NULL;
+		}
 
-	if (!result)
-	{
-		pool_log("pool_check_lo_creat: failed to execute: %s", GET_MAX_LOBJ_KEY);
-		return NULL;
-	}
+		/* get max lobj id */
+		per_node_statement_log(backend, MASTER_NODE_ID, GET_MAX_LOBJ_KEY);
+		status = do_query(MASTER(backend), GET_MAX_LOBJ_KEY, &result, MAJOR(backend));
+		if (status == POOL_END)
+		{
+			pool_error("pool_rewrite_lo_creat: do_query failed");
+			return NULL;
+		}
+
+		if (!result)
+		{
+			pool_log("pool_check_lo_creat: failed to execute: %s", GET_MAX_LOBJ_KEY);
+			return NULL;
+		}
 		
-	lobjid = atoi(result->data[0]);
-	pool_debug("lobjid:%d", lobjid);
-	free_select_result(result);
+		lobjid = strtoul(result->data[0], NULL, 10);
+		pool_debug("lobjid:%u", lobjid);
+		free_select_result(result);
 
-	/* sanity check */
-	if (lobjid <= 0)
-	{
-		pool_error("pool_rewrite_lo_creat: wrong lob id: %d", lobjid);
-		return NULL;
+		/* sanity check */
+		if (lobjid == 0)
+		{
+			pool_error("pool_rewrite_lo_creat: wrong lob id: %u", lobjid);
+			return NULL;
+		}
 	}
 
 	/*
@@ -240,3 +278,145 @@ char *pool_rewrite_lo_creat(char kind, char *packet, int packet_len,
 
 	return rewritten_packet;
 }
+
+/*
+ * Search the OID range of the database. If not found, the least
+ * recently used slot is assigned to the database. The end of the
+ * evicted range is remembered so that no later range starts below
+ * it: OIDs handed out from that range may belong to transactions not
+ * committed yet, which max(oid) on the master does not see. Caller
+ * must hold LOBJ_OID_SEM.
+ */
+static POOL_LOBJ_OID_RANGE *lobj_oid_range(char *database)
+{
+	POOL_LOBJ_OID_RANGE *range;
+	POOL_LOBJ_OID_RANGE *victim = NULL;
+	int i;
+
+	for (i=0;i<LOBJ_OID_RANGE_SLOTS;i++)
+	{
+		range = &lobj_oid_allocator->ranges[i];
+
+		if (!strcmp(range->database, database))
+		{
+			range->last_used = ++lobj_oid_allocator->clock;
+			return range;
+		}
+
+		if (victim == NULL || range->last_used < victim->last_used)
+			victim = range;
+	}
+
+	if (victim->last_oid > lobj_oid_allocator->evicted_oid)
+		lobj_oid_allocator->evicted_oid = victim->last_oid;
+
+	memset(victim, 0, sizeof(*victim));
+	strncpy(victim->database, database, sizeof(victim->database) - 1);
+	/* empty range */
+	victim->next_oid = 1;
+	victim->last_oid = 0;
+	victim->last_used = ++lobj_oid_allocator->clock;
+	return victim;
+}
+
+/*
+ * Hand out a large object OID for the current database from the range
+ * reserved on shared memory. If the range is used up, reserve next
+ * lobj_oid_block_size OIDs beyond the largest large object OID on the
+ * master node. Returns 0 if the allocator is disabled or failed.
+ */
+static unsigned int lobj_allocate_oid(POOL_CONNECTION_POOL *backend)
+{
+#define GET_MAX_LOBJ_OID "SELECT coalesce(max(oid), 0) FROM pg_catalog.pg_largeobject_metadata"
+#define GET_MAX_LOBJ_OID_PRE90 "SELECT coalesce(max(loid), 0) FROM pg_catalog.pg_largeobject"
+
+#ifdef HAVE_SIGPROCMASK
+	sigset_t oldmask;
+#else
+	int	oldmask;
+#endif
+	char *database;
+	char *query;
+	POOL_LOBJ_OID_RANGE *range;
+	POOL_SELECT_RESULT *result;
+	POOL_STATUS status;
+	unsigned int oid = 0;
+	unsigned int max_oid;
+	unsigned int high;
+
+	if (lobj_oid_allocator == NULL)
+		return 0;
+
+	database = MASTER_CONNECTION(backend)->sp->database;
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(LOBJ_OID_SEM);
+	range = lobj_oid_range(database);
+	if (range->next_oid <= range->last_oid)
+		oid = range->next_oid++;
+	pool_semaphore_unlock(LOBJ_OID_SEM);
+	POOL_SETMASK(&oldmask);
+
+	if (oid != 0)
+	{
+		pool_debug("lobj_allocate_oid: database: %s oid: %u", database, oid);
+		return oid;
+	}
+
+	/*
+	 * The range is used up. Ask the master for the largest large
+	 * object OID in use so that the next range does not collide with
+	 * existing large objects. Both queries are answered using the
+	 * index.
+	 */
+	if (TSTATE(backend, MASTER_NODE_ID) == 'E')
+		return 0;
+
+	query = server_version_num >= 90000 ? GET_MAX_LOBJ_OID : GET_MAX_LOBJ_OID_PRE90;
+	per_node_statement_log(backend, MASTER_NODE_ID, query);
+	status = do_query(MASTER(backend), query, &result, MAJOR(backend));
+	if (status == POOL_END || !result)
+	{
+		pool_log("lobj_allocate_oid: failed to execute: %s", query);
+		return 0;
+	}
+	max_oid = strtoul(result->data[0], NULL, 10);
+	free_select_result(result);
+
+	POOL_SETMASK2(&BlockSig, &oldmask);
+	pool_semaphore_lock(LOBJ_OID_SEM);
+	range = lobj_oid_range(database);
+
+	/* Other child might have reserved a new range meanwhile */
+	if (range->next_oid > range->last_oid)
+	{
+		/*
+		 * Never go back below the previous range of this database nor
+		 * below any evicted range, since the database might have used
+		 * it before its slot was taken over.
+		 */
+		high = Max(range->last_oid, max_oid);
+		high = Max(high, lobj_oid_allocator->evicted_oid);
+		if (high < FirstNormalObjectId - 1)
+			high = FirstNormalObjectId - 1;
+
+		if (UINT_MAX - high >= (unsigned int) pool_config->lobj_oid_block_size)
+		{
+			range->next_oid = high + 1;
+			range->last_oid = high + pool_config->lobj_oid_block_size;
+		}
+	}
+
+	if (range->next_oid <= range->last_oid)
+		oid = range->next_oid++;
+	pool_semaphore_unlock(LOBJ_OID_SEM);
+	POOL_SETMASK(&oldmask);
+
+	if (oid == 0)
+		pool_log("lobj_allocate_oid: no large object OID left to reserve for database %s", database);
+	else
+		pool_debug("lobj_allocate_oid: reserved new range. database: %s max oid: %u oid: %u",
+				   database, max_oid, oid);
+
+	return oid;
+}
@@ -44,6 +44,33 @@ static bool select_table_walker(Node *node, void *context);
 static bool non_immutable_function_call_walker(Node *node, void *context);
 static char *strip_quote(char *str);
 static char *make_table_name_from_rangevar(RangeVar *rangevar);
+static bool prefetch_relcache_walker(Node *node, void *context);
+
+/* Relcache lookups to be done by pool_prefetch_relcache() */
+typedef struct {
+	POOL_CONNECTION_POOL *backend;
+	bool	system_catalog;		/* is_system_catalog() */
+	bool	temp_table;			/* is_temp_table() */
+	bool	unlogged_table;		/* is_unlogged_table() */
+	bool	view;				/* is_view() */
+	bool	table_oid;			/* pool_table_name_to_oid() */
+	bool	function;			/* is_immutable_function() */
+} PrefetchContext;
+
+/*
+ * Relcaches used by the functions below. They are created at first
+ * use.
+ */
+static POOL_RELCACHE *hasreliscatalog_cache;
+static POOL_RELCACHE *system_catalog_relcache;
+static POOL_RELCACHE *hasrelistemp_cache;
+static POOL_RELCACHE *is_temp_table_relcache;
+static POOL_RELCACHE *hasrelpersistence_cache;
+static POOL_RELCACHE *unlogged_table_relcache;
+static POOL_RELCACHE *view_relcache;
+static POOL_RELCACHE *has_pgpool_regclass_relcache;
+static POOL_RELCACHE *immutable_function_relcache;
+static POOL_RELCACHE *table_to_oid_relcache;
 
 /*
  * Return true if this SELECT has function calls *and* supposed to
@@ -136,6 +163,91 @@ bool pool_has_view(Node *node)
 	return ctx.has_view;
 }
 
+/*
+ * Look up information in system catalog needed to examine this
+ * SELECT at once. Relcache searches of tables and functions which are
+ * not cached yet are issued as a single query, rather than one by one
+ * by the walkers above. Lookups are done only with relcaches already
+ * created, since the query of a relcache depends on the backend
+ * capabilities which are examined when it is created.
+ *
+ * node may be a List of statements of a multi statement query, in
+ * which case lookups of all SELECTs in it are done at once.
+ */
+void pool_prefetch_relcache(Node *node)
+{
+	PrefetchContext ctx;
+	POOL_SESSION_CONTEXT *session_context;
+	POOL_CONNECTION_POOL *backend;
+	ListCell *cell;
+	bool has_select = false;
+
+	if (node == NULL)
+		return;
+
+	if (IsA(node, List))
+	{
+		foreach(cell, (List *) node)
+		{
+			if (IsA(lfirst(cell), SelectStmt))
+				has_select = true;
+		}
+	}
+	else
+		has_select = IsA(node, SelectStmt);
+
+	if (!has_select)
+		return;
+
+	session_context = pool_get_session_context();
+	if (!session_context)
+		return;
+	backend = session_context->backend;
+
+	pool_relcache_prefetch_reset();
+
+	/*
+	 * Backend capabilities first, since they decide whether per table
+	 * lookups are needed. Usually they are already cached.
+	 */
+	if (has_pgpool_regclass_relcache)
+		pool_relcache_prefetch_add(has_pgpool_regclass_relcache, backend,
+								   MASTER_CONNECTION(backend)->sp->user);
+	if (hasreliscatalog_cache)
+		pool_relcache_prefetch_add(hasreliscatalog_cache, backend, "pg_namespace");
+	if (hasrelpersistence_cache)
+		pool_relcache_prefetch_add(hasrelpersistence_cache, backend, "pg_class");
+	pool_relcache_prefetch(backend);
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.backend = backend;
+	ctx.system_catalog = system_catalog_relcache &&
+		pool_search_relcache(hasreliscatalog_cache, backend, "pg_namespace");
+	ctx.temp_table = pool_config->check_temp_table && is_temp_table_relcache;
+	ctx.unlogged_table = unlogged_table_relcache &&
+		pool_search_relcache(hasrelpersistence_cache, backend, "pg_class");
+	if (pool_config->memory_cache_enabled)
+	{
+		ctx.view = view_relcache != NULL;
+		/* Without pgpool_regclass the query may return multiple rows */
+		ctx.table_oid = table_to_oid_relcache && pool_has_pgpool_regclass();
+		ctx.function = immutable_function_relcache != NULL;
+	}
+
+	if (IsA(node, List))
+	{
+		foreach(cell, (List *) node)
+		{
+			if (IsA(lfirst(cell), SelectStmt))
+				raw_expression_tree_walker(lfirst(cell), prefetch_relcache_walker, &ctx);
+		}
+	}
+	else
+		raw_expression_tree_walker(node, prefetch_relcache_walker, &ctx);
+
+	pool_relcache_prefetch(backend);
+}
+
 /*
  * Return true if this SELECT has INSERT INTO or FOR SHARE or FOR UPDATE.
  */
@@ -388,6 +500,51 @@ view_walker(Node *node, void *context)
 	return raw_expression_tree_walker(node, view_walker, context);
 }
 
+/*
+ * Walker function to register relcache lookups of tables and
+ * functions for pool_prefetch_relcache().
+ */
+static bool
+prefetch_relcache_walker(Node *node, void *context)
+{
+	PrefetchContext	*ctx = (PrefetchContext *) context;
+
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, RangeVar))
+	{
+		RangeVar *rgv = (RangeVar *)node;
+		char *relname;
+
+		if (ctx->system_catalog)
+			pool_relcache_prefetch_add(system_catalog_relcache, ctx->backend, rgv->relname);
+		if (ctx->temp_table)
+			pool_relcache_prefetch_add(is_temp_table_relcache, ctx->backend, rgv->relname);
+
+		relname = make_table_name_from_rangevar(rgv);
+		if (ctx->unlogged_table)
+			pool_relcache_prefetch_add(unlogged_table_relcache, ctx->backend, relname);
+		if (ctx->view)
+			pool_relcache_prefetch_add(view_relcache, ctx->backend, relname);
+		if (ctx->table_oid)
+			pool_relcache_prefetch_add(table_to_oid_relcache, ctx->backend, relname);
+	}
+	else if (IsA(node, FuncCall) && ctx->function)
+	{
+		FuncCall *fcall = (FuncCall *)node;
+		int length = list_length(fcall->funcname);
+
+		if (length == 1)
+			pool_relcache_prefetch_add(immutable_function_relcache, ctx->backend,
+									   strVal(linitial(fcall->funcname)));
+		else if (length > 1)
+			pool_relcache_prefetch_add(immutable_function_relcache, ctx->backend,
+									   strVal(lsecond(fcall->funcname)));
+	}
+	return raw_expression_tree_walker(node, prefetch_relcache_walker, context);
+}
+
 /*
  * Judge the table used in a query represented by node is a system
  * catalog or not.
@@ -408,8 +565,6 @@ static bool is_system_catalog(char *table_name)
 
 	int hasreliscatalog;
 	bool result;
-	static POOL_RELCACHE *hasreliscatalog_cache;
-	static POOL_RELCACHE *relcache;
 	POOL_CONNECTION_POOL *backend;
 
 	if (table_name == NULL)
@@ -453,7 +608,7 @@ static bool is_system_catalog(char *table_name)
 		/*
 		 * If relcache does not exist, create it.
 		 */
-		if (!relcache)
+		if (!system_catalog_relcache)
 		{
 			char *query;
 
@@ -467,10 +622,10 @@ static bool is_system_catalog(char *table_name)
 				query = ISBELONGTOPGCATALOGQUERY;
 			}
 
-			relcache = pool_create_relcache(pool_config->relcache_size, query,
-											int_register_func, int_unregister_func,
-											false);
-			if (relcache == NULL)
+			system_catalog_relcache = pool_create_relcache(pool_config->relcache_size, query,
+														   int_register_func, int_unregister_func,
+														   false);
+			if (system_catalog_relcache == NULL)
 			{
 				pool_error("is_system_catalog: pool_create_relcache error");
 				return false;
@@ -479,7 +634,7 @@ static bool is_system_catalog(char *table_name)
 		/*
 		 * Search relcache.
 		 */
-		result = pool_search_relcache(relcache, backend, table_name)==0?false:true;
+		result = pool_search_relcache(system_catalog_relcache, backend, table_name)==0?false:true;
 		return result;
 	}
 
@@ -493,8 +648,6 @@ static bool is_system_catalog(char *table_name)
  * Judge the table used in a query represented by node is a temporary
  * table or not.
  */
-static POOL_RELCACHE *is_temp_table_relcache;
-
 static bool is_temp_table(char *table_name)
 {
 /*
@@ -521,7 +674,6 @@ static bool is_temp_table(char *table_name)
 
 	int hasrelistemp;
 	bool result;
-	static POOL_RELCACHE *hasrelistemp_cache;
 	char *query;
 	POOL_CONNECTION_POOL *backend;
 
@@ -608,8 +760,6 @@ bool is_unlogged_table(char *table_name)
 #define ISUNLOGGEDQUERY2 "SELECT count(*) FROM pg_catalog.pg_class AS c WHERE c.oid = pgpool_regclass('%s') AND c.relpersistence = 'u'"
 
 	int hasrelpersistence;
-	static POOL_RELCACHE *hasrelpersistence_cache;
-	static POOL_RELCACHE *relcache;
 	POOL_CONNECTION_POOL *backend;
 
 	if (table_name == NULL)
@@ -653,12 +803,12 @@ bool is_unlogged_table(char *table_name)
 		/*
 		 * If relcache does not exist, create it.
 		 */
-		if (!relcache)
+		if (!unlogged_table_relcache)
 		{
-			relcache = pool_create_relcache(pool_config->relcache_size, query,
-											int_register_func, int_unregister_func,
-											true);
-			if (relcache == NULL)
+			unlogged_table_relcache = pool_create_relcache(pool_config->relcache_size, query,
+														   int_register_func, int_unregister_func,
+														   true);
+			if (unlogged_table_relcache == NULL)
 			{
 				pool_error("is_unlogged_table: pool_create_relcache error");
 				return false;
@@ -668,7 +818,7 @@ bool is_unlogged_table(char *table_name)
 		/*
 		 * Search relcache.
 		 */
-		result = pool_search_relcache(relcache, backend, table_name)==0?false:true;
+		result = pool_search_relcache(unlogged_table_relcache, backend, table_name)==0?false:true;
 		return result;
 	}
 	else
@@ -689,7 +839,6 @@ bool is_view(char *table_name)
 
 #define ISVIEWQUERY2 "SELECT count(*) FROM pg_catalog.pg_class AS c WHERE c.oid = pgpool_regclass('%s') AND c.relkind = 'v'"
 
-	static POOL_RELCACHE *relcache;
 	POOL_CONNECTION_POOL *backend;
 	bool result;
 	char *query;
@@ -711,12 +860,12 @@ bool is_view(char *table_name)
 		query = ISVIEWQUERY;
 	}
 
-	if (!relcache)
+	if (!view_relcache)
 	{
-		relcache = pool_create_relcache(pool_config->relcache_size, query,
-										int_register_func, int_unregister_func,
-										false);
-		if (relcache == NULL)
+		view_relcache = pool_create_relcache(pool_config->relcache_size, query,
+											 int_register_func, int_unregister_func,
+											 false);
+		if (view_relcache == NULL)
 		{
 			pool_error("is_view: pool_create_relcache error");
 			return false;
@@ -727,7 +876,7 @@ bool is_view(char *table_name)
 	/*
 	 * Search relcache.
 	 */
-	result = pool_search_relcache(relcache, backend, table_name)==0?false:true;
+	result = pool_search_relcache(view_relcache, backend, table_name)==0?false:true;
 	return result;
 }
 
@@ -742,26 +891,25 @@ bool pool_has_pgpool_regclass(void)
 #define HASPGPOOL_REGCLASSQUERY "SELECT count(*) from (SELECT has_function_privilege('%s', 'pgpool_regclass(cstring)', 'execute') WHERE EXISTS(SELECT * FROM pg_catalog.pg_proc AS p WHERE p.proname = 'pgpool_regclass')) AS s"
 
 	bool result;
-	static POOL_RELCACHE *relcache;
 	POOL_CONNECTION_POOL *backend;
 	char *user;
 
 	backend = pool_get_session_context()->backend;
 	user = MASTER_CONNECTION(backend)->sp->user;
 
-	if (!relcache)
+	if (!has_pgpool_regclass_relcache)
 	{
-		relcache = pool_create_relcache(pool_config->relcache_size, HASPGPOOL_REGCLASSQUERY,
-										int_register_func, int_unregister_func,
-										false);
-		if (relcache == NULL)
+		has_pgpool_regclass_relcache = pool_create_relcache(pool_config->relcache_size, HASPGPOOL_REGCLASSQUERY,
+															int_register_func, int_unregister_func,
+															false);
+		if (has_pgpool_regclass_relcache == NULL)
 		{
 			pool_error("has_pgpool_regclass: pool_create_relcache error");
 			return false;
 		}
 	}
 
-	result = pool_search_relcache(relcache, backend, user)==0?0:1;
+	result = pool_search_relcache(has_pgpool_regclass_relcache, backend, user)==0?0:1;
 	return result;
 }
 
@@ -868,17 +1016,16 @@ static bool is_immutable_function(char *fname)
  */
 #define IS_STABLE_FUNCTION_QUERY "SELECT count(*) FROM pg_catalog.pg_proc AS p WHERE p.proname = '%s' AND p.provolatile = 'i'"
 	bool result;
-	static POOL_RELCACHE *relcache;
 	POOL_CONNECTION_POOL *backend;
 
 	backend = pool_get_session_context()->backend;
 
-	if (!relcache)
+	if (!immutable_function_relcache)
 	{
-		relcache = pool_create_relcache(pool_config->relcache_size, IS_STABLE_FUNCTION_QUERY,
-										int_register_func, int_unregister_func,
-										false);
-		if (relcache == NULL)
+		immutable_function_relcache = pool_create_relcache(pool_config->relcache_size, IS_STABLE_FUNCTION_QUERY,
+														   int_register_func, int_unregister_func,
+														   false);
+		if (immutable_function_relcache == NULL)
 		{
 			pool_error("is_immutable_function: pool_create_relcache error");
 			return false;
@@ -886,7 +1033,7 @@ static bool is_immutable_function(char *fname)
 		pool_debug("is_immutable_function: relcache created");
 	}
 
-	result = pool_search_relcache(relcache, backend, fname)==0?0:1;
+	result = pool_search_relcache(immutable_function_relcache, backend, fname)==0?0:1;
 	pool_debug("is_immutable_function: search result:%d", result);
 	return result;
 }
@@ -903,7 +1050,6 @@ int pool_table_name_to_oid(char *table_name)
 #define TABLE_TO_OID_QUERY2 "SELECT oid FROM pg_class WHERE relname = '%s'"
 
 	int oid = 0;
-	static POOL_RELCACHE *relcache;
 	POOL_CONNECTION_POOL *backend;
 	char *query;
 
@@ -926,12 +1072,12 @@ int pool_table_name_to_oid(char *table_name)
 	/*
 	 * If relcache does not exist, create it.
 	 */
-	if (!relcache)
+	if (!table_to_oid_relcache)
 	{
-		relcache = pool_create_relcache(pool_config->relcache_size, query,
-										int_register_func, int_unregister_func,
-										true);
-		if (relcache == NULL)
+		table_to_oid_relcache = pool_create_relcache(pool_config->relcache_size, query,
+													 int_register_func, int_unregister_func,
+													 true);
+		if (table_to_oid_relcache == NULL)
 		{
 			pool_error("table_name_to_oid: pool_create_relcache error");
 			return oid;
@@ -941,13 +1087,13 @@ int pool_table_name_to_oid(char *table_name)
 		 * there's no such a table. In this case we do not want to cache the
 		 * state because the table might be created later in this session.
 		 */
-		relcache->no_cache_if_zero = true;	
+		table_to_oid_relcache->no_cache_if_zero = true;	
 	}
 
 	/*
 	 * Search relcache.
 	 */
-	oid = (int)(intptr_t)pool_search_relcache(relcache, backend, table_name);
+	oid = (int)(intptr_t)pool_search_relcache(table_to_oid_relcache, backend, table_name);
 	return oid;
 }
 
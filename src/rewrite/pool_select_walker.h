@@ -55,6 +55,7 @@ extern void discard_temp_table_relcache(void);
 extern bool pool_has_unlogged_table(Node *node);
 extern bool pool_has_view(Node *node);
 extern bool pool_has_insertinto_or_locking_clause(Node *node);
+extern void pool_prefetch_relcache(Node *node);
 extern bool pool_has_pgpool_regclass(void);
 extern bool raw_expression_tree_walker(Node *node, bool (*walker) (), void *context);
 extern int pool_table_name_to_oid(char *table_name);
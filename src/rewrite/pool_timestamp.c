@@ -22,16 +22,25 @@
 #include <arpa/inet.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "pool.h"
 #include "pool_timestamp.h"
 #include "pool_relcache.h"
 #include "pool_select_walker.h"
 #include "pool_config.h"
+#include "pool_parse_cache.h"
 #include "parser/parsenodes.h"
 #include "parser/parser.h"
 #include "parser/pool_memory.h"
 
+/*
+ * Placeholder of timestamp in rewritten queries saved in parse cache.
+ * Queries containing this are not cached, and neither are rewritten
+ * queries in which a deparsed literal produced this byte.
+ */
+#define TS_PLACEHOLDER	"\001"
 
 typedef struct {
 	char	*attrname;	/* attribute name */
@@ -52,6 +61,10 @@ typedef struct {
 	bool		 			 rewrite_to_params;
 	bool		 			 rewrite;		/* has rewritten? */
 	List					*params;		/* list of additional params */
+	TSRel					*rel;			/* relcache entry looked up if any */
+	bool					 uncacheable;	/* result cannot be reused? */
+	bool					 local_time;	/* cast to a type without time zone? */
+	int						 num_ts_consts;	/* num of ts_const emitted */
 } TSRewriteContext;
 
 static void *ts_register_func(POOL_SELECT_RESULT *res);
@@ -61,9 +74,16 @@ static bool isStringConst(Node *node, const char *str);
 static bool rewrite_timestamp_walker(Node *node, void *context);
 static bool rewrite_timestamp_insert(InsertStmt *i_stmt, TSRewriteContext *ctx);
 static bool rewrite_timestamp_update(UpdateStmt *u_stmt, TSRewriteContext *ctx);
-static char *get_current_timestamp(POOL_CONNECTION_POOL *backend);
+static char *get_current_timestamp(POOL_CONNECTION_POOL *backend, bool local_time);
+static char *query_current_timestamp(POOL_CONNECTION_POOL *backend);
+static char *get_synchronized_timestamp(POOL_CONNECTION_POOL *backend, POOL_SESSION_CONTEXT *session_context);
+static POOL_STATUS sync_master_clock(POOL_CONNECTION_POOL *backend, POOL_SESSION_CONTEXT *session_context);
 static Node *makeTsExpr(TSRewriteContext *ctx);
-static A_Const *makeStringConstFromQuery(POOL_CONNECTION_POOL *backend, char *expression);
+static A_Const *makeStringConstFromQuery(TSRewriteContext *ctx, char *expression);
+static char *get_template_key(Node *node, TSRewriteContext *ctx);
+static bool rewrite_from_template(char *query, Node *stmt, TSRewriteContext *ctx, char **rewrite_query);
+static char *fill_timestamp(POOL_CONNECTION_POOL *backend, const char *template);
+static int count_placeholders(const char *template);
 bool raw_expression_tree_walker(Node *node, bool (*walker) (), void *context);
 
 POOL_RELCACHE	*ts_relcache;
@@ -116,6 +136,7 @@ ts_unregister_func(void *data)
 	if (rel == NULL)
 		return NULL;
 
+	pool_parse_cache_forget_rewritten_queries(rel);
 	free(rel);
 	return rel;
 }
@@ -170,7 +191,13 @@ relcache_lookup(TSRewriteContext *ctx)
 		}
 	}
 
-	return (TSRel *) pool_search_relcache(ts_relcache, ctx->backend, ctx->relname);
+	ctx->rel = (TSRel *) pool_search_relcache(ts_relcache, ctx->backend, ctx->relname);
+
+	/* we need to look up again next time */
+	if (ctx->rel == NULL)
+		ctx->uncacheable = true;
+
+	return ctx->rel;
 }
 
 
@@ -180,7 +207,10 @@ makeTsExpr(TSRewriteContext *ctx)
 	ParamRef		*param;
 
 	if (!ctx->rewrite_to_params)
+	{
+		ctx->num_ts_consts++;
 		return (Node *) ctx->ts_const;
+	}
 
 	param = makeNode(ParamRef);
 	param->number = 0;
@@ -273,6 +303,7 @@ rewrite_timestamp_walker(Node *node, void *context)
 	{
 		/* CURRENT_DATE, CURRENT_TIME, LOCALTIMESTAMP, LOCALTIME etc.*/
 		TypeCast	*tc = (TypeCast *) node;
+		bool		 local_time = !isSystemType((Node *) tc->typeName, "timestamptz");
 
 		if ((isSystemType((Node *) tc->typeName, "date") ||
 			 isSystemType((Node *) tc->typeName, "timestamp") ||
@@ -288,6 +319,14 @@ rewrite_timestamp_walker(Node *node, void *context)
 			{
 				tc->arg = (Node *) makeTsExpr(ctx);
 				ctx->rewrite = true;
+
+				/*
+				 * Casting a timestamp literal to a type without time
+				 * zone ignores its time zone offset, so the literal
+				 * must be in the session's current time zone.
+				 */
+				if (local_time && !ctx->rewrite_to_params)
+					ctx->local_time = true;
 			}
 		}
 	}
@@ -306,13 +345,61 @@ rewrite_timestamp_walker(Node *node, void *context)
 
 /*
  * Get `now()' from MASTER node
+ *
+ * In a transaction, now() returns the same value until the transaction
+ * ends. So we remember the timestamp in session context and reuse it
+ * for the rest of the transaction. It is forgotten in ReadyForQuery()
+ * when the transaction ends.
+ *
+ * If local_time is true, the timestamp is cast to a type without time
+ * zone and must be in the session's current time zone. The time zone
+ * measured by sync_master_clock() might be obsolete (SET in a
+ * transaction rolled back, set_config(), daylight saving time change
+ * etc.), so the master is always asked in this case.
  */
 static char *
-get_current_timestamp(POOL_CONNECTION_POOL *backend)
+get_current_timestamp(POOL_CONNECTION_POOL *backend, bool local_time)
+{
+	POOL_SESSION_CONTEXT *session_context;
+	char			*timestamp;
+
+	session_context = pool_get_session_context();
+	if (session_context && session_context->transaction_timestamp_valid)
+		return session_context->transaction_timestamp;
+
+	/*
+	 * If we are in a transaction started by us, i.e. the query is not
+	 * in an explicit transaction block, compute the timestamp from
+	 * local clock to save a round trip to master if allowed.
+	 */
+	if (pool_config->timestamp_sync_interval > 0 && session_context && !local_time &&
+		INTERNAL_TRANSACTION_STARTED(backend, MASTER_NODE_ID))
+		timestamp = get_synchronized_timestamp(backend, session_context);
+	else
+		timestamp = query_current_timestamp(backend);
+
+	if (timestamp == NULL)
+		return NULL;
+
+	if (session_context && TSTATE(backend, MASTER_NODE_ID) != 'I')
+	{
+		strlcpy(session_context->transaction_timestamp, timestamp,
+				sizeof(session_context->transaction_timestamp));
+		session_context->transaction_timestamp_valid = true;
+	}
+
+	return timestamp;
+}
+
+/*
+ * Issue "SELECT now()" to MASTER node
+ */
+static char *
+query_current_timestamp(POOL_CONNECTION_POOL *backend)
 {
 	POOL_SELECT_RESULT *res;
 	POOL_STATUS		 status;
-	static char		timestamp[32];
+	static char		timestamp[POOL_TIMESTAMP_LEN];
 
 	status = do_query(MASTER(backend), "SELECT now()", &res, MAJOR(backend));
 	if (status != POOL_CONTINUE)
@@ -333,6 +420,99 @@ get_current_timestamp(POOL_CONNECTION_POOL *backend)
 	return timestamp;
 }
 
+/*
+ * Compute current timestamp of MASTER node from local clock. Offset
+ * of master's clock and time zone of the session are measured every
+ * timestamp_sync_interval seconds. The result is in ISO format with
+ * explicit time zone offset so that it is accepted regardless of
+ * DateStyle and is the same as what now() would return on master.
+ */
+static char *
+get_synchronized_timestamp(POOL_CONNECTION_POOL *backend, POOL_SESSION_CONTEXT *session_context)
+{
+	static char		timestamp[POOL_TIMESTAMP_LEN];
+	struct timeval	tv;
+	struct tm		tm;
+	long long int	usec;
+	time_t			sec;
+	int				tz;
+	int				len;
+
+	gettimeofday(&tv, NULL);
+
+	if (session_context->clock_synced_at == 0 ||
+		tv.tv_sec - session_context->clock_synced_at >= pool_config->timestamp_sync_interval ||
+		tv.tv_sec < session_context->clock_synced_at)
+	{
+		if (sync_master_clock(backend, session_context) != POOL_CONTINUE)
+			return query_current_timestamp(backend);
+		gettimeofday(&tv, NULL);
+	}
+
+	usec = (long long int)tv.tv_sec * 1000000 + tv.tv_usec +
+		session_context->master_clock_offset;
+	tz = session_context->master_timezone;
+
+	sec = usec / 1000000 + tz;
+	if (gmtime_r(&sec, &tm) == NULL)
+		return query_current_timestamp(backend);
+
+	len = snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02d %02d:%02d:%02d.%06d%c%02d",
+				   tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+				   tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(usec % 1000000),
+				   tz < 0 ? '-' : '+', abs(tz) / 3600);
+	if (abs(tz) % 3600)
+		snprintf(timestamp + len, sizeof(timestamp) - len, ":%02d", abs(tz) % 3600 / 60);
+
+	return timestamp;
+}
+
+/*
+ * Measure offset of MASTER node's clock to local clock and time zone
+ * of the session. Half of the round trip time is taken into account.
+ */
+static POOL_STATUS
+sync_master_clock(POOL_CONNECTION_POOL *backend, POOL_SESSION_CONTEXT *session_context)
+{
+	POOL_SELECT_RESULT *res;
+	POOL_STATUS		 status;
+	struct timeval	before, after;
+	long long int	local_usec;
+	double			master_sec;
+
+	gettimeofday(&before, NULL);
+	status = do_query(MASTER(backend),
+					  "SELECT extract(epoch FROM clock_timestamp()), extract(timezone FROM now())",
+					  &res, MAJOR(backend));
+	gettimeofday(&after, NULL);
+
+	if (status != POOL_CONTINUE)
+	{
+		pool_error("sync_master_clock: do_query failed");
+		return status;
+	}
+
+	if (res->numrows != 1 || res->data[0] == NULL || res->data[1] == NULL)
+	{
+		free_select_result(res);
+		return POOL_ERROR;
+	}
+
+	master_sec = atof(res->data[0]);
+	local_usec = ((long long int)before.tv_sec * 1000000 + before.tv_usec +
+				  (long long int)after.tv_sec * 1000000 + after.tv_usec) / 2;
+
+	session_context->master_clock_offset = (long long int)(master_sec * 1000000) - local_usec;
+	session_context->master_timezone = atoi(res->data[1]);
+	session_context->clock_synced_at = after.tv_sec;
+
+	pool_debug("sync_master_clock: offset: %lld usec time zone: %d",
+			   session_context->master_clock_offset, session_context->master_timezone);
+
+	free_select_result(res);
+	return POOL_CONTINUE;
+}
+
 
 /*
  * rewrite InsertStmt
@@ -369,7 +549,7 @@ rewrite_timestamp_insert(InsertStmt *i_stmt, TSRewriteContext *ctx)
 					values = lappend(values, makeTsExpr(ctx));
 				else
 					values = lappend(values,
-									 makeStringConstFromQuery(ctx->backend, relcache->attr[i].adsrc));
+									 makeStringConstFromQuery(ctx, relcache->attr[i].adsrc));
 			}
 			else
 				values = lappend(values, makeNode(SetToDefault));
@@ -435,7 +615,7 @@ rewrite_timestamp_insert(InsertStmt *i_stmt, TSRewriteContext *ctx)
 						if (ctx->rewrite_to_params)
 							lfirst(lc_val) = makeTsExpr(ctx);
 						else
-							lfirst(lc_val) = makeStringConstFromQuery(ctx->backend, relcache->attr[i].adsrc);
+							lfirst(lc_val) = makeStringConstFromQuery(ctx, relcache->attr[i].adsrc);
 					}
 					i++;
 				}
@@ -450,7 +630,7 @@ rewrite_timestamp_insert(InsertStmt *i_stmt, TSRewriteContext *ctx)
 							values = lappend(values, makeTsExpr(ctx));
 						else
 							values = lappend(values,
-											 makeStringConstFromQuery(ctx->backend, relcache->attr[i].adsrc));
+											 makeStringConstFromQuery(ctx, relcache->attr[i].adsrc));
 					}
 					else
 						values = lappend(values, makeNode(SetToDefault));
@@ -517,7 +697,7 @@ rewrite_timestamp_insert(InsertStmt *i_stmt, TSRewriteContext *ctx)
 						if (ctx->rewrite_to_params)
 							lfirst(lc_val) = makeTsExpr(ctx);
 						else
-							lfirst(lc_val) = makeStringConstFromQuery(ctx->backend, relcache->attr[i].adsrc);
+							lfirst(lc_val) = makeStringConstFromQuery(ctx, relcache->attr[i].adsrc);
 					}
 				}
 
@@ -528,7 +708,7 @@ rewrite_timestamp_insert(InsertStmt *i_stmt, TSRewriteContext *ctx)
 						values = lappend(values, makeTsExpr(ctx));
 					else
 						values = lappend(values,
-										 makeStringConstFromQuery(ctx->backend, relcache->attr[append_columns_list[i]].adsrc));
+										 makeStringConstFromQuery(ctx, relcache->attr[append_columns_list[i]].adsrc));
 				}
 			}
 			free(append_columns_list);
@@ -585,7 +765,7 @@ rewrite_timestamp_update(UpdateStmt *u_stmt, TSRewriteContext *ctx)
 						if (ctx->rewrite_to_params)
 							res->val = (Node *) makeTsExpr(ctx);
 						else
-							res->val = (Node *)makeStringConstFromQuery(ctx->backend, relcache->attr[i].adsrc);
+							res->val = (Node *)makeStringConstFromQuery(ctx, relcache->attr[i].adsrc);
 						rewrite = true;
 					}
 					break;
@@ -609,6 +789,7 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 	bool			 rewrite = false;
 	char			*timestamp;
 	char			*rewrite_query;
+	char			*query;
 
 	if (node == NULL)
 		return NULL;
@@ -624,6 +805,10 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 	ctx.num_params = 0;
 	ctx.rewrite = false;
 	ctx.params = NIL;
+	ctx.rel = NULL;
+	ctx.uncacheable = false;
+	ctx.local_time = false;
+	ctx.num_ts_consts = 0;
 
 	/*
 	 * Prepare?
@@ -636,6 +821,14 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 	else
 		stmt = node;
 
+	/*
+	 * If we have rewritten the same query before, just put current
+	 * timestamp into the saved result.
+	 */
+	query = get_template_key(node, &ctx);
+	if (query && rewrite_from_template(query, stmt, &ctx, &rewrite_query))
+		return rewrite_query;
+
 	if (IsA(stmt, InsertStmt))
 	{
 		InsertStmt *i_stmt = (InsertStmt *) stmt;
@@ -679,6 +872,7 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 			for (i = 0; i < message->num_tsparams; i++)
 			{
 				e_stmt->params = lappend(e_stmt->params, ctx.ts_const);
+				ctx.num_ts_consts++;
 				rewrite = true;
 			}
 		}
@@ -687,7 +881,11 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 		;
 
 	if (!rewrite)
+	{
+		if (query && !ctx.uncacheable)
+			pool_parse_cache_set_rewritten_query(query, "", ctx.rel);
 		return NULL;
+	}
 
 	if (ctx.rewrite_to_params && message)
 	{
@@ -715,9 +913,26 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 				   	lappend(p_stmt->argtypes, SystemTypeName("timestamptz"));
 		}
 	}
-	else
+	else if (query && !ctx.uncacheable &&
+			 !(ctx.local_time && pool_config->timestamp_sync_interval > 0))
 	{
-		timestamp = get_current_timestamp(backend);
+		/*
+		 * save the result with placeholders and fill them, unless a
+		 * literal such as E'\001' deparsed into the placeholder byte.
+		 */
+		ctx.ts_const->val.val.str = TS_PLACEHOLDER;
+		rewrite_query = nodeToString(node);
+		if (count_placeholders(rewrite_query) == ctx.num_ts_consts)
+		{
+			pool_parse_cache_set_rewritten_query(query, rewrite_query, ctx.rel);
+			return fill_timestamp(backend, rewrite_query);
+		}
+		pfree(rewrite_query);
+	}
+
+	if (!ctx.rewrite_to_params || !message)
+	{
+		timestamp = get_current_timestamp(backend, ctx.local_time);
 		if (timestamp == NULL)
 		{
 			pool_error("rewrite_timestamp: could not get current timestamp");
@@ -731,6 +946,142 @@ rewrite_timestamp(POOL_CONNECTION_POOL *backend, Node *node,
 	return rewrite_query;
 }
 
+/*
+ * Return the query string as the key to save the rewritten query in
+ * parse cache, or NULL if the result cannot be reused. The result of
+ * rewriting INSERT/UPDATE/DELETE to timestamp literals only depends
+ * on the query string and the relcache entry of the target table.
+ */
+static char *
+get_template_key(Node *node, TSRewriteContext *ctx)
+{
+	POOL_SESSION_CONTEXT *session_context;
+	POOL_QUERY_CONTEXT *query_context;
+
+	if (pool_config->parse_cache_size <= 0 || ctx->rewrite_to_params)
+		return NULL;
+
+	if (!IsA(node, InsertStmt) && !IsA(node, UpdateStmt) && !IsA(node, DeleteStmt))
+		return NULL;
+
+	session_context = pool_get_session_context();
+	if (!session_context || !session_context->query_context)
+		return NULL;
+
+	query_context = session_context->query_context;
+	if (query_context->parse_tree != node || query_context->is_multi_statement ||
+		query_context->original_query == NULL ||
+		strstr(query_context->original_query, TS_PLACEHOLDER))
+		return NULL;
+
+	return query_context->original_query;
+}
+
+/*
+ * Rewrite the query using the result saved in parse cache.  Returns
+ * false if not saved or the saved result is obsolete. Otherwise set
+ * the rewritten query (or NULL if rewriting is not needed) to
+ * "rewrite_query" and return true.
+ */
+static bool
+rewrite_from_template(char *query, Node *stmt, TSRewriteContext *ctx, char **rewrite_query)
+{
+	char		*template;
+	void		*dependency;
+	void		*dependency2;
+
+	template = pool_parse_cache_get_rewritten_query(query, &dependency);
+	if (template == NULL)
+		return false;
+
+	/*
+	 * Make sure that the relcache entry we used is still valid. Since
+	 * relcache lookup might replace the entry and forget the saved
+	 * result, search parse cache again.
+	 */
+	if (dependency)
+	{
+		if (IsA(stmt, InsertStmt))
+			ctx->relname = nodeToString(((InsertStmt *) stmt)->relation);
+		else if (IsA(stmt, UpdateStmt))
+			ctx->relname = nodeToString(((UpdateStmt *) stmt)->relation);
+		else
+			return false;
+
+		if (relcache_lookup(ctx) != dependency)
+			return false;
+
+		template = pool_parse_cache_get_rewritten_query(query, &dependency2);
+		if (template == NULL || dependency2 != dependency)
+			return false;
+	}
+
+	if (*template == '\0')
+		*rewrite_query = NULL;
+	else
+		*rewrite_query = fill_timestamp(ctx->backend, template);
+
+	return true;
+}
+
+/*
+ * Return the number of placeholders in the rewritten query.
+ */
+static int
+count_placeholders(const char *template)
+{
+	const char	*p;
+	int			 num_placeholders = 0;
+
+	for (p = template; (p = strchr(p, *TS_PLACEHOLDER)) != NULL; p++)
+		num_placeholders++;
+
+	return num_placeholders;
+}
+
+/*
+ * Replace placeholders in the rewritten query with current timestamp.
+ * Queries casting the timestamp to a type without time zone are not
+ * saved as templates while timestamp_sync_interval is enabled, so the
+ * timestamp may come from the local clock here. Returns palloced
+ * string.
+ */
+static char *
+fill_timestamp(POOL_CONNECTION_POOL *backend, const char *template)
+{
+	char		*timestamp;
+	char		*rewrite_query;
+	char		*dst;
+	const char	*p;
+	int			 num_placeholders;
+	int			 ts_len;
+
+	timestamp = get_current_timestamp(backend, false);
+	if (timestamp == NULL)
+	{
+		pool_error("rewrite_timestamp: could not get current timestamp");
+		return NULL;
+	}
+	ts_len = strlen(timestamp);
+
+	num_placeholders = count_placeholders(template);
+
+	dst = rewrite_query = palloc(strlen(template) + num_placeholders * ts_len + 1);
+	for (p = template; *p; p++)
+	{
+		if (*p == *TS_PLACEHOLDER)
+		{
+			memcpy(dst, timestamp, ts_len);
+			dst += ts_len;
+		}
+		else
+			*dst++ = *p;
+	}
+	*dst = '\0';
+
+	return rewrite_query;
+}
+
 
 /*
  * rewrite Bind message to add parameter
@@ -760,7 +1111,7 @@ bind_rewrite_timestamp(POOL_CONNECTION_POOL *backend,
 	}
 #endif
 
-	ts = get_current_timestamp(backend);
+	ts = get_current_timestamp(backend, false);
 	if (ts == NULL)
 	{
 		pool_error("bind_rewrite_timestamp: could not get current timestamp");
@@ -855,8 +1206,9 @@ bind_rewrite_timestamp(POOL_CONNECTION_POOL *backend,
 	return new_msg;
 }
 
-static A_Const *makeStringConstFromQuery(POOL_CONNECTION_POOL *backend, char *expression)
+static A_Const *makeStringConstFromQuery(TSRewriteContext *ctx, char *expression)
 {
+	POOL_CONNECTION_POOL *backend = ctx->backend;
 	A_Const *con;
 	POOL_SELECT_RESULT *res;
 	POOL_STATUS		 status;
@@ -864,6 +1216,9 @@ static A_Const *makeStringConstFromQuery(POOL_CONNECTION_POOL *backend, char *ex
 	int len;
 	char *str;
 
+	/* the result is not a placeholder. do not reuse the rewritten query */
+	ctx->uncacheable = true;
+
 	snprintf(query, sizeof(query), "SELECT %s", expression);
 	status = do_query(MASTER(backend), query, &res, MAJOR(backend));
 	if (status != POOL_CONTINUE)
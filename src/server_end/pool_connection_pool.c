@@ -214,6 +214,34 @@ void pool_discard_cp(char *user, char *database, int protoMajor)
 }
 
 
+/*
+ * Close connections to the DB node in all connection pools of this
+ * process.  Connections to the other nodes are kept.  The caller must
+ * make sure that node_id is not the master node since the startup
+ * packet is shared among the slots.
+ */
+void pool_discard_node_connections(int node_id)
+{
+	POOL_CONNECTION_POOL *p = pool_connection_pool;
+	int i;
+
+	if (p == NULL)
+		return;
+
+	for (i=0;i<pool_config->max_pool;i++, p++)
+	{
+		if (CONNECTION_SLOT(p, node_id) == NULL)
+			continue;
+
+		pool_debug("pool_discard_node_connections: close connection to node %d in pool %d", node_id, i);
+
+		pool_close(CONNECTION(p, node_id));
+		free(CONNECTION_SLOT(p, node_id));
+		CONNECTION_SLOT(p, node_id) = NULL;
+		memset(&p->info[node_id], 0, sizeof(ConnectionInfo));
+	}
+}
+
 /*
 * create a connection pool by user and database
 */
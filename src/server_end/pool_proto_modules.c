@@ -53,8 +53,13 @@
 #include "parser/pool_string.h"
 #include "pool_session_context.h"
 #include "pool_query_context.h"
+#include "pool_parse_cache.h"
 #include "pool_lobj.h"
+#include "pool_latency.h"
+#include "pool_activity.h"
+#include "pool_node_stats.h"
 #include "pool_select_walker.h"
+#include "pool_process_context.h"
 #include "utils/pool_memqcache.h"
 #include "utils/pool_signal.h"
 
@@ -95,6 +100,17 @@ static int* find_victim_nodes(int *ntuples, int nmembers, int master_node, int *
 static int extract_ntuples(char *message);
 static POOL_STATUS close_standby_transactions(POOL_CONNECTION *frontend,
 											  POOL_CONNECTION_POOL *backend);
+static bool is_relcache_invalidating_query(Node *node);
+static int pipeline_target_node(POOL_QUERY_CONTEXT *query_context);
+static bool can_pipeline_message(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
+								 POOL_QUERY_CONTEXT *query_context, int len);
+static bool pipeline_is_full(POOL_CONNECTION_POOL *backend, POOL_QUERY_CONTEXT *query_context, int len);
+static POOL_STATUS pipeline_message(POOL_QUERY_CONTEXT *query_context, char *kind,
+								   int len, char *contents, POOL_SENT_MESSAGE *msg);
+static POOL_STATUS pipeline_drain(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
+static void pipeline_cancel(POOL_CONNECTION_POOL *backend);
+static bool is_pipelined_message_completed(char message_kind, char response_kind);
+static POOL_STATUS copy_in_stream(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend);
 
 /*
  * Process Query('Q') message
@@ -109,6 +125,11 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
  	static char *sq_nodes = "pool_nodes";
  	static char *sq_version = "pool_version";
  	static char *sq_cache = "pool_cache";
+ 	static char *sq_copy = "pool_copy";
+	static char *sq_latency = "pool_latency";
+	static char *sq_activity = "pool_activity";
+	static char *sq_query_stats = "pool_query_stats";
+	static char *sq_cache_tables = "pool_cache_tables";
 	int commit;
 	List *parse_tree_list;
 	Node *node = NULL;
@@ -130,14 +151,18 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
 		return POOL_END;
 	}
 
+	/* start measuring latency of the query */
+	pool_latency_start();
+
 	/* save last query string for logging purpose */
 	strlcpy(query_string_buffer, contents, sizeof(query_string_buffer));
 
 	/* show ps status */
+	pool_activity_start_query(contents);
 	query_ps_status(contents, backend);
 
 	/* log query to log file if necessary */
-	if (pool_config->log_statement)
+	if (pool_config->log_statement && pool_log_statement_sampled())
 	{
 		pool_log("statement: %s", contents);
 	}
@@ -181,8 +206,10 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
 			pool_ps_idle_display(backend);
 			pool_set_skip_reading_from_backends();
 			pool_stats_count_up_num_cache_hits();
+			pool_latency_cache_hit(contents, NULL);
 			return POOL_CONTINUE;
 		}
+		pool_latency_cache_miss();
 	}
 
 	/* Create query context */
@@ -198,8 +225,13 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
 		pool_memory = pool_memory_create(PARSER_BLOCK_SIZE);
 	old_context = pool_memory_context_switch_to(query_context->memory_context);
 
-	/* parse SQL string */
-	parse_tree_list = raw_parser(contents);
+	/* parse SQL string. Use the parse cache if possible */
+	parse_tree_list = pool_parse_cache_lookup(contents, &query_context->syntax_info);
+	if (parse_tree_list == NIL)
+	{
+		parse_tree_list = raw_parser(contents);
+		pool_parse_cache_add(contents, parse_tree_list);
+	}
 
 	if (parse_tree_list == NIL)
 	{
@@ -289,6 +321,7 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
 		if (parse_tree_list && list_length(parse_tree_list) > 1)
 		{
 			query_context->is_multi_statement = true;
+			query_context->parse_tree_list = parse_tree_list;
 		}
 		else
 		{
@@ -356,9 +389,40 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
                 pool_debug("cache reporting");
                 cache_reporting(frontend, backend);
             }
+			else if (!strcmp(sq_copy, vnode->name))
+            {
+				is_valid_show_command = true;
+                pool_debug("copy reporting");
+                copy_reporting(frontend, backend);
+            }
+			else if (!strcmp(sq_latency, vnode->name))
+            {
+				is_valid_show_command = true;
+                pool_debug("latency reporting");
+                latency_reporting(frontend, backend);
+            }
+			else if (!strcmp(sq_activity, vnode->name))
+            {
+				is_valid_show_command = true;
+                pool_debug("activity reporting");
+                activity_reporting(frontend, backend);
+            }
+			else if (!strcmp(sq_query_stats, vnode->name))
+            {
+				is_valid_show_command = true;
+                pool_debug("query stats reporting");
+                query_stats_reporting(frontend, backend);
+            }
+			else if (!strcmp(sq_cache_tables, vnode->name))
+            {
+				is_valid_show_command = true;
+                pool_debug("cache tables reporting");
+                cache_tables_reporting(frontend, backend);
+            }
 
 			if (is_valid_show_command)
 			{
+				pool_latency_stop();
 				pool_ps_idle_display(backend);
 				pool_query_context_destroy(query_context);
 				pool_set_skip_reading_from_backends();
@@ -416,6 +480,7 @@ POOL_STATUS SimpleQuery(POOL_CONNECTION *frontend,
 		 */
 		pool_where_to_send(query_context, query_context->original_query,
 						   query_context->parse_tree);
+		pool_parse_cache_update(query_context->original_query, &query_context->syntax_info);
 
 		/*
 		 * if this is DROP DATABASE command, send USR1 signal to parent and
@@ -657,6 +722,7 @@ POOL_STATUS Execute(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	POOL_SESSION_CONTEXT *session_context;
 	POOL_QUERY_CONTEXT *query_context;
 	POOL_SENT_MESSAGE *bind_msg;
+	bool pipelining;
 
 	/* Get session context */
 	session_context = pool_get_session_context();
@@ -668,7 +734,7 @@ POOL_STATUS Execute(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 
 	pool_debug("Execute: portal name <%s>", contents);
 
-	bind_msg = pool_get_sent_message('B', contents);
+	bind_msg = pool_pipeline_get_sent_message('B', contents);
 	if (!bind_msg)
 	{
 		pool_error("Execute: cannot get bind message");
@@ -698,6 +764,26 @@ POOL_STATUS Execute(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 
 	pool_debug("Execute: query string = <%s>", query);
 
+	/*
+	 * Start measuring latency. Latency of Execute messages sent
+	 * before Sync is measured from the first Execute.
+	 */
+	pool_latency_start_if_not_running();
+
+	pool_activity_start_query(query);
+
+	pipelining = can_pipeline_message(frontend, backend, query_context, len);
+	if (pool_pipeline_pending() &&
+		(!pipelining || pipeline_is_full(backend, query_context, len)))
+	{
+		if (pipeline_drain(frontend, backend) != POOL_CONTINUE)
+			return POOL_END;
+
+		/* The portal may be gone. Backends ignore this message anyway. */
+		if (pool_is_ignore_till_sync())
+			return POOL_CONTINUE;
+	}
+
 	/*
 	 * Fetch memory cache if possible
 	 */
@@ -775,8 +861,10 @@ POOL_STATUS Execute(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 			pool_set_skip_reading_from_backends();
 			pool_stats_count_up_num_cache_hits();
 			pool_unset_query_in_progress();
+			pool_latency_cache_hit(query, query_context->is_parse_error ? NULL : node);
 			return POOL_CONTINUE;
 		}
+		pool_latency_cache_miss();
 	}
 
 	session_context->query_context = query_context;
@@ -790,7 +878,11 @@ POOL_STATUS Execute(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	/* check if query is "COMMIT" or "ROLLBACK" */
 	commit = is_commit_or_rollback_query(node);
 
-	if (REPLICATION || PARALLEL_MODE)
+	if (pipelining)
+	{
+		return pipeline_message(query_context, "E", len, contents, NULL);
+	}
+	else if (REPLICATION || PARALLEL_MODE)
 	{
 		/*
 		 * Query is not commit/rollback
@@ -865,11 +957,12 @@ POOL_STATUS Parse(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	char *stmt;
 	List *parse_tree_list;
 	Node *node = NULL;
-	POOL_SENT_MESSAGE *msg;
+	POOL_SENT_MESSAGE *msg = NULL;
 	POOL_STATUS status;
 	POOL_MEMORY_POOL *old_context;
 	POOL_SESSION_CONTEXT *session_context;
 	POOL_QUERY_CONTEXT *query_context;
+	bool pipelining;
 
 	/* Get session context */
 	session_context = pool_get_session_context();
@@ -892,8 +985,13 @@ POOL_STATUS Parse(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 		pool_memory = pool_memory_create(PARSER_BLOCK_SIZE);
 	old_context = pool_memory_context_switch_to(query_context->memory_context);
 
-	/* parse SQL string */
-	parse_tree_list = raw_parser(stmt);
+	/* parse SQL string. Use the parse cache if possible */
+	parse_tree_list = pool_parse_cache_lookup(stmt, &query_context->syntax_info);
+	if (parse_tree_list == NIL)
+	{
+		parse_tree_list = raw_parser(stmt);
+		pool_parse_cache_add(stmt, parse_tree_list);
+	}
 
 	if (parse_tree_list == NIL)
 	{
@@ -1006,6 +1104,7 @@ POOL_STATUS Parse(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 		 */
 		pool_where_to_send(query_context, query_context->original_query,
 						   query_context->parse_tree);
+		pool_parse_cache_update(query_context->original_query, &query_context->syntax_info);
 
 		if (REPLICATION)
 		{
@@ -1061,6 +1160,35 @@ POOL_STATUS Parse(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 
 	pool_memory_context_switch_to(old_context);
 
+	/*
+	 * Forward the message without waiting for response if possible.
+	 * Otherwise responses of the pipelined messages must be read
+	 * first.
+	 */
+	pipelining = can_pipeline_message(frontend, backend, query_context, len);
+	if (pool_pipeline_pending() &&
+		(!pipelining || pipeline_is_full(backend, query_context, len)))
+	{
+		if (pipeline_drain(frontend, backend) != POOL_CONTINUE)
+		{
+			pool_query_context_destroy(query_context);
+			return POOL_END;
+		}
+
+		/* Backends ignore this message since an error occurred */
+		if (pool_is_ignore_till_sync())
+		{
+			session_context->uncompleted_message = NULL;
+			if (msg)
+			{
+				msg->query_context = NULL;
+				pool_sent_message_destroy(msg);
+			}
+			pool_query_context_destroy(query_context);
+			return POOL_CONTINUE;
+		}
+	}
+
 	/*
 	 * If in replication mode, send "SYNC" message if not in a transaction.
 	 */
@@ -1126,7 +1254,15 @@ POOL_STATUS Parse(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	 * free_parser();
 	 */
 
-	if (REPLICATION || PARALLEL_MODE || MASTER_SLAVE)
+	if (pipelining)
+	{
+		if (pipeline_message(query_context, "P", len, contents, msg) != POOL_CONTINUE)
+		{
+			pool_query_context_destroy(query_context);
+			return POOL_END;
+		}
+	}
+	else if (REPLICATION || PARALLEL_MODE || MASTER_SLAVE)
 	{
 		/*
 		 * We must synchronize because Parse message acquires table
@@ -1219,6 +1355,7 @@ POOL_STATUS Bind(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	POOL_SENT_MESSAGE *bind_msg;
 	POOL_SESSION_CONTEXT *session_context;
 	POOL_QUERY_CONTEXT *query_context;
+	bool pipelining;
 
 	/* Get session context */
 	session_context = pool_get_session_context();
@@ -1236,13 +1373,37 @@ POOL_STATUS Bind(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 
 	parse_msg = pool_get_sent_message('Q', pstmt_name);
 	if (!parse_msg)
-		parse_msg = pool_get_sent_message('P', pstmt_name);
+		parse_msg = pool_pipeline_get_sent_message('P', pstmt_name);
 	if (!parse_msg)
 	{
 		pool_error("Bind: cannot get parse message \"%s\"", pstmt_name);
 		return POOL_END;
 	}
 
+	query_context = parse_msg->query_context;
+	if (!query_context)
+	{
+		pool_error("Bind: cannot get query context");
+		return POOL_END;
+	}
+
+	/*
+	 * Parse message is sent again in a writing transaction if load
+	 * balancing. This cannot be pipelined.
+	 */
+	pipelining = !(pool_config->load_balance_mode && pool_is_writing_transaction()) &&
+		can_pipeline_message(frontend, backend, query_context, len);
+	if (pool_pipeline_pending() &&
+		(!pipelining || pipeline_is_full(backend, query_context, len)))
+	{
+		if (pipeline_drain(frontend, backend) != POOL_CONTINUE)
+			return POOL_END;
+
+		/* The statement may be gone. Backends ignore this message anyway. */
+		if (pool_is_ignore_till_sync())
+			return POOL_CONTINUE;
+	}
+
 	bind_msg = pool_create_sent_message('B', len, contents,
 										parse_msg->num_tsparams, portal_name,
 										parse_msg->query_context);
@@ -1252,13 +1413,6 @@ POOL_STATUS Bind(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 		return POOL_END;
 	}
 
-	query_context = parse_msg->query_context;
-	if (!query_context)
-	{
-		pool_error("Bind: cannot get query context");
-		return POOL_END;
-	}
-
 	/*
 	 * If the query can be cached, save its offset of query text in bind message's content.
 	 */
@@ -1279,10 +1433,14 @@ POOL_STATUS Bind(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 
 	session_context->query_context = query_context;
 
+	if (pipelining)
+		return pipeline_message(query_context, "B", len, contents, bind_msg);
+
 	if (pool_config->load_balance_mode && pool_is_writing_transaction())
 	{
 		pool_where_to_send(query_context, query_context->original_query,
 						   query_context->parse_tree);
+		pool_parse_cache_update(query_context->original_query, &query_context->syntax_info);
 
 		if (parse_before_bind(frontend, backend, parse_msg) != POOL_CONTINUE)
 			return POOL_END;
@@ -1317,6 +1475,7 @@ POOL_STATUS Describe(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	POOL_SENT_MESSAGE *msg;
 	POOL_SESSION_CONTEXT *session_context;
 	POOL_QUERY_CONTEXT *query_context;
+	bool pipelining;
 
 	/* Get session context */
 	session_context = pool_get_session_context();
@@ -1331,7 +1490,7 @@ POOL_STATUS Describe(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	{
 		msg = pool_get_sent_message('Q', contents+1);
 		if (!msg)
-			msg = pool_get_sent_message('P', contents+1);
+			msg = pool_pipeline_get_sent_message('P', contents+1);
 		if (!msg)
 		{
 			pool_error("Describe: cannot get parse message");
@@ -1341,7 +1500,7 @@ POOL_STATUS Describe(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 	/* Portal */
 	else
 	{
-		msg = pool_get_sent_message('B', contents+1);
+		msg = pool_pipeline_get_sent_message('B', contents+1);
 		if (!msg)
 		{
 			pool_error("Describe: cannot get bind message");
@@ -1357,8 +1516,23 @@ POOL_STATUS Describe(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
 		return POOL_END;
 	}
 
+	pipelining = can_pipeline_message(frontend, backend, query_context, len);
+	if (pool_pipeline_pending() &&
+		(!pipelining || pipeline_is_full(backend, query_context, len)))
+	{
+		if (pipeline_drain(frontend, backend) != POOL_CONTINUE)
+			return POOL_END;
+
+		/* Backends ignore this message since an error occurred */
+		if (pool_is_ignore_till_sync())
+			return POOL_CONTINUE;
+	}
+
 	session_context->query_context = query_context;
 
+	if (pipelining)
+		return pipeline_message(query_context, "D", len, contents, NULL);
+
 	/*
 	 * Calling pool_where_to_send here is dangerous because the node
 	 * parse/bind has been sent could be change by
@@ -1643,6 +1817,10 @@ POOL_STATUS ReadyForQuery(POOL_CONNECTION *frontend,
 
 			TSTATE(backend, i) = kind;
 
+			/* the node finished a transaction */
+			if (kind == 'I')
+				pool_node_stats_count_transaction(i);
+
 			pool_debug("ReadyForQuery: transaction state:%c", state);
 
 			/*
@@ -1669,6 +1847,9 @@ POOL_STATUS ReadyForQuery(POOL_CONNECTION *frontend,
 		pool_flush(frontend);
 	}
 
+	/* record latency of the query */
+	pool_latency_query_done(session_context->query_context);
+
 	if (pool_is_query_in_progress())
 	{
 		node = pool_get_parse_tree();
@@ -1679,6 +1860,13 @@ POOL_STATUS ReadyForQuery(POOL_CONNECTION *frontend,
 
 			if (node)
 			{
+				/*
+				 * SET or RESET might change time zone. Measure master's
+				 * clock again for rewrite_timestamp().
+				 */
+				if (IsA(node, VariableSetStmt) || IsA(node, DiscardStmt))
+					session_context->clock_synced_at = 0;
+
 				/*
 				 * If the query was BEGIN/START TRANSACTION, clear the
 				 * history that we had a writing command in the transaction
@@ -1757,6 +1945,31 @@ POOL_STATUS ReadyForQuery(POOL_CONNECTION *frontend,
 							discard_temp_table_relcache();
 					}
 				}
+
+				/*
+				 * If the query was a DDL which might change the
+				 * results of relcache queries, invalidate shared
+				 * relcache so that other children see the
+				 * change. Since the change is not visible to others
+				 * until the transaction commits, do it again at the
+				 * end of transaction. Every statement of a multi
+				 * statement query is checked.
+				 */
+				if (pool_config->shared_relcache_size > 0)
+				{
+					POOL_QUERY_CONTEXT *query_context = session_context->query_context;
+					Node *stmts = node;
+
+					if (query_context && query_context->is_multi_statement &&
+						query_context->parse_tree_list != NIL)
+						stmts = (Node *) query_context->parse_tree_list;
+
+					if (is_relcache_invalidating_query(stmts))
+					{
+						pool_invalidate_shared_relcache();
+						session_context->invalidate_shared_relcache = true;
+					}
+				}
 			}
 
 			/* Memory cache enabled? */
@@ -1806,12 +2019,26 @@ POOL_STATUS ReadyForQuery(POOL_CONNECTION *frontend,
 		pool_unset_query_in_progress();
 	}
 
+	if (session_context->invalidate_shared_relcache &&
+		(MAJOR(backend) != PROTO_MAJOR_V3 || state == 'I'))
+	{
+		pool_invalidate_shared_relcache();
+		session_context->invalidate_shared_relcache = false;
+	}
+
+	/* Forget timestamp for rewrite_timestamp() at the end of transaction */
+	if (MAJOR(backend) != PROTO_MAJOR_V3 || state == 'I')
+		session_context->transaction_timestamp_valid = false;
+
 	if (!pool_is_doing_extended_query_message())
 	{
 		if (!(node && IsA(node, PrepareStmt)))
 			pool_query_context_destroy(pool_get_session_context()->query_context);
 	}
 
+	/* All pipelined messages have been processed */
+	pool_pipeline_reset();
+
 	/*
 	 * Show ps idle status
 	 */
@@ -2028,6 +2255,17 @@ POOL_STATUS CommandComplete(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *bac
 
 	}
 
+	/*
+	 * Read the rest of CommandComplete from all the nodes as it
+	 * arrives so that comparing affected tuples does not wait for
+	 * each node in turn.
+	 */
+	if (pool_fill_backend_read_buffers(backend, -1, sizeof(len)))
+	{
+		pool_error("CommandComplete: error while reading from backends");
+		return POOL_END;
+	}
+
 	status = pool_read(MASTER(backend), &len, sizeof(len));
 	if (status < 0)
 	{
@@ -2395,6 +2633,7 @@ POOL_STATUS ProcessFrontendResponse(POOL_CONNECTION *frontend,
 	if (pool_read(frontend, &fkind, 1) < 0)
 	{
 		pool_log("ProcessFrontendResponse: failed to read kind from frontend. frontend abnormally exited");
+		pipeline_cancel(backend);
 		return POOL_END;
 	}
 
@@ -2428,6 +2667,24 @@ POOL_STATUS ProcessFrontendResponse(POOL_CONNECTION *frontend,
 		return POOL_CONTINUE;
 	}
 
+	/*
+	 * Read responses of pipelined messages before processing a
+	 * message which cannot be pipelined.
+	 */
+	if (pool_pipeline_pending() && fkind != 'P' && fkind != 'B' &&
+		fkind != 'D' && fkind != 'E' && fkind != 'S' && fkind != 'X')
+	{
+		if (pipeline_drain(frontend, backend) != POOL_CONTINUE)
+			return POOL_END;
+
+		if (pool_is_ignore_till_sync())
+		{
+			if (!pool_is_query_in_progress())
+				pool_set_query_in_progress();
+			return POOL_CONTINUE;
+		}
+	}
+
 	pool_unset_doing_extended_query_message();
 
 	/*
@@ -2452,6 +2709,7 @@ POOL_STATUS ProcessFrontendResponse(POOL_CONNECTION *frontend,
 		POOL_MEMORY_POOL *old_context;
 
 		case 'X':	/* Terminate */
+			pipeline_cancel(backend);
 			free(contents);
 			return POOL_END;
 
@@ -2502,6 +2760,13 @@ POOL_STATUS ProcessFrontendResponse(POOL_CONNECTION *frontend,
 				pool_unset_ignore_till_sync();
 			if (!pool_is_query_in_progress())
 				pool_set_query_in_progress();
+			/* ReadyForQuery follows responses of pipelined messages */
+			if (pool_pipeline_pending() &&
+				!pool_pipeline_add('S', NULL, session_context->query_context))
+			{
+				status = POOL_END;
+				break;
+			}
 			status = SimpleForwardToBackend(fkind, frontend, backend, len, contents);
 			break;
 
@@ -2559,7 +2824,9 @@ POOL_STATUS ProcessBackendResponse(POOL_CONNECTION *frontend,
 {
 	int status;
 	char kind;
+	char pipelined_kind = '\0';
 	POOL_SESSION_CONTEXT *session_context;
+	POOL_PENDING_MESSAGE *pending;
 
 	/* Get session context */
 	session_context = pool_get_session_context();
@@ -2582,10 +2849,24 @@ POOL_STATUS ProcessBackendResponse(POOL_CONNECTION *frontend,
 		return POOL_CONTINUE;
 	}
 
+	/*
+	 * Responses of pipelined messages arrive in the order the messages
+	 * were forwarded.
+	 */
+	pending = pool_pipeline_head();
+	if (pending)
+	{
+		pipelined_kind = pending->kind;
+		session_context->query_context = pending->query_context;
+	}
+
     status = read_kind_from_backend(frontend, backend, &kind);
     if (status != POOL_CONTINUE)
         return status;
 
+	if (pending && (kind == '1' || kind == '2'))
+		session_context->uncompleted_message = pending->message;
+
 	/*
 	 * Sanity check
 	 */
@@ -2634,6 +2915,7 @@ POOL_STATUS ProcessBackendResponse(POOL_CONNECTION *frontend,
 
 			case 'E':	/* ErrorResponse */
 				status = ErrorResponse3(frontend, backend);
+				pool_node_stats_count_errors(backend);
 				pool_unset_command_success();
 				if (TSTATE(backend, MASTER_SLAVE ? PRIMARY_NODE_ID :
 						   REAL_MASTER_NODE_ID) != 'I')
@@ -2682,6 +2964,26 @@ POOL_STATUS ProcessBackendResponse(POOL_CONNECTION *frontend,
 					return POOL_END;
 				break;
 		}
+
+		if (pipelined_kind && status == POOL_CONTINUE)
+		{
+			if (kind == 'E')
+			{
+				/*
+				 * Backends ignore messages until Sync. If Sync has been
+				 * forwarded already, ReadyForQuery is coming.
+				 */
+				if (pool_pipeline_discard())
+					pool_unset_ignore_till_sync();
+			}
+			else if (is_pipelined_message_completed(pipelined_kind, kind))
+				pool_pipeline_pop();
+
+			/* Keep reading responses until ReadyForQuery */
+			pending = pool_pipeline_tail();
+			if (pending && pending->kind == 'S')
+				pool_set_query_in_progress();
+		}
 	}
 	else
 	{
@@ -2705,6 +3007,7 @@ POOL_STATUS ProcessBackendResponse(POOL_CONNECTION *frontend,
 
 			case 'E':	/* ErrorResponse */
 				status = ErrorResponse(frontend, backend);
+				pool_node_stats_count_errors(backend);
 				if (TSTATE(backend, MASTER_SLAVE ? PRIMARY_NODE_ID :
 						   REAL_MASTER_NODE_ID) != 'I')
 					pool_set_failed_transaction();
@@ -2823,6 +3126,16 @@ POOL_STATUS CopyDataRows(POOL_CONNECTION *frontend,
 									  copy_table);
 	}
 
+	/*
+	 * Forward CopyData messages in bulk. The message following them
+	 * (CopyDone or CopyFail) is processed below.
+	 */
+	if (copyin && MAJOR(backend) == PROTO_MAJOR_V3 && info == NULL)
+	{
+		if (copy_in_stream(frontend, backend) != POOL_CONTINUE)
+			return POOL_END;
+	}
+
 	for (;;)
 	{
 		if (copyin)
@@ -3246,7 +3559,7 @@ void per_node_statement_log(POOL_CONNECTION_POOL *backend, int node_id, char *qu
 {
 	POOL_CONNECTION_POOL_SLOT *slot = backend->slots[node_id];
 
-	if (pool_config->log_per_node_statement)
+	if (pool_config->log_per_node_statement && pool_log_statement_sampled())
 		pool_log("DB node id: %d backend pid: %d statement: %s", node_id, ntohl(slot->pid), query);
 }
 
@@ -3462,3 +3775,406 @@ static int extract_ntuples(char *message)
 
 	return atoi(rows);
 }
+
+/*
+ * Return true if the query might change the results of relcache
+ * queries, i.e. creates, drops or alters relations, functions,
+ * extensions, privileges or databases. node may be a List of all
+ * statements of a multi statement query.
+ */
+static bool is_relcache_invalidating_query(Node *node)
+{
+	ListCell *cell;
+
+	if (node == NULL)
+		return false;
+
+	switch (nodeTag(node))
+	{
+		case T_List:
+			foreach(cell, (List *) node)
+			{
+				if (is_relcache_invalidating_query((Node *) lfirst(cell)))
+					return true;
+			}
+			return false;
+
+		case T_CreateStmt:
+		case T_DropStmt:
+		case T_AlterTableStmt:
+		case T_RenameStmt:
+		case T_ViewStmt:
+		case T_AlterObjectSchemaStmt:
+		case T_CreateFunctionStmt:
+		case T_AlterFunctionStmt:
+		case T_CreatedbStmt:
+		case T_DropdbStmt:
+		case T_CreateSchemaStmt:
+		case T_DropOwnedStmt:
+		case T_CreateExtensionStmt:
+		case T_AlterExtensionStmt:
+		case T_GrantStmt:
+		case T_GrantRoleStmt:
+			return true;
+
+		case T_SelectStmt:
+			/* CREATE TABLE AS or SELECT INTO */
+			return ((SelectStmt *)node)->intoClause != NULL;
+
+		default:
+			return false;
+	}
+}
+
+/*
+ * Return the DB node id if the query is sent to only one node.
+ * Otherwise return -1.
+ */
+static int pipeline_target_node(POOL_QUERY_CONTEXT *query_context)
+{
+	int i;
+	int node_id = -1;
+
+	if (RAW_MODE)
+		return REAL_MASTER_NODE_ID;
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (!VALID_BACKEND_RAW(i) || !pool_is_node_to_be_sent(query_context, i))
+			continue;
+
+		if (node_id >= 0)
+			return -1;
+		node_id = i;
+	}
+	return node_id;
+}
+
+/*
+ * Return true if the extended query message can be forwarded without
+ * waiting for response. We pipeline only SELECT/INSERT/UPDATE/DELETE
+ * sent to a single node while frontend has more messages to send. In
+ * replication and parallel mode, pgpool needs master's response before
+ * sending the message to other nodes. Pipelined messages must be kept
+ * in the write buffer until Sync or Flush is forwarded, otherwise
+ * backend may block on sending responses nobody reads. If the write
+ * buffer is full (see pipeline_is_full()), the caller drains the
+ * pipelined messages first and then pipelines the message.
+ */
+static bool can_pipeline_message(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend,
+								 POOL_QUERY_CONTEXT *query_context, int len)
+{
+	POOL_PENDING_MESSAGE *head;
+	Node *node;
+	int node_id;
+
+	if (!pool_config->extended_query_pipelining ||
+		MAJOR(backend) != PROTO_MAJOR_V3 ||
+		REPLICATION || PARALLEL_MODE ||
+		pool_config->memory_cache_enabled)
+		return false;
+
+	node = query_context->parse_tree;
+	if (node == NULL || query_context->is_parse_error)
+		return false;
+
+	if (!IsA(node, SelectStmt) && !IsA(node, InsertStmt) &&
+		!IsA(node, UpdateStmt) && !IsA(node, DeleteStmt))
+		return false;
+
+	node_id = pipeline_target_node(query_context);
+	if (node_id < 0)
+		return false;
+
+	/* The message and following Sync must fit in the empty write buffer */
+	if (len + 10 > WRITEBUFSZ)
+		return false;
+
+	head = pool_pipeline_head();
+	if (head)
+		return head->query_context && pipeline_target_node(head->query_context) == node_id;
+
+	return pool_ssl_pending(frontend) || !pool_read_buffer_is_empty(frontend);
+}
+
+/*
+ * Return true if the write buffer of the node the message is sent to
+ * does not have room for the message and following Sync.
+ */
+static bool pipeline_is_full(POOL_CONNECTION_POOL *backend, POOL_QUERY_CONTEXT *query_context, int len)
+{
+	int node_id = pipeline_target_node(query_context);
+
+	if (node_id < 0)
+		return false;
+
+	return CONNECTION(backend, node_id)->wbufpo + len + 10 > WRITEBUFSZ;
+}
+
+/*
+ * Forward extended query message without waiting for response.
+ * Response is processed by ProcessBackendResponse() later.
+ */
+static POOL_STATUS pipeline_message(POOL_QUERY_CONTEXT *query_context, char *kind,
+								   int len, char *contents, POOL_SENT_MESSAGE *msg)
+{
+	POOL_STATUS status;
+
+	if (!pool_pipeline_add(*kind, msg, query_context))
+		return POOL_END;
+
+	/* ParseComplete and BindComplete take the message from the queue */
+	pool_get_session_context()->uncompleted_message = NULL;
+
+	pool_debug("pipeline_message: %c message pipelined. pending: %d", *kind, pool_pipeline_length());
+
+	pool_set_pipelining_message();
+	status = pool_extended_send_and_wait(query_context, kind, len, contents, 1, MASTER_NODE_ID);
+	if (status == POOL_CONTINUE)
+		status = pool_extended_send_and_wait(query_context, kind, len, contents, -1, MASTER_NODE_ID);
+	pool_unset_pipelining_message();
+
+	/* Go on reading messages from frontend */
+	pool_unset_query_in_progress();
+
+	return status;
+}
+
+/*
+ * Send Flush message and process responses of all pipelined messages.
+ * If backend reports an error, remaining messages are discarded and
+ * ignore_till_sync is set.
+ */
+static POOL_STATUS pipeline_drain(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	POOL_SESSION_CONTEXT *session_context;
+	POOL_QUERY_CONTEXT *query_context;
+	POOL_SENT_MESSAGE *uncompleted_message;
+	POOL_STATUS status = POOL_CONTINUE;
+	bool in_progress;
+	bool doing_extended;
+	int state = 0;
+	short num_fields = 0;
+	int sendlen;
+	int i;
+
+	session_context = pool_get_session_context();
+
+	pool_debug("pipeline_drain: pending: %d", pool_pipeline_length());
+
+	query_context = session_context->query_context;
+	uncompleted_message = session_context->uncompleted_message;
+	in_progress = pool_is_query_in_progress();
+	doing_extended = pool_is_doing_extended_query_message();
+
+	session_context->query_context = pool_pipeline_head()->query_context;
+	session_context->uncompleted_message = NULL;
+	pool_set_query_in_progress();
+	pool_set_doing_extended_query_message();
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (!VALID_BACKEND(i))
+			continue;
+
+		pool_write(CONNECTION(backend, i), "H", 1);
+		sendlen = htonl(4);
+		if (pool_write_and_flush(CONNECTION(backend, i), &sendlen, sizeof(sendlen)) < 0)
+			return POOL_END;
+	}
+
+	while (pool_pipeline_pending() && !pool_is_ignore_till_sync())
+	{
+		status = ProcessBackendResponse(frontend, backend, &state, &num_fields);
+		if (status != POOL_CONTINUE)
+			return status;
+	}
+
+	if (pool_flush(frontend))
+		return POOL_END;
+
+	session_context->query_context = query_context;
+	session_context->uncompleted_message = uncompleted_message;
+	if (in_progress)
+		pool_set_query_in_progress();
+	else
+		pool_unset_query_in_progress();
+	if (doing_extended)
+		pool_set_doing_extended_query_message();
+	else
+		pool_unset_doing_extended_query_message();
+
+	return status;
+}
+
+/*
+ * Throw away pipelined messages when frontend goes away. They are
+ * still in the write buffer and backends have not seen them.
+ */
+static void pipeline_cancel(POOL_CONNECTION_POOL *backend)
+{
+	int i;
+
+	if (!pool_pipeline_pending())
+		return;
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (VALID_BACKEND(i))
+			CONNECTION(backend, i)->wbufpo = 0;
+	}
+
+	pool_pipeline_discard();
+	pool_pipeline_reset();
+}
+
+/*
+ * Return true if the response completes the pipelined message
+ */
+static bool is_pipelined_message_completed(char message_kind, char response_kind)
+{
+	switch (message_kind)
+	{
+		case 'P':
+			return response_kind == '1';
+		case 'B':
+			return response_kind == '2';
+		case 'D':
+			return response_kind == 'T' || response_kind == 'n';
+		case 'E':
+			return response_kind == 'C' || response_kind == 'I' || response_kind == 's';
+		case 'S':
+			return response_kind == 'Z';
+	}
+	return false;
+}
+
+#define COPY_STREAM_BUFSZ (64 * 1024)
+
+/*
+ * Forward CopyData messages of COPY FROM STDIN (V3 only). Data is read
+ * from frontend in large chunks and payloads of the CopyData messages
+ * in a chunk are forwarded to all the backends as a single CopyData
+ * message. This is fine since CopyData message boundaries need not
+ * correspond to row boundaries. Returns when a message other than
+ * CopyData comes, leaving it in the frontend read buffer.
+ */
+static POOL_STATUS copy_in_stream(POOL_CONNECTION *frontend, POOL_CONNECTION_POOL *backend)
+{
+	static char *inbuf;
+	static char *outbuf;
+	POOL_CONNECTION *cps[MAX_NUM_BACKENDS];
+	ProcessInfo *pi;
+	struct timeval start_time;
+	struct timeval end_time;
+	long long int nbytes = 0;
+	char header[5];
+	int headerlen = 0;
+	int remaining = 0;	/* payload bytes of current CopyData not read yet */
+	int outlen;
+	int sendlen;
+	int ncps = 0;
+	int n;
+	int i;
+	char *p;
+	bool done = false;
+
+	if (inbuf == NULL)
+	{
+		inbuf = malloc(COPY_STREAM_BUFSZ);
+		outbuf = malloc(COPY_STREAM_BUFSZ + 5);
+		if (inbuf == NULL || outbuf == NULL)
+		{
+			pool_error("copy_in_stream: malloc failed");
+			free(inbuf);
+			free(outbuf);
+			inbuf = outbuf = NULL;
+			return POOL_END;
+		}
+	}
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (VALID_BACKEND(i))
+			cps[ncps++] = CONNECTION(backend, i);
+	}
+
+	gettimeofday(&start_time, NULL);
+
+	while (!done)
+	{
+		n = pool_read_some(frontend, inbuf, COPY_STREAM_BUFSZ);
+		if (n < 0)
+			return POOL_END;
+
+		outlen = 0;
+		p = inbuf;
+
+		while (p < inbuf + n)
+		{
+			if (remaining > 0)
+			{
+				int len = inbuf + n - p;
+
+				if (len > remaining)
+					len = remaining;
+				memcpy(outbuf + 5 + outlen, p, len);
+				outlen += len;
+				remaining -= len;
+				p += len;
+				continue;
+			}
+
+			header[headerlen++] = *p++;
+
+			if (headerlen == 1 && header[0] != 'd')
+			{
+				/* Not CopyData. Put back the rest to the read buffer. */
+				if (pool_unread(frontend, p - 1, inbuf + n - p + 1))
+					return POOL_END;
+				done = true;
+				break;
+			}
+
+			if (headerlen == sizeof(header))
+			{
+				memcpy(&remaining, header + 1, sizeof(remaining));
+				remaining = ntohl(remaining) - 4;
+				headerlen = 0;
+
+				if (remaining < 0)
+				{
+					pool_error("copy_in_stream: invalid CopyData message length: %d", remaining + 4);
+					return POOL_END;
+				}
+			}
+		}
+
+		if (outlen > 0)
+		{
+			outbuf[0] = 'd';
+			sendlen = htonl(outlen + 4);
+			memcpy(outbuf + 1, &sendlen, sizeof(sendlen));
+
+			if (pool_write_concurrently(cps, ncps, outbuf, outlen + 5))
+				return POOL_END;
+
+			nbytes += outlen;
+		}
+	}
+
+	gettimeofday(&end_time, NULL);
+
+	pi = pool_get_my_process_info();
+	if (pi)
+	{
+		pi->copy_in_count++;
+		pi->copy_in_bytes += nbytes;
+		pi->copy_in_usec += (end_time.tv_sec - start_time.tv_sec) * 1000000LL +
+			(end_time.tv_usec - start_time.tv_usec);
+	}
+
+	pool_debug("copy_in_stream: %lld bytes forwarded", nbytes);
+
+	return POOL_CONTINUE;
+}
@@ -0,0 +1,61 @@
+#! /bin/sh
+#-------------------------------------------------------------------
+# Fail over a standby node while a session is idle, then issue a
+# query on the session. The query must succeed without being sent to
+# the detached node, since failover of a standby does not restart
+# children.
+#-------------------------------------------------------------------
+TESTNAME=test-failover-idle-session
+TESTDIR=`pwd`/$TESTNAME.d
+PGBIN=`pg_config --bindir`
+PSQL=$PGBIN/psql
+PG_CTL=$PGBIN/pg_ctl
+
+fail()
+{
+	echo "$TESTNAME: FAILED: $1"
+	cd $TESTDIR && ./shutdownall >/dev/null 2>&1
+	exit 1
+}
+
+rm -fr $TESTDIR
+mkdir $TESTDIR
+cd $TESTDIR
+
+sh `dirname $0`/../pgpool_setup -m s -n 2 > setup.log 2>&1 || fail "pgpool_setup failed"
+. ./bashrc.ports
+
+# Send SELECTs of the session to the standby node
+echo "backend_weight0 = 0" >> etc/pgpool.conf
+echo "backend_weight1 = 1" >> etc/pgpool.conf
+echo "log_per_node_statement = on" >> etc/pgpool.conf
+
+./startall > /dev/null 2>&1
+sleep 10
+
+# Open a session and leave it idle after the first query
+rm -f session.in
+mkfifo session.in
+$PSQL -p $PGPOOL_PORT -A -t test < session.in > session.out 2>&1 &
+PSQL_PID=$!
+exec 3> session.in
+echo "SELECT 'before failover';" >&3
+sleep 2
+
+# Fail the standby while the session is idle
+$PG_CTL -D data1 -m immediate stop > /dev/null 2>&1
+sleep 10
+$PSQL -p $PGPOOL_PORT -A -t -c "show pool_nodes" test | grep "^1|" | grep -q "|3|" ||
+	fail "node 1 was not detached"
+
+echo "SELECT 'after failover';" >&3
+echo "\\q" >&3
+exec 3>&-
+wait $PSQL_PID
+
+grep -q "after failover" session.out || fail "query after failover failed: `cat session.out`"
+grep -q "ERROR\|FATAL\|terminated" session.out && fail "session got an error: `cat session.out`"
+
+./shutdownall > /dev/null 2>&1
+echo "$TESTNAME: OK"
+exit 0
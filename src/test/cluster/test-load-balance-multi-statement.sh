@@ -0,0 +1,50 @@
+#! /bin/sh
+#-------------------------------------------------------------------
+# Send multi statement queries with multi_statement_load_balance
+# enabled. SELECTs only are sent to the load balance node, while a
+# NO LOAD BALANCE comment given to any of the statements keeps the
+# query on the primary node.
+#-------------------------------------------------------------------
+TESTNAME=test-load-balance-multi-statement
+TESTDIR=`pwd`/$TESTNAME.d
+PGBIN=`pg_config --bindir`
+PSQL=$PGBIN/psql
+
+fail()
+{
+	echo "$TESTNAME: FAILED: $1"
+	cd $TESTDIR && ./shutdownall >/dev/null 2>&1
+	exit 1
+}
+
+rm -fr $TESTDIR
+mkdir $TESTDIR
+cd $TESTDIR
+
+sh `dirname $0`/../pgpool_setup -m s -n 2 > setup.log 2>&1 || fail "pgpool_setup failed"
+. ./bashrc.ports
+
+# Load balance SELECTs to the standby node only
+echo "backend_weight0 = 0" >> etc/pgpool.conf
+echo "backend_weight1 = 1" >> etc/pgpool.conf
+echo "multi_statement_load_balance = on" >> etc/pgpool.conf
+echo "log_per_node_statement = on" >> etc/pgpool.conf
+
+./startall > /dev/null 2>&1
+sleep 10
+
+$PSQL -p $PGPOOL_PORT -A -t -c "SELECT 'balanced'; SELECT 2" test > /dev/null 2>&1 ||
+	fail "multi statement SELECT failed"
+$PSQL -p $PGPOOL_PORT -A -t -c "SELECT 'first'; /*NO LOAD BALANCE*/ SELECT 2" test > /dev/null 2>&1 ||
+	fail "multi statement SELECT with NO LOAD BALANCE failed"
+
+grep "DB node id: 1 .*statement: SELECT 'balanced'" log/pgpool.log > /dev/null ||
+	fail "SELECTs were not sent to the load balance node"
+grep "DB node id: 1 .*statement: SELECT 'first'" log/pgpool.log > /dev/null &&
+	fail "query with NO LOAD BALANCE was sent to the load balance node"
+grep "DB node id: 0 .*statement: SELECT 'first'" log/pgpool.log > /dev/null ||
+	fail "query with NO LOAD BALANCE was not sent to the primary node"
+
+./shutdownall > /dev/null 2>&1
+echo "$TESTNAME: OK"
+exit 0
@@ -14,3 +14,4 @@ INSERT INTO rel1(c2, c1) VALUES(DEFAULT, 3), (DEFAULT, 4), ('2009-1-1', 5)
 INSERT INTO rel1(c1, c2, c4) VALUES(1, '2009-1-1', '2009-2-2')
 PREPARE q AS INSERT INTO rel1(c3) VALUES(1)
 PREPARE q(int) AS INSERT INTO rel1(c3) VALUES($1)
+INSERT INTO rel2(c1, c2) VALUES(now(), E'\001')
@@ -50,6 +50,28 @@ bool pool_has_pgpool_regclass(void)
 	return false;
 }
 
+/* for get_template_key() */
+POOL_QUERY_CONTEXT		_query_context;
+POOL_SESSION_CONTEXT	_session_context;
+
+POOL_SESSION_CONTEXT *pool_get_session_context(void)
+{
+	return &_session_context;
+}
+
+char *pool_parse_cache_get_rewritten_query(const char *query, void **dependency)
+{
+	return NULL;
+}
+
+void pool_parse_cache_set_rewritten_query(const char *query, const char *rewritten_query, void *dependency)
+{
+}
+
+void pool_parse_cache_forget_rewritten_queries(void *dependency)
+{
+}
+
 POOL_RELCACHE *
 pool_create_relcache(int cachesize, char *sql, func_ptr register_func, func_ptr unregister_func, bool issessionlocal)
 {
@@ -88,11 +110,16 @@ main(int argc, char **argv)
 	StartupPacket	 sp;
 	POOL_CONNECTION_POOL	backend;
 	POOL_CONNECTION_POOL_SLOT slot;
+	POOL_CONNECTION	con;
 	POOL_SENT_MESSAGE	msg;
 	backend.slots[0] = &slot;
 	slot.sp = &sp;
+	slot.con = &con;
+	con.tstate = 'I';
+	_session_context.query_context = &_query_context;
 
 	pool_config->replication_mode = 1;
+	pool_config->parse_cache_size = 1;
 
 	if (argc != 2)
 	{
@@ -111,6 +138,9 @@ main(int argc, char **argv)
 		{
 			msg.num_tsparams = 0;
 			Node *node = (Node *) lfirst(l);
+			_query_context.parse_tree = node;
+			_query_context.original_query = argv[1];
+			_query_context.is_multi_statement = list_length(tree) > 1;
 			query = rewrite_timestamp(&backend, node, false, &msg);
 			if (query)
 				printf("%s\n", query);
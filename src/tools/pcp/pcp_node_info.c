@@ -146,17 +146,31 @@ main(int argc, char **argv)
 	} else {
         if (verbose)
         {
-		    printf("Hostname: %s\nPort    : %d\nStatus  : %d\nWeight  : %f\n", 
+		    printf("Hostname: %s\nPort    : %d\nStatus  : %d\nWeight  : %f\n"
+				   "Selects : %lld\nWrites  : %lld\nXacts   : %lld\n"
+				   "BytesIn : %lld\nBytesOut: %lld\nErrors  : %lld\n",
 		    	   backend_info->backend_hostname,
 		    	   backend_info->backend_port,
 		    	   backend_info->backend_status,
-		    	   backend_info->backend_weight/RAND_MAX);
+		    	   backend_info->backend_weight/RAND_MAX,
+				   backend_info->stats.select_cnt,
+				   backend_info->stats.write_cnt,
+				   backend_info->stats.xact_cnt,
+				   backend_info->stats.bytes_in,
+				   backend_info->stats.bytes_out,
+				   backend_info->stats.error_cnt);
         } else {
-		    printf("%s %d %d %f\n", 
+		    printf("%s %d %d %f %lld %lld %lld %lld %lld %lld\n",
 		    	   backend_info->backend_hostname,
 		    	   backend_info->backend_port,
 		    	   backend_info->backend_status,
-		    	   backend_info->backend_weight/RAND_MAX);
+		    	   backend_info->backend_weight/RAND_MAX,
+				   backend_info->stats.select_cnt,
+				   backend_info->stats.write_cnt,
+				   backend_info->stats.xact_cnt,
+				   backend_info->stats.bytes_in,
+				   backend_info->stats.bytes_out,
+				   backend_info->stats.error_cnt);
         }
 
 		free(backend_info);
@@ -24,6 +24,7 @@
 #include "pool.h"
 #include "pool_config.h"
 #include "pool_passwd.h"
+#include "pool_logger.h"
 #include "utils/md5.h"
 
 #include <stdio.h>
@@ -303,3 +304,12 @@ set_tio_attr(int set)
 		}
 	}
 }
+
+/*
+ * pg_md5 does not have log buffers. Log lines are always written to
+ * stderr by pool_error() and friends.
+ */
+bool pool_log_buffer_write(const char *msg, int len)
+{
+	return false;
+}
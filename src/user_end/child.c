@@ -57,6 +57,8 @@
 #include "utils/md5.h"
 #include "pool_stream.h"
 #include "pool_passwd.h"
+#include "pool_parse_cache.h"
+#include "pool_activity.h"
 
 static POOL_CONNECTION *do_accept(int unix_fd, int inet_fd, struct timeval *timeout);
 static StartupPacket *read_startup_packet(POOL_CONNECTION *cp);
@@ -294,6 +296,12 @@ void do_child(int unix_fd, int inet_fd)
 			pool_initialize_private_backend_status();
 		}
 
+		/*
+		 * If some DB nodes have been detached by failover while we
+		 * were idle, close pooled connections to them.
+		 */
+		pool_detach_down_nodes();
+
 		/*
 		 * if there's no connection associated with user and database,
 		 * we need to connect to the backend and send the startup packet.
@@ -354,6 +362,7 @@ void do_child(int unix_fd, int inet_fd)
 		snprintf(psbuf, sizeof(psbuf), "%s %s %s idle",
 				 sp->user, sp->database, remote_ps_data);
 		set_ps_display(psbuf, false);
+		pool_activity_start_session(sp->database, sp->user, remote_ps_data);
 
 		/*
 		 * Initialize per session context
@@ -497,6 +506,7 @@ static POOL_CONNECTION *do_accept(int unix_fd, int inet_fd, struct timeval *time
 	struct timeval tv1, tv2, tmback = {0, 0};
 
 	set_ps_display("wait for connection request", false);
+	pool_activity_wait_connection();
 
 	/* Destroy session context for just in case... */
 	pool_session_context_destroy();
@@ -655,6 +665,8 @@ static POOL_CONNECTION *do_accept(int unix_fd, int inet_fd, struct timeval *time
 		}
 		if (pool_config->parallel_mode)
 			pool_memset_system_db_info(system_db_info->info);
+		/* function lists affecting cached syntax info might be changed */
+		pool_parse_cache_reset();
 		got_sighup = 0;
 	}
 
@@ -2025,3 +2037,75 @@ void pool_initialize_private_backend_status(void)
 
 	my_master_node_id = REAL_MASTER_NODE_ID;
 }
+
+/*
+ * Detach a DB node from this process without restarting it.  Close
+ * connections to the node in all connection pools and mark the node
+ * down in the private backend status.  Sessions and pooled connections
+ * to the other nodes are kept alive.  If the node was selected as the
+ * load balancing node of the current session, select another one.
+ *
+ * The master node (and the primary node in master/slave mode) can not
+ * be detached this way. Returns false in this case, and the caller
+ * should fall back to closing the whole session.
+ */
+bool pool_detach_node_locally(int node_id)
+{
+	POOL_SESSION_CONTEXT *session_context;
+
+	if (node_id < 0 || node_id >= NUM_BACKENDS)
+		return false;
+
+	if (node_id == my_master_node_id ||
+		(MASTER_SLAVE && node_id == PRIMARY_NODE_ID))
+		return false;
+
+	if (private_backend_status[node_id] == CON_DOWN ||
+		private_backend_status[node_id] == CON_UNUSED)
+		return true;
+
+	pool_log("pool_detach_node_locally: detach node %d from pid %d", node_id, getpid());
+
+	pool_discard_node_connections(node_id);
+	private_backend_status[node_id] = CON_DOWN;
+
+	session_context = pool_get_session_context();
+	if (session_context && pool_config->load_balance_mode &&
+		session_context->load_balance_node_id == node_id)
+	{
+		session_context->load_balance_node_id =
+			session_context->backend->info->load_balancing_node =
+			select_load_balancing_node();
+		pool_debug("pool_detach_node_locally: selected new load balancing node: %d",
+				   session_context->load_balance_node_id);
+	}
+	return true;
+}
+
+/*
+ * Check if any DB node has been degenerated in the shared memory since
+ * we copied the backend status to the private area, and detach it from
+ * this process.  Failover does not restart children unless the master
+ * or the primary node goes down, so this should be called at every
+ * point where no query is in progress.  Returns true if any node was
+ * detached.
+ */
+bool pool_detach_down_nodes(void)
+{
+	int i;
+	bool detached = false;
+
+	for (i=0;i<NUM_BACKENDS;i++)
+	{
+		if (BACKEND_INFO(i).backend_status != CON_DOWN)
+			continue;
+
+		if (private_backend_status[i] != CON_UP &&
+			private_backend_status[i] != CON_CONNECT_WAIT)
+			continue;
+
+		if (pool_detach_node_locally(i))
+			detached = true;
+	}
+	return detached;
+}
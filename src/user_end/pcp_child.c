@@ -56,6 +56,7 @@
 #include "pool_config.h"
 #include "pool_process_context.h"
 #include "pool_process_reporting.h"
+#include "pool_node_stats.h"
 
 #define MAX_FILE_LINE_LEN    512
 #define MAX_USER_PASSWD_LEN  128
@@ -371,24 +372,40 @@ pcp_do_child(int unix_fd, int inet_fd, char *pcp_conf_file)
 					char port_str[6];
 					char status[2];
 					char weight_str[20];
+					char stats_str[6][POOLCONFIG_MAXCOUNTLEN+1];
+					POOL_NODE_STATS stats;
 
 					snprintf(port_str, sizeof(port_str), "%d", bi->backend_port);
 					snprintf(status, sizeof(status), "%d", bi->backend_status);
 					snprintf(weight_str, sizeof(weight_str), "%f", bi->backend_weight);
 
+					pool_get_node_stats(node_id, &stats);
+					snprintf(stats_str[0], sizeof(stats_str[0]), "%lld", stats.select_cnt);
+					snprintf(stats_str[1], sizeof(stats_str[1]), "%lld", stats.write_cnt);
+					snprintf(stats_str[2], sizeof(stats_str[2]), "%lld", stats.xact_cnt);
+					snprintf(stats_str[3], sizeof(stats_str[3]), "%lld", stats.bytes_in);
+					snprintf(stats_str[4], sizeof(stats_str[4]), "%lld", stats.bytes_out);
+					snprintf(stats_str[5], sizeof(stats_str[5]), "%lld", stats.error_cnt);
+
 					pcp_write(frontend, "i", 1);
-					wsize = htonl(sizeof(code) +
-								  strlen(bi->backend_hostname)+1 +
-								  strlen(port_str)+1 +
-								  strlen(status)+1 +
-								  strlen(weight_str)+1 +
-								  sizeof(int));
+					wsize = sizeof(code) +
+						strlen(bi->backend_hostname)+1 +
+						strlen(port_str)+1 +
+						strlen(status)+1 +
+						strlen(weight_str)+1 +
+						sizeof(int);
+					for (i = 0; i < 6; i++)
+						wsize += strlen(stats_str[i])+1;
+					wsize = htonl(wsize);
 					pcp_write(frontend, &wsize, sizeof(int));
 					pcp_write(frontend, code, sizeof(code));
 					pcp_write(frontend, bi->backend_hostname, strlen(bi->backend_hostname)+1);
 					pcp_write(frontend, port_str, strlen(port_str)+1);
 					pcp_write(frontend, status, strlen(status)+1);
 					pcp_write(frontend, weight_str, strlen(weight_str)+1);
+					/* statement statistics follow. older clients ignore them */
+					for (i = 0; i < 6; i++)
+						pcp_write(frontend, stats_str[i], strlen(stats_str[i])+1);
 					if (pcp_flush(frontend) < 0)
 					{
 						pool_error("pcp_child: pcp_flush() failed. reason: %s", strerror(errno));
@@ -944,6 +961,73 @@ pcp_do_child(int unix_fd, int inet_fd, char *pcp_conf_file)
 				break;
 			}
 
+			case 'H': /* latency request */
+			{
+				int nrows = 0;
+				POOL_REPORT_LATENCY *latency = get_latency(&nrows);
+				int len = 0;
+				/* First, send array size of latency_info */
+				char arr_code[] = "ArraySize";
+				char code[] = "LatencyInfo";
+				/* Finally, indicate that all data is sent */
+				char fin_code[] = "CommandComplete";
+
+				pcp_write(frontend, "h", 1);
+				len = htonl(sizeof(arr_code) + sizeof(int) + sizeof(int));
+				pcp_write(frontend, &len, sizeof(int));
+				pcp_write(frontend, arr_code, sizeof(arr_code));
+				len = htonl(nrows);
+				pcp_write(frontend, &len, sizeof(int));
+
+				if (pcp_flush(frontend) < 0)
+				{
+					pool_error("pcp_child: pcp_flush() failed. reason: %s", strerror(errno));
+					exit(1);
+				}
+
+				for (i = 0; i < nrows; i++)
+				{
+					pcp_write(frontend, "h", 1);
+					len = htonl(sizeof(int)
+						+ sizeof(code)
+						+ strlen(latency[i].name) + 1
+						+ strlen(latency[i].count) + 1
+						+ strlen(latency[i].avg) + 1
+						+ strlen(latency[i].p50) + 1
+						+ strlen(latency[i].p90) + 1
+						+ strlen(latency[i].p99) + 1
+						+ strlen(latency[i].p999) + 1
+						+ strlen(latency[i].max) + 1
+					);
+
+					pcp_write(frontend, &len, sizeof(int));
+					pcp_write(frontend, code, sizeof(code));
+					pcp_write(frontend, latency[i].name, strlen(latency[i].name)+1);
+					pcp_write(frontend, latency[i].count, strlen(latency[i].count)+1);
+					pcp_write(frontend, latency[i].avg, strlen(latency[i].avg)+1);
+					pcp_write(frontend, latency[i].p50, strlen(latency[i].p50)+1);
+					pcp_write(frontend, latency[i].p90, strlen(latency[i].p90)+1);
+					pcp_write(frontend, latency[i].p99, strlen(latency[i].p99)+1);
+					pcp_write(frontend, latency[i].p999, strlen(latency[i].p999)+1);
+					pcp_write(frontend, latency[i].max, strlen(latency[i].max)+1);
+				}
+
+				pcp_write(frontend, "h", 1);
+				len = htonl(sizeof(fin_code) + sizeof(int));
+				pcp_write(frontend, &len, sizeof(int));
+				pcp_write(frontend, fin_code, sizeof(fin_code));
+				if (pcp_flush(frontend) < 0)
+				{
+					pool_error("pcp_child: pcp_flush() failed. reason: %s", strerror(errno));
+					exit(1);
+				}
+
+				free(latency);
+
+				pool_debug("pcp_child: retrieved latency information");
+				break;
+			}
+
 			case 'J':			/* promote node */
 			case 'j':			/* promote node gracefully */
 			{
@@ -27,15 +27,21 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "pool.h"
 #include "pool_config.h"
+#include "pool_logger.h"
 
 #define MAXSTRFTIME 128
 
+/* Log lines shorter than this are formatted without malloc */
+#define LOG_LINE_BUFSIZE 1024
+
 extern int debug;
 
 static char *nowsec(void);
+static bool write_log_buffer(const char *level, const char *fmt, va_list ap);
 
 void pool_error(const char *fmt,...)
 {
@@ -50,6 +56,7 @@ void pool_error(const char *fmt,...)
 #else
 	int	oldmask;
 #endif
+	bool		buffered;
 	POOL_SETMASK2(&BlockSig, &oldmask);
 
 	/* Write error message to syslog */
@@ -61,6 +68,16 @@ void pool_error(const char *fmt,...)
 	   return;
 	}
 
+	/* Pass the line to logger process if it is running */
+	va_start(ap, fmt);
+	buffered = write_log_buffer("ERROR:", fmt, ap);
+	va_end(ap);
+	if (buffered)
+	{
+		POOL_SETMASK(&oldmask);
+		return;
+	}
+
 	if (pool_config->print_timestamp)
 #ifdef HAVE_ASPRINTF
 	  len = asprintf(&fmt2, "%s ERROR: pid %d: %s\n", nowsec(), (int)getpid(), fmt);
@@ -102,6 +119,7 @@ void pool_debug(const char *fmt,...)
 #else
 	int	oldmask;
 #endif
+	bool		buffered;
 
 	if (run_as_pcp_child)
 	{
@@ -125,6 +143,16 @@ void pool_debug(const char *fmt,...)
 	   return;
 	}
 
+	/* Pass the line to logger process if it is running */
+	va_start(ap, fmt);
+	buffered = write_log_buffer("DEBUG:", fmt, ap);
+	va_end(ap);
+	if (buffered)
+	{
+		POOL_SETMASK(&oldmask);
+		return;
+	}
+
 	if (pool_config->print_timestamp)
 #ifdef HAVE_ASPRINTF
 	  len = asprintf(&fmt2, "%s DEBUG: pid %d: %s\n", nowsec(), (int)getpid(), fmt);
@@ -166,6 +194,7 @@ void pool_log(const char *fmt,...)
 #else
 	int	oldmask;
 #endif
+	bool		buffered;
 
 	POOL_SETMASK2(&BlockSig, &oldmask);
 
@@ -178,6 +207,16 @@ void pool_log(const char *fmt,...)
 	   return;
 	}
 
+	/* Pass the line to logger process if it is running */
+	va_start(ap, fmt);
+	buffered = write_log_buffer("LOG:  ", fmt, ap);
+	va_end(ap);
+	if (buffered)
+	{
+		POOL_SETMASK(&oldmask);
+		return;
+	}
+
 	if (pool_config->print_timestamp)
 #ifdef HAVE_ASPRINTF
 	  len = asprintf(&fmt2, "%s LOG:   pid %d: %s\n", nowsec(), (int)getpid(), fmt);
@@ -206,6 +245,58 @@ void pool_log(const char *fmt,...)
 	POOL_SETMASK(&oldmask);
 }
 
+/*
+ * Format a log line and copy it into the log buffer. Returns false if
+ * log buffer is not used or the line could not be buffered.
+ */
+static bool write_log_buffer(const char *level, const char *fmt, va_list ap)
+{
+	char buf[LOG_LINE_BUFSIZE];
+	char *line = buf;
+	va_list ap2;
+	int hlen;
+	int len;
+	bool result;
+
+	if (pool_config->log_buffer_size <= 0)
+		return false;
+
+	if (pool_config->print_timestamp)
+		hlen = snprintf(buf, sizeof(buf), "%s %s pid %d: ", nowsec(), level, (int)getpid());
+	else
+		hlen = snprintf(buf, sizeof(buf), "%s pid %d: ", level, (int)getpid());
+
+	va_copy(ap2, ap);
+	len = vsnprintf(buf + hlen, sizeof(buf) - hlen, fmt, ap);
+	if (len < 0)
+	{
+		va_end(ap2);
+		return false;
+	}
+
+	/* Too long line. Format again in allocated buffer */
+	if (hlen + len + 1 > sizeof(buf))
+	{
+		line = malloc(hlen + len + 2);
+		if (!line)
+		{
+			va_end(ap2);
+			return false;
+		}
+		memcpy(line, buf, hlen);
+		vsnprintf(line + hlen, len + 1, fmt, ap2);
+	}
+	va_end(ap2);
+
+	line[hlen + len] = '\n';
+	result = pool_log_buffer_write(line, hlen + len + 1);
+
+	if (line != buf)
+		free(line);
+
+	return result;
+}
+
 static char *nowsec(void)
 {
 	static char strbuf[MAXSTRFTIME];
@@ -52,17 +52,20 @@
 #include "pool_select_walker.h"
 #include "pool_stream.h"
 #include "pool_proto_modules.h"
+#include "pool_latency.h"
 
 #ifdef USE_MEMCACHED
 memcached_st *memc;
 #endif
 
+static POOL_MEMQ_LOCK_TYPE shmem_lock_type;	/* mode of SHM_CACHE_SEM held */
+
 static char* encode_key(const char *s, char *buf, POOL_CONNECTION_POOL *backend);
 #ifdef DEBUG
 static void dump_cache_data(const char *data, size_t len);
 #endif
 static int pool_commit_cache(POOL_CONNECTION_POOL *backend, char *query, char *data, size_t datalen, int num_oids, int *oids);
-static int pool_fetch_cache(POOL_CONNECTION_POOL *backend, const char *query, char **buf, size_t *len);
+static int pool_fetch_cache(POOL_CONNECTION_POOL *backend, const char *query, char **buf, size_t *len, POOL_CACHE_ITEM_HEADER *header);
 static int send_cached_messages(POOL_CONNECTION *frontend, const char *qcache, int qcachelen);
 static void send_message(POOL_CONNECTION *conn, char kind, int len, const char *data);
 #ifdef USE_MEMCACHED
@@ -73,11 +76,11 @@ static int pool_get_dropdb_table_oids(int **oids, int dboid);
 static void pool_discard_dml_table_oid(void);
 static void pool_invalidate_query_cache(int num_table_oids, int *table_oid, bool unlink, int dboid);
 static int pool_get_database_oid(void);
-static void pool_add_table_oid_map(POOL_CACHEKEY *cachkey, int num_table_oids, int *table_oids);
+static void pool_add_table_oid_map(POOL_CACHEKEY *cachkey, int dboid, int num_table_oids, int *table_oids);
 static void pool_reset_memqcache_buffer(void);
-static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char *data, int size);
+static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char *data, int size, int dboid, int num_oids, int *oids);
 static POOL_CACHEID *pool_find_item_on_shmem_cache(POOL_QUERY_HASH *query_hash);
-static char *pool_get_item_shmem_cache(POOL_QUERY_HASH *query_hash, int *size, int *sts);
+static char *pool_get_item_shmem_cache(POOL_QUERY_HASH *query_hash, int *size, int *sts, POOL_CACHE_ITEM_HEADER *header);
 static POOL_QUERY_CACHE_ARRAY * pool_add_query_cache_array(POOL_QUERY_CACHE_ARRAY *cache_array, POOL_TEMP_QUERY_CACHE *cache);
 static void pool_add_temp_query_cache(POOL_TEMP_QUERY_CACHE *temp_cache, char kind, char *data, int data_len);
 static void pool_add_oids_temp_query_cache(POOL_TEMP_QUERY_CACHE *temp_cache, int num_oids, int *oids);
@@ -102,7 +105,7 @@ static int pool_init_cache_block(POOL_CACHE_BLOCKID blockid);
 #if NOT_USED
 static void pool_wipe_out_cache_block(POOL_CACHE_BLOCKID blockid);
 #endif
-static int pool_delete_item_shmem_cache(POOL_CACHEID *cacheid);
+static int pool_delete_item_shmem_cache(POOL_CACHEID *cacheid, POOL_CACHE_ITEM_HEADER *deleted);
 static char *block_address(int blockid);
 static POOL_CACHE_ITEM_POINTER *item_pointer(char *block, int i);
 static POOL_CACHE_ITEM_HEADER *item_header(char *block, int i);
@@ -118,6 +121,32 @@ static volatile POOL_HASH_ELEMENT *get_new_hash_element(void);
 static void put_back_hash_element(volatile POOL_HASH_ELEMENT *element);
 static char *get_relation_without_alias(RangeVar *relation);
 
+/* Events counted in per table query cache statistics */
+typedef enum {
+	TABLE_STATS_REGISTERED,
+	TABLE_STATS_HIT,
+	TABLE_STATS_INVALIDATED,
+	TABLE_STATS_EVICTED
+} TABLE_STATS_EVENT;
+
+/* Per child slot of per table query cache statistics */
+#define TABLE_STATS_BUCKETS (POOL_CACHE_TABLE_STATS_SIZE * 2)
+
+typedef struct
+{
+	volatile int num_entries;	/* entries in use except the overflow entry */
+	int buckets[TABLE_STATS_BUCKETS];	/* index + 1 of entries. 0 means empty */
+	POOL_CACHE_TABLE_STATS entries[POOL_CACHE_TABLE_STATS_SIZE + 1];	/* overflow entry comes last */
+} POOL_CACHE_TABLE_STATS_SLOT;
+
+static int pool_init_cache_table_stats(void);
+static void pool_cache_table_stats_count(TABLE_STATS_EVENT event, int dboid, int num_oids, int *oids, int bytes);
+static void pool_cache_table_stats_count_removed(POOL_CACHE_ITEM_HEADER *cih, TABLE_STATS_EVENT event, int table_oid);
+static void count_table_stats(volatile POOL_CACHE_TABLE_STATS *entry, TABLE_STATS_EVENT event, int bytes);
+static volatile POOL_CACHE_TABLE_STATS *table_stats_lookup(POOL_CACHE_TABLE_STATS_SLOT *slot, int dboid, int table_oid);
+static void merge_table_stats(POOL_CACHE_TABLE_STATS *result, int *buckets, int *num_entries, volatile POOL_CACHE_TABLE_STATS *entry);
+static int compare_table_stats(const void *p1, const void *p2);
+
 /*
  * Connect to Memcached
  */
@@ -206,6 +235,7 @@ static int pool_commit_cache(POOL_CONNECTION_POOL *backend, char *query, char *d
 	POOL_CACHEKEY cachekey;
 	char tmpkey[MAX_KEY];
 	time_t memqcache_expire;
+	int dboid;
 
 	/*
 	 * get_buflen() will return -1 if query result exceeds memqcache_maxcache
@@ -234,6 +264,8 @@ static int pool_commit_cache(POOL_CONNECTION_POOL *backend, char *query, char *d
 	memqcache_expire = pool_config->memqcache_expire;
 	pool_debug("pool_commit_cache : memqcache_expire = %ld", memqcache_expire);
 
+	dboid = pool_get_database_oid();
+
 	if (pool_is_shmem_cache())
 	{
 		POOL_CACHEID *cacheid;
@@ -250,7 +282,7 @@ static int pool_commit_cache(POOL_CONNECTION_POOL *backend, char *query, char *d
 		}
 		else
 		{
-			cacheid = pool_add_item_shmem_cache(&query_hash, data, datalen);
+			cacheid = pool_add_item_shmem_cache(&query_hash, data, datalen, dboid, num_oids, oids);
 			if (cacheid == NULL)
 			{
 				pool_error("pool_commit_cache: pool_add_item_shmem_cache failed");
@@ -283,7 +315,9 @@ static int pool_commit_cache(POOL_CONNECTION_POOL *backend, char *query, char *d
 	/*
 	 * Register cache id to oid map
 	 */
-	pool_add_table_oid_map(&cachekey, num_oids, oids);
+	pool_add_table_oid_map(&cachekey, dboid, num_oids, oids);
+
+	pool_cache_table_stats_count(TABLE_STATS_REGISTERED, dboid, num_oids, oids, 0);
 
 	return 0;
 }
@@ -292,7 +326,7 @@ static int pool_commit_cache(POOL_CONNECTION_POOL *backend, char *query, char *d
  * Fetch from memory cache.
  * 0: fetch success, 1: not found -1: error
  */
-static int pool_fetch_cache(POOL_CONNECTION_POOL *backend, const char *query, char **buf, size_t *len)
+static int pool_fetch_cache(POOL_CONNECTION_POOL *backend, const char *query, char **buf, size_t *len, POOL_CACHE_ITEM_HEADER *header)
 {
 	char *ptr;
 	char tmpkey[MAX_KEY];
@@ -315,7 +349,7 @@ static int pool_fetch_cache(POOL_CONNECTION_POOL *backend, const char *query, ch
 
 		memcpy(query_hash.query_hash, tmpkey, sizeof(query_hash.query_hash));
 
-		ptr = pool_get_item_shmem_cache(&query_hash, &mylen, &sts);
+		ptr = pool_get_item_shmem_cache(&query_hash, &mylen, &sts, header);
 		if (ptr == NULL)
 		{
 			pool_debug("pool_fetch_cache: cache not found on shmem");
@@ -329,6 +363,9 @@ static int pool_fetch_cache(POOL_CONNECTION_POOL *backend, const char *query, ch
 		memcached_return rc;
 		unsigned int flags;
 
+		/* memcached does not keep item header */
+		memset(header, 0, sizeof(POOL_CACHE_ITEM_HEADER));
+
 		ptr = memcached_get(memc, tmpkey, strlen(tmpkey), len, &flags, &rc);
 
 		if (rc != MEMCACHED_SUCCESS)
@@ -558,6 +595,7 @@ POOL_STATUS pool_fetch_from_memory_cache(POOL_CONNECTION *frontend,
 	char *qcache;
 	size_t qcachelen;
 	int sts;
+	POOL_CACHE_ITEM_HEADER header;
 #ifdef HAVE_SIGPROCMASK
 	sigset_t oldmask;
 #else
@@ -567,13 +605,17 @@ POOL_STATUS pool_fetch_from_memory_cache(POOL_CONNECTION *frontend,
 	*foundp = false;
 
 	POOL_SETMASK2(&BlockSig, &oldmask);
-	pool_shmem_lock();
-	sts = pool_fetch_cache(backend, contents, &qcache, &qcachelen);
+	pool_shmem_lock(POOL_MEMQ_SHARED_LOCK);
+	sts = pool_fetch_cache(backend, contents, &qcache, &qcachelen, &header);
 	pool_shmem_unlock();
 	POOL_SETMASK(&oldmask);
 
 	if (sts == 0)
 	{
+		if (header.dboid <= 0)
+			header.dboid = pool_get_database_oid();
+		pool_cache_table_stats_count(TABLE_STATS_HIT, header.dboid, header.num_oids, header.oids, 0);
+
 		/*
 		 * Cache found. send each messages to frontend
 		 */
@@ -623,7 +665,7 @@ POOL_STATUS pool_fetch_from_memory_cache(POOL_CONNECTION *frontend,
 
 		*foundp = true;
 
-		if (pool_config->log_per_node_statement)
+		if (pool_config->log_per_node_statement && pool_log_statement_sampled())
 			pool_log("query result fetched from cache. statement: %s", contents);
 
 		pool_debug("pool_fetch_from_memory_cache: a query result found in the query cache, %s", contents);
@@ -1230,10 +1272,9 @@ int pool_get_database_oid_from_dbname(char *dbname)
  * As of pgpool-II 3.2, pool_handle_query_cache is responsible for that.
  * (pool_handle_query_cache -> pool_commit_cache -> pool_add_table_oid_map)
  */
-static void pool_add_table_oid_map(POOL_CACHEKEY *cachekey, int num_table_oids, int *table_oids)
+static void pool_add_table_oid_map(POOL_CACHEKEY *cachekey, int dboid, int num_table_oids, int *table_oids)
 {
 	char *dir;
-	int dboid;
 	char path[1024];
 	int i;
 	int len;
@@ -1252,11 +1293,6 @@ static void pool_add_table_oid_map(POOL_CACHEKEY *cachekey, int num_table_oids,
 		}
 	}
 
-	/*
-	 * Create memqcache_oiddir/database_oid
-	 */
-	dboid = pool_get_database_oid();
-
 	pool_debug("pool_add_table_oid_map: dboid %d", dboid);
 	if (dboid <= 0)
 	{
@@ -1264,6 +1300,9 @@ static void pool_add_table_oid_map(POOL_CACHEKEY *cachekey, int num_table_oids,
 		return;
 	}
 
+	/*
+	 * Create memqcache_oiddir/database_oid
+	 */
 	snprintf(path, sizeof(path), "%s/%d", dir, dboid);
 	if (mkdir(path, S_IREAD|S_IWRITE|S_IEXEC) == -1)
 	{
@@ -1513,9 +1552,12 @@ static void pool_invalidate_query_cache(int num_table_oids, int *table_oid, bool
 			{
 				if (pool_is_shmem_cache())
 				{
+					POOL_CACHE_ITEM_HEADER cih;
+
 					pool_debug("pool_invalidate_query_cache: deleting cacheid:%d itemid:%d",
 							   buf.cacheid.blockid, buf.cacheid.itemid);
-					pool_delete_item_shmem_cache(&buf.cacheid);
+					if (pool_delete_item_shmem_cache(&buf.cacheid, &cih) == 0)
+						pool_cache_table_stats_count_removed(&cih, TABLE_STATS_INVALIDATED, oid);
 				}
 #ifdef USE_MEMCACHED
 				else
@@ -1525,7 +1567,8 @@ static void pool_invalidate_query_cache(int num_table_oids, int *table_oid, bool
 					memcpy(delbuf, buf.hashkey, 32);
 					delbuf[32] = 0;
 					pool_debug("pool_invalidate_query_cache: deleting %s", delbuf);
-					delete_cache_on_memcached(delbuf);
+					if (delete_cache_on_memcached(delbuf))
+						pool_cache_table_stats_count(TABLE_STATS_INVALIDATED, dboid, 1, &oid, 0);
 				}
 #endif
 				continue;
@@ -1690,7 +1733,7 @@ pool_clear_memory_cache(void)
 #endif
 
 	POOL_SETMASK2(&BlockSig, &oldmask);
-	pool_shmem_lock();
+	pool_shmem_lock(POOL_MEMQ_EXCLUSIVE_LOCK);
 
 	size = pool_shared_memory_cache_size();
 	memset(shmem, 0, size);
@@ -1838,6 +1881,7 @@ static POOL_CACHE_BLOCKID pool_reuse_block(void)
 		if (!(POOL_ITEM_DELETED & cip->flags))
 		{
 			pool_hash_delete(&cip->query_hash);
+			pool_cache_table_stats_count_removed(item_header(p, i), TABLE_STATS_EVICTED, 0);
 			pool_debug("pool_reuse_block: blockid: %d item: %d", reused_block, i);
 		}
 	}
@@ -1940,7 +1984,7 @@ static void pool_update_fsmm(POOL_CACHE_BLOCKID blockid, size_t free_space)
  * The cache id is overwritten by the subsequent call to this function.
  * On error returns NULL.
  */
-static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char *data, int size)
+static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char *data, int size, int dboid, int num_oids, int *oids)
 {
 	static POOL_CACHEID cacheid;
 	POOL_CACHE_BLOCKID blockid;
@@ -2126,6 +2170,11 @@ static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char
 	/* Fill in cache item header */
 	ci.header.timestamp = time(NULL);
 	ci.header.total_length = sizeof(POOL_CACHE_ITEM_HEADER) + size;
+	ci.header.dboid = dboid;
+	ci.header.num_oids = Min(num_oids, POOL_CACHE_ITEM_MAX_OIDS);
+	memset(ci.header.oids, 0, sizeof(ci.header.oids));
+	if (ci.header.num_oids > 0)
+		memcpy(ci.header.oids, oids, sizeof(int) * ci.header.num_oids);
 
 	/* Calculate item body address */
 	if (bh->num_items == 0)
@@ -2178,7 +2227,7 @@ static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char
 		/* Since we have failed to insert hash index entry, we need to
 		 * undo the addition of cache entry.
 		 */
-		pool_delete_item_shmem_cache(&cacheid);
+		pool_delete_item_shmem_cache(&cacheid, NULL);
 		return NULL;
 	}
 
@@ -2196,7 +2245,7 @@ static POOL_CACHEID *pool_add_item_shmem_cache(POOL_QUERY_HASH *query_hash, char
  * On error or data not found case returns NULL.
  * Detail is set to *sts. (0: success, 1: not found, -1: error)
  */
-static char *pool_get_item_shmem_cache(POOL_QUERY_HASH *query_hash, int *size, int *sts)
+static char *pool_get_item_shmem_cache(POOL_QUERY_HASH *query_hash, int *size, int *sts, POOL_CACHE_ITEM_HEADER *header)
 {
 	POOL_CACHEID *cacheid;
 	POOL_CACHE_ITEM_HEADER *cih;
@@ -2234,6 +2283,8 @@ static char *pool_get_item_shmem_cache(POOL_QUERY_HASH *query_hash, int *size, i
 
 	cih = pool_cache_item_header(cacheid);
 
+	if (header)
+		memcpy(header, cih, sizeof(POOL_CACHE_ITEM_HEADER));
 	*size = cih->total_length - sizeof(POOL_CACHE_ITEM_HEADER);
 	return (char *)cih + sizeof(POOL_CACHE_ITEM_HEADER);
 }
@@ -2248,6 +2299,7 @@ static POOL_CACHEID *pool_find_item_on_shmem_cache(POOL_QUERY_HASH *query_hash)
 	static POOL_CACHEID cacheid;
 	POOL_CACHEID *c;
 	POOL_CACHE_ITEM_HEADER *cih;
+	POOL_CACHE_ITEM_HEADER deleted;
 	time_t now;
 
 	c = pool_hash_search(query_hash);
@@ -2267,7 +2319,28 @@ static POOL_CACHEID *pool_find_item_on_shmem_cache(POOL_QUERY_HASH *query_hash)
 			pool_debug("pool_find_item_on_shmem_cache: cache expired");
 			pool_debug("pool_find_item_on_shmem_cache: now: %ld timestamp: %ld",
 					   now, cih->timestamp + pool_config->memqcache_expire);
-			pool_delete_item_shmem_cache(c);
+
+			/*
+			 * Deleting the item needs exclusive lock. Since the lock
+			 * cannot be upgraded, release it and acquire exclusive
+			 * lock, then search the item again because others might
+			 * have deleted it meanwhile.
+			 */
+			if (shmem_lock_type == POOL_MEMQ_SHARED_LOCK)
+			{
+				pool_shmem_unlock();
+				pool_shmem_lock(POOL_MEMQ_EXCLUSIVE_LOCK);
+
+				c = pool_hash_search(query_hash);
+				if (!c)
+					return NULL;
+				cih = item_header(block_address(c->blockid), c->itemid);
+				if (now <= (cih->timestamp + pool_config->memqcache_expire))
+					return NULL;
+			}
+
+			if (pool_delete_item_shmem_cache(c, &deleted) == 0)
+				pool_cache_table_stats_count_removed(&deleted, TABLE_STATS_EVICTED, 0);
 			return NULL;
 		}
 	}
@@ -2279,11 +2352,12 @@ static POOL_CACHEID *pool_find_item_on_shmem_cache(POOL_QUERY_HASH *query_hash)
 
 /*
  * Delete item data specified cache id from shmem.
- * On successful deletion, returns 0.
+ * On successful deletion, returns 0. If deleted is not NULL, the
+ * header of the deleted item is copied to it.
  * Other wise return -1.
  * FSMM is also updated.
  */
-static int pool_delete_item_shmem_cache(POOL_CACHEID *cacheid)
+static int pool_delete_item_shmem_cache(POOL_CACHEID *cacheid, POOL_CACHE_ITEM_HEADER *deleted)
 {
 	POOL_CACHE_BLOCK_HEADER *bh;
 	POOL_CACHE_ITEM_POINTER *cip;
@@ -2340,6 +2414,8 @@ static int pool_delete_item_shmem_cache(POOL_CACHEID *cacheid)
 
 	cih = pool_cache_item_header(cacheid);
 	size = cih->total_length + sizeof(POOL_CACHE_ITEM_POINTER);
+	if (deleted)
+		memcpy(deleted, cih, sizeof(POOL_CACHE_ITEM_HEADER));
 
 	/* Delete item pointer */
 	cip->flags |= POOL_ITEM_DELETED;
@@ -2455,7 +2531,7 @@ static void pool_wipe_out_cache_block(POOL_CACHE_BLOCKID blockid)
 		if ((POOL_ITEM_DELETED & cip->flags) == 0)		/* Not deleted item? */
 		{
 			cacheid.itemid = i;
-			pool_delete_item_shmem_cache(&cacheid);
+			pool_delete_item_shmem_cache(&cacheid, NULL);
 		}
 	}
 
@@ -2466,13 +2542,18 @@ static void pool_wipe_out_cache_block(POOL_CACHE_BLOCKID blockid)
 #endif
 
 /*
- * Acquire lock: XXX giant lock
+ * Acquire lock: XXX giant lock. Readers of the cache can share the
+ * lock.
  */
-void pool_shmem_lock(void)
+void pool_shmem_lock(POOL_MEMQ_LOCK_TYPE type)
 {
 	if (pool_is_shmem_cache())
 	{
-		pool_semaphore_lock(SHM_CACHE_SEM);
+		if (type == POOL_MEMQ_SHARED_LOCK)
+			pool_semaphore_lock_shared(SHM_CACHE_SEM);
+		else
+			pool_semaphore_lock(SHM_CACHE_SEM);
+		shmem_lock_type = type;
 	}
 }
 
@@ -2993,7 +3074,7 @@ void pool_handle_query_cache(POOL_CONNECTION_POOL *backend, char *query, Node *n
 				 */
 				/* Register to memcached or shmem */
 				POOL_SETMASK2(&BlockSig, &oldmask);
-				pool_shmem_lock();
+				pool_shmem_lock(POOL_MEMQ_EXCLUSIVE_LOCK);
 
 				cache_buffer =  pool_get_current_cache_buffer(&len);
 				if (cache_buffer)
@@ -3055,7 +3136,7 @@ void pool_handle_query_cache(POOL_CONNECTION_POOL *backend, char *query, Node *n
 		int num_caches;
 
 		POOL_SETMASK2(&BlockSig, &oldmask);
-		pool_shmem_lock();
+		pool_shmem_lock(POOL_MEMQ_EXCLUSIVE_LOCK);
 
 		/* Invalidate query cache */
 		if (pool_config->memqcache_auto_cache_invalidation)
@@ -3127,7 +3208,7 @@ void pool_handle_query_cache(POOL_CONNECTION_POOL *backend, char *query, Node *n
 
 			if (num_oids > 0 && pool_config->memqcache_auto_cache_invalidation)
 			{
-				pool_shmem_lock();
+				pool_shmem_lock(POOL_MEMQ_EXCLUSIVE_LOCK);
 				pool_invalidate_query_cache(num_oids, oids, true, dboid);
 				pool_discard_oid_maps_by_db(dboid);
 				pool_shmem_unlock();
@@ -3154,7 +3235,7 @@ void pool_handle_query_cache(POOL_CONNECTION_POOL *backend, char *query, Node *n
 				if (state == 'I')
 				{
 					POOL_SETMASK2(&BlockSig, &oldmask);
-					pool_shmem_lock();
+					pool_shmem_lock(POOL_MEMQ_EXCLUSIVE_LOCK);
 					pool_invalidate_query_cache(num_oids, oids, true, 0);
 					pool_shmem_unlock();
 					POOL_SETMASK(&oldmask);
@@ -3176,79 +3257,89 @@ void pool_handle_query_cache(POOL_CONNECTION_POOL *backend, char *query, Node *n
 }
 
 /*
- * Create and initialize query cache stats
+ * Create and initialize query cache stats. A slot is allocated for
+ * each child and one more for other processes.
  */
-static POOL_QUERY_CACHE_STATS *stats;
+static POOL_QUERY_CACHE_STATS_AREA *stats;
 int pool_init_memqcache_stats(void)
 {
-	stats = pool_shared_memory_create(sizeof(POOL_QUERY_CACHE_STATS));
+	size_t size;
+	int num_slots;
+
+	num_slots = pool_config->num_init_children + 1;
+	size = sizeof(POOL_QUERY_CACHE_STATS_AREA) +
+		sizeof(POOL_QUERY_CACHE_STATS_SLOT) * (num_slots - 1);
+
+	stats = pool_shared_memory_create(size);
 	if (stats == NULL)
 	{
 		pool_error("pool_init_meqcache_stats: failed to allocate shared memory stats. request size: %zd",
-				   sizeof(POOL_QUERY_CACHE_STATS));
+				   size);
 			return -1;
 	}
 
+	stats->num_slots = num_slots;
 	pool_reset_memqcache_stats();
 
-	return 0;
+	return pool_init_cache_table_stats();
 }
 
 /*
- * Returns copy of stats area. The copy is in static area and will be
- * overwritten by next call to this function.
+ * Returns stats summed up over all slots. The result is in static area
+ * and will be overwritten by next call to this function. Since
+ * counters are updated without locking, the sum may miss counts
+ * being updated at the same time.
  */
 POOL_QUERY_CACHE_STATS *pool_get_memqcache_stats(void)
 {
 	static POOL_QUERY_CACHE_STATS mystats;
-#ifdef HAVE_SIGPROCMASK
-	sigset_t oldmask;
-#else
-	int	oldmask;
-#endif
+	volatile POOL_QUERY_CACHE_STATS_SLOT *slot;
+	int i;
 
 	memset(&mystats, 0, sizeof(POOL_QUERY_CACHE_STATS));
 
 	if (stats)
 	{
-		POOL_SETMASK2(&BlockSig, &oldmask);
-		pool_semaphore_lock(QUERY_CACHE_STATS_SEM);
-		memcpy(&mystats, stats, sizeof(POOL_QUERY_CACHE_STATS));
-		pool_semaphore_unlock(QUERY_CACHE_STATS_SEM);
-		POOL_SETMASK(&oldmask);
+		mystats.start_time = stats->start_time;
+
+		for (i=0;i<stats->num_slots;i++)
+		{
+			slot = &stats->slots[i];
+			mystats.num_selects += slot->counters.num_selects;
+			mystats.num_cache_hits += slot->counters.num_cache_hits;
+		}
 	}
 
 	return &mystats;
 }
 
 /*
- * Reset query cache stats. Caller must lock QUERY_CACHE_STATS_SEM if
- * necessary.
+ * Reset query cache stats.
  */
 void pool_reset_memqcache_stats(void)
 {
-	memset(stats, 0, sizeof(POOL_QUERY_CACHE_STATS));
+	memset(stats->slots, 0, sizeof(POOL_QUERY_CACHE_STATS_SLOT) * stats->num_slots);
 	stats->start_time = time(NULL);
 }
 
 /*
- * Count up number of successful SELECTs and returns the number.
- * QUERY_CACHE_STATS_SEM lock is acquired in this function.
+ * Return stats slot of this process. Processes other than children
+ * share the last slot.
  */
-long long int pool_stats_count_up_num_selects(long long int num)
+static volatile POOL_QUERY_CACHE_STATS_SLOT *my_stats_slot(void)
 {
-#ifdef HAVE_SIGPROCMASK
-	sigset_t oldmask;
-#else
-	int	oldmask;
-#endif
+	if (my_proc_id >= 0 && my_proc_id < stats->num_slots - 1)
+		return &stats->slots[my_proc_id];
+	return &stats->slots[stats->num_slots - 1];
+}
 
-	POOL_SETMASK2(&BlockSig, &oldmask);
-	pool_semaphore_lock(QUERY_CACHE_STATS_SEM);
-	stats->num_selects += num;
-	pool_semaphore_unlock(QUERY_CACHE_STATS_SEM);
-	POOL_SETMASK(&oldmask);
-	return stats->num_selects;
+/*
+ * Count up number of successful SELECTs.
+ */
+void pool_stats_count_up_num_selects(long long int num)
+{
+	if (stats)
+		my_stats_slot()->counters.num_selects += num;
 }
 
 /*
@@ -3287,23 +3378,259 @@ void pool_tmp_stats_reset_num_selects(void)
 }
 
 /*
- * Count up number of SELECTs extracted from cache returns the number.
- * QUERY_CACHE_STATS_SEM lock is acquired in this function.
+ * Count up number of SELECTs extracted from cache.
  */
-long long int pool_stats_count_up_num_cache_hits(void)
+void pool_stats_count_up_num_cache_hits(void)
 {
-#ifdef HAVE_SIGPROCMASK
-	sigset_t oldmask;
-#else
-	int	oldmask;
-#endif
+	if (stats)
+		my_stats_slot()->counters.num_cache_hits++;
+}
 
-	POOL_SETMASK2(&BlockSig, &oldmask);
-	pool_semaphore_lock(QUERY_CACHE_STATS_SEM);
-	stats->num_cache_hits++;
-	pool_semaphore_unlock(QUERY_CACHE_STATS_SEM);
-	POOL_SETMASK(&oldmask);
-	return stats->num_cache_hits;
+/*
+ * Per table and per database query cache stats. Like the counters
+ * above, each child has its own slot, which is updated by the child
+ * without locking and summed up when read. A slot is a fixed size
+ * table looked up through an open addressing hash keyed by database
+ * oid and table oid. Database wide entries have table oid 0. Counts
+ * for tables which do not fit in the table go to the overflow entry.
+ * Entries are never removed, and a new entry is filled before it is
+ * published by incrementing num_entries.
+ */
+static POOL_CACHE_TABLE_STATS_SLOT *table_stats;
+
+#define TABLE_STATS_SLOT_SIZE \
+	((sizeof(POOL_CACHE_TABLE_STATS_SLOT) + POOL_CACHE_LINE_SIZE - 1) / POOL_CACHE_LINE_SIZE * POOL_CACHE_LINE_SIZE)
+#define TABLE_STATS_SLOT(slot) \
+	((POOL_CACHE_TABLE_STATS_SLOT *)((char *)table_stats + TABLE_STATS_SLOT_SIZE * (slot)))
+
+static int pool_init_cache_table_stats(void)
+{
+	size_t size = TABLE_STATS_SLOT_SIZE * stats->num_slots;
+
+	table_stats = pool_shared_memory_create(size);
+	if (table_stats == NULL)
+	{
+		pool_error("pool_init_cache_table_stats: failed to allocate shared memory. request size: %zd",
+				   size);
+		return -1;
+	}
+	memset(table_stats, 0, size);
+	return 0;
+}
+
+/*
+ * Count up the event for the database and for each table.
+ */
+static void pool_cache_table_stats_count(TABLE_STATS_EVENT event, int dboid, int num_oids, int *oids, int bytes)
+{
+	POOL_CACHE_TABLE_STATS_SLOT *slot;
+	int i;
+
+	if (!table_stats || dboid <= 0)
+		return;
+
+	if (my_proc_id >= 0 && my_proc_id < stats->num_slots - 1)
+		slot = TABLE_STATS_SLOT(my_proc_id);
+	else
+		slot = TABLE_STATS_SLOT(stats->num_slots - 1);
+
+	count_table_stats(table_stats_lookup(slot, dboid, 0), event, bytes);
+	for (i=0;i<num_oids;i++)
+	{
+		if (oids[i] > 0)
+			count_table_stats(table_stats_lookup(slot, dboid, oids[i]), event, bytes);
+	}
+}
+
+/*
+ * Count up invalidation or eviction of a cache item. If table_oid is
+ * not 0, the item was invalidated by the table and only the table is
+ * counted. Otherwise all tables recorded in the item header are
+ * counted.
+ */
+static void pool_cache_table_stats_count_removed(POOL_CACHE_ITEM_HEADER *cih, TABLE_STATS_EVENT event, int table_oid)
+{
+	if (cih == NULL)
+		return;
+
+	if (table_oid != 0)
+		pool_cache_table_stats_count(event, cih->dboid, 1, &table_oid, cih->total_length);
+	else
+		pool_cache_table_stats_count(event, cih->dboid, cih->num_oids, cih->oids, cih->total_length);
+}
+
+static void count_table_stats(volatile POOL_CACHE_TABLE_STATS *entry, TABLE_STATS_EVENT event, int bytes)
+{
+	switch (event)
+	{
+		case TABLE_STATS_REGISTERED:
+			entry->num_registered++;
+			break;
+
+		case TABLE_STATS_HIT:
+			entry->num_hits++;
+			break;
+
+		case TABLE_STATS_INVALIDATED:
+			entry->num_invalidated++;
+			entry->invalidated_bytes += bytes;
+			break;
+
+		case TABLE_STATS_EVICTED:
+			entry->num_evicted++;
+			entry->evicted_bytes += bytes;
+			break;
+	}
+}
+
+/*
+ * Find the entry of the table in the slot. A new entry is added if
+ * not found. If the slot is full, the overflow entry is returned.
+ * Only the owner of the slot may call this.
+ */
+static volatile POOL_CACHE_TABLE_STATS *table_stats_lookup(POOL_CACHE_TABLE_STATS_SLOT *slot, int dboid, int table_oid)
+{
+	POOL_CACHE_TABLE_STATS *entry;
+	int mask = TABLE_STATS_BUCKETS - 1;
+	int i;
+
+	for (i = ((unsigned int) dboid * 31 + (unsigned int) table_oid) & mask; slot->buckets[i]; i = (i + 1) & mask)
+	{
+		entry = &slot->entries[slot->buckets[i] - 1];
+		if (entry->dboid == dboid && entry->table_oid == table_oid)
+			return entry;
+	}
+
+	if (slot->num_entries >= POOL_CACHE_TABLE_STATS_SIZE)
+		return &slot->entries[POOL_CACHE_TABLE_STATS_SIZE];
+
+	entry = &slot->entries[slot->num_entries];
+	memset(entry, 0, sizeof(POOL_CACHE_TABLE_STATS));
+	entry->dboid = dboid;
+	entry->table_oid = table_oid;
+	slot->buckets[i] = slot->num_entries + 1;
+
+	/* Let readers see the entry only after it is filled */
+	POOL_MEMORY_BARRIER();
+	slot->num_entries++;
+
+	return entry;
+}
+
+/*
+ * Add counters of an entry to the merged result. Entries which do not
+ * fit in the result are added to the overflow entry, which comes last.
+ */
+static void merge_table_stats(POOL_CACHE_TABLE_STATS *result, int *buckets, int *num_entries,
+							  volatile POOL_CACHE_TABLE_STATS *entry)
+{
+	POOL_CACHE_TABLE_STATS *e;
+	int dboid = entry->dboid;
+	int table_oid = entry->table_oid;
+	int mask = TABLE_STATS_BUCKETS - 1;
+	int i;
+
+	e = NULL;
+	if (dboid != 0)
+	{
+		for (i = ((unsigned int) dboid * 31 + (unsigned int) table_oid) & mask; buckets[i]; i = (i + 1) & mask)
+		{
+			if (result[buckets[i] - 1].dboid == dboid && result[buckets[i] - 1].table_oid == table_oid)
+			{
+				e = &result[buckets[i] - 1];
+				break;
+			}
+		}
+
+		if (e == NULL && *num_entries < POOL_CACHE_TABLE_STATS_SIZE)
+		{
+			e = &result[(*num_entries)++];
+			e->dboid = dboid;
+			e->table_oid = table_oid;
+			buckets[i] = *num_entries;
+		}
+	}
+	if (e == NULL)
+		e = &result[POOL_CACHE_TABLE_STATS_SIZE];
+
+	e->num_registered += entry->num_registered;
+	e->num_hits += entry->num_hits;
+	e->num_invalidated += entry->num_invalidated;
+	e->invalidated_bytes += entry->invalidated_bytes;
+	e->num_evicted += entry->num_evicted;
+	e->evicted_bytes += entry->evicted_bytes;
+}
+
+/*
+ * Return per table query cache stats summed up over all slots, sorted
+ * by database oid and table oid. The database wide entry comes first
+ * in each database. The overflow entry, which has database oid 0, is
+ * included only if it has been used. Since counters are updated
+ * without locking, the sum may miss counts being updated at the same
+ * time. Caller must free the result.
+ */
+POOL_CACHE_TABLE_STATS *pool_get_cache_table_stats(int *nrows)
+{
+	POOL_CACHE_TABLE_STATS *result;
+	POOL_CACHE_TABLE_STATS *overflow;
+	POOL_CACHE_TABLE_STATS_SLOT *slot;
+	int *buckets;
+	int num_entries;
+	int n;
+	int i, j;
+
+	*nrows = 0;
+
+	if (!table_stats)
+		return NULL;
+
+	result = calloc(POOL_CACHE_TABLE_STATS_SIZE + 1, sizeof(POOL_CACHE_TABLE_STATS));
+	buckets = calloc(TABLE_STATS_BUCKETS, sizeof(int));
+	if (result == NULL || buckets == NULL)
+	{
+		pool_error("pool_get_cache_table_stats: malloc failed");
+		free(result);
+		free(buckets);
+		return NULL;
+	}
+
+	num_entries = 0;
+	for (i=0;i<stats->num_slots;i++)
+	{
+		slot = TABLE_STATS_SLOT(i);
+		n = slot->num_entries;
+		POOL_MEMORY_BARRIER();
+
+		for (j=0;j<n;j++)
+			merge_table_stats(result, buckets, &num_entries, &slot->entries[j]);
+		merge_table_stats(result, buckets, &num_entries, &slot->entries[POOL_CACHE_TABLE_STATS_SIZE]);
+	}
+	free(buckets);
+
+	overflow = &result[POOL_CACHE_TABLE_STATS_SIZE];
+	if (overflow->num_registered > 0 || overflow->num_hits > 0 ||
+		overflow->num_invalidated > 0 || overflow->num_evicted > 0)
+	{
+		memmove(&result[num_entries], overflow, sizeof(POOL_CACHE_TABLE_STATS));
+		num_entries++;
+	}
+
+	qsort(result, num_entries, sizeof(POOL_CACHE_TABLE_STATS), compare_table_stats);
+
+	*nrows = num_entries;
+	return result;
+}
+
+static int compare_table_stats(const void *p1, const void *p2)
+{
+	const POOL_CACHE_TABLE_STATS *s1 = p1;
+	const POOL_CACHE_TABLE_STATS *s2 = p2;
+
+	if (s1->dboid != s2->dboid)
+		return (s1->dboid < s2->dboid) ? -1 : 1;
+	if (s1->table_oid != s2->table_oid)
+		return (s1->table_oid < s2->table_oid) ? -1 : 1;
+	return 0;
 }
 
 /*
@@ -3640,6 +3967,29 @@ static uint32 create_hash_key(POOL_QUERY_HASH *key)
 	return mask;
 }
 
+/*
+ * General purpose hash function for in-process hash tables.  This is
+ * Bob Jenkins' one-at-a-time hash, which is good enough for short keys
+ * such as statement names and query strings.
+ */
+uint32 hash_any(unsigned char *k, int keylen)
+{
+	uint32 h = 0;
+	int i;
+
+	for (i = 0; i < keylen; i++)
+	{
+		h += k[i];
+		h += (h << 10);
+		h ^= (h >> 6);
+	}
+	h += (h << 3);
+	h ^= (h >> 11);
+	h += (h << 15);
+
+	return h;
+}
+
 /*
  * Get new free hash element from free list.
  */
@@ -3701,10 +4051,9 @@ POOL_SHMEM_STATS *pool_get_shmem_storage_stats(void)
 		return &mystats;
 
 	/*
-	 * Cop cache hit data
+	 * Sum up cache hit data
 	 */
-	mystats.cache_stats.num_selects = stats->num_selects;
-	mystats.cache_stats.num_cache_hits = stats->num_cache_hits;
+	mystats.cache_stats = *pool_get_memqcache_stats();
 
 	if (strcmp(pool_config-> memqcache_method, "shmem"))
 		return &mystats;
@@ -3760,10 +4109,5 @@ POOL_SHMEM_STATS *pool_get_shmem_storage_stats(void)
 		}
 	}
 
-	/*
-	 * Copy POOL_QUERY_CACHE_STATS
-	 */
-	memcpy(&mystats.cache_stats, stats, sizeof(mystats.cache_stats));
-
 	return &mystats;
 }
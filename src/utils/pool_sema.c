@@ -5,7 +5,7 @@
  * pgpool: a language independent connection pool server for PostgreSQL
  * written by Tatsuo Ishii
  *
- * Portions Copyright (c) 2003-2009, PgPool Global Development Group
+ * Portions Copyright (c) 2003-2013, PgPool Global Development Group
  * Portions Copyright (c) 2003-2004, PostgreSQL Global Development Group
  *
  * Permission to use, copy, modify, and distribute this software and
@@ -19,13 +19,30 @@
  * suitability of this software for any purpose.  It is provided "as
  * is" without express or implied warranty.
  *
+ * pool_sema.c: locks shared among pgpool processes
+ *
+ * Where Linux futex and GCC atomic builtins are available, each lock
+ * is a 32 bit word in shared memory. An uncontended lock or unlock is
+ * a single compare-and-swap and does not enter the kernel. Only when
+ * the lock is not available the process sleeps on the word with
+ * futex(2). The lock can be acquired in shared mode as well by
+ * pool_semaphore_lock_shared(). Other platforms use SysV semaphores,
+ * on which shared mode is the same as exclusive mode.
  */
 #include "pool.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/sem.h>
 
+#if defined(__linux__) && defined(__GNUC__)
+#define USE_FUTEX_LOCK
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
 #include "pool_ipc.h"
 
 
@@ -39,8 +56,177 @@ union semun
 #endif
 
 
-static int	semId;
+#ifdef USE_FUTEX_LOCK
+/*
+ * Lock word layout. Low bits are number of shared lockers. While
+ * LOCK_WRITER_WAITING is set, new shared lockers wait so that a
+ * stream of readers cannot starve an exclusive locker.
+ */
+#define LOCK_EXCLUSIVE	0x40000000	/* held in exclusive mode */
+#define LOCK_WAITERS	0x80000000	/* somebody is sleeping on the lock */
+#define LOCK_WRITER_WAITING	0x20000000	/* exclusive locker is waiting */
+#define LOCK_SHARED_MASK	0x1fffffff
+
+/* Spin this many times before sleeping */
+#define LOCK_SPINS	100
+
+static volatile unsigned int *lockWords;
+
+static void futex_wait(volatile unsigned int *addr, unsigned int val);
+static void futex_wake_all(volatile unsigned int *addr);
+static void lock_word(volatile unsigned int *lock, bool exclusive);
+#endif
+
+
+#ifdef USE_FUTEX_LOCK
+/*
+ * Create lock words in shared memory and initialize.
+ */
+int
+pool_semaphore_create(int numSems)
+{
+	int			i;
+
+	lockWords = pool_shared_memory_create(sizeof(unsigned int) * numSems);
+	if (lockWords == NULL)
+	{
+		pool_error("could not create %d locks", numSems);
+		return -1;
+	}
+
+	for (i = 0; i < numSems; i++)
+		lockWords[i] = 0;
+
+	return 0;
+}
+
+/*
+ * Lock a semaphore in exclusive mode, blocking if it is held by
+ * others.
+ */
+void
+pool_semaphore_lock(int semNum)
+{
+	lock_word(&lockWords[semNum], true);
+}
+
+/*
+ * Unlock a semaphore locked either in exclusive or shared mode.
+ */
+void
+pool_semaphore_unlock(int semNum)
+{
+	volatile unsigned int *lock = &lockWords[semNum];
+	unsigned int old;
+
+	if (*lock & LOCK_EXCLUSIVE)
+		old = __sync_fetch_and_and(lock, ~(LOCK_EXCLUSIVE | LOCK_WAITERS));
+	else
+	{
+		old = __sync_fetch_and_sub(lock, 1);
+
+		/* Others still hold the lock in shared mode? */
+		if ((old & LOCK_SHARED_MASK) != 1)
+			return;
+		old = __sync_fetch_and_and(lock, ~LOCK_WAITERS);
+	}
+
+	/*
+	 * Wake up sleepers if any. They retry and set LOCK_WAITERS again
+	 * if they have to sleep.
+	 */
+	if (old & LOCK_WAITERS)
+		futex_wake_all(lock);
+}
+
+/*
+ * Lock a semaphore in shared mode. Any number of processes can hold
+ * the lock in shared mode at the same time. Release it by
+ * pool_semaphore_unlock().
+ */
+void
+pool_semaphore_lock_shared(int semNum)
+{
+	lock_word(&lockWords[semNum], false);
+}
+
+/*
+ * Acquire lock word in exclusive or shared mode. Spin for a while,
+ * then sleep until the holder wakes us up. An exclusive locker that
+ * cannot get the lock sets LOCK_WRITER_WAITING first, and clears it
+ * when it finally gets the lock. Other waiting exclusive lockers set
+ * it again on their next try.
+ */
+static void
+lock_word(volatile unsigned int *lock, bool exclusive)
+{
+	unsigned int old;
+	int spins = 0;
+
+	for (;;)
+	{
+		old = *lock;
+
+		if (exclusive)
+		{
+			if ((old & ~(LOCK_WAITERS | LOCK_WRITER_WAITING)) == 0)
+			{
+				if (__sync_bool_compare_and_swap(lock, old,
+												 (old & ~LOCK_WRITER_WAITING) | LOCK_EXCLUSIVE))
+					return;
+				continue;
+			}
+
+			/* Keep new shared lockers off until we get the lock */
+			if ((old & LOCK_WRITER_WAITING) == 0)
+			{
+				__sync_bool_compare_and_swap(lock, old, old | LOCK_WRITER_WAITING);
+				continue;
+			}
+		}
+		else
+		{
+			if ((old & (LOCK_EXCLUSIVE | LOCK_WRITER_WAITING)) == 0 &&
+				__sync_bool_compare_and_swap(lock, old, old + 1))
+				return;
+		}
+
+		if (spins++ < LOCK_SPINS)
+			continue;
+
+		/* Tell the holder that we are going to sleep, then sleep */
+		if ((old & LOCK_WAITERS) ||
+			__sync_bool_compare_and_swap(lock, old, old | LOCK_WAITERS))
+			futex_wait(lock, old | LOCK_WAITERS);
+		spins = 0;
+	}
+}
 
+/*
+ * Sleep while *addr is val. Returns immediately if *addr is not val
+ * or on signal. Callers recheck the lock word anyway.
+ */
+static void
+futex_wait(volatile unsigned int *addr, unsigned int val)
+{
+	if (syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0) < 0 &&
+		errno != EAGAIN && errno != EINTR)
+		pool_error("futex(FUTEX_WAIT) failed: %s", strerror(errno));
+}
+
+/*
+ * Wake up all processes sleeping on addr.
+ */
+static void
+futex_wake_all(volatile unsigned int *addr)
+{
+	if (syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) < 0)
+		pool_error("futex(FUTEX_WAKE) failed: %s", strerror(errno));
+}
+
+#else	/* !USE_FUTEX_LOCK */
+
+static int	semId;
 
 /*
  * Removes a semaphore set.
@@ -159,3 +345,15 @@ pool_semaphore_unlock(int semNum)
 	if (errStatus < 0)
 		pool_error("semop(id=%d) failed: %s", semId, strerror(errno));
 }
+
+/*
+ * Lock a semaphore in shared mode. SysV semaphores do not have shared
+ * mode, so this is the same as pool_semaphore_lock().
+ */
+void
+pool_semaphore_lock_shared(int semNum)
+{
+	pool_semaphore_lock(semNum);
+}
+
+#endif	/* USE_FUTEX_LOCK */